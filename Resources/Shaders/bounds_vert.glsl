@@ -0,0 +1,13 @@
+#version 330 core
+
+// Bounding boxes for occlusion queries; only depth testing matters
+
+layout(location = 0) in vec3 aPosition;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main() {
+    gl_Position = projection * view * model * vec4(aPosition, 1.0);
+}
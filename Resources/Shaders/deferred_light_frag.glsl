@@ -0,0 +1,125 @@
+#version 330 core
+
+// Deferred lighting pass over the G-buffer (GBuffer.h); same lighting as phong_frag.glsl, except that the
+// specular color is reduced to an intensity. Specialized with the same lighting defines, see ShaderVariants.h
+
+out vec4 FragColor;
+
+uniform sampler2D gbuffer_albedo;
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_depth;
+uniform mat4 inverse_view_projection;
+
+uniform vec3 light_position;
+uniform vec3 light_color;         // With DIRECTIONAL_LIGHT, light_position is the direction towards the light
+uniform vec3 camera_pos;
+uniform vec3 ambient_light;
+
+// Clustered point lights, see LightClusters.h
+const ivec3 CLUSTER_GRID = ivec3(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z);
+uniform samplerBuffer light_data;
+uniform usamplerBuffer light_clusters;
+uniform usamplerBuffer light_indices;
+uniform vec2 cluster_tile_size;
+uniform vec2 cluster_slices;
+uniform mat4 view;
+
+// Cascaded shadows of the main light, see CascadedShadows.h
+uniform sampler2DArrayShadow shadow_map;
+uniform mat4 shadow_matrices[CASCADE_COUNT];
+uniform vec4 cascade_splits;
+uniform vec4 shadow_texel_sizes;
+
+vec3 decodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// Diffuse and specular terms of one light
+vec2 phong(vec3 lightDir, vec3 norm, vec3 viewDir, float shininess) {
+    float diff = max(dot(norm, lightDir), 0.0);
+    float spec = pow(max(dot(viewDir, reflect(-lightDir, norm)), 0.0), shininess);
+    return vec2(diff, spec);
+}
+
+// As in phong_frag.glsl
+float shadowFactor(vec3 position, vec3 norm, vec3 lightDir, float viewDepth) {
+    if (viewDepth >= cascade_splits[CASCADE_COUNT - 1]) {
+        return 1.0;
+    }
+    int cascade = 0;
+    while (cascade < CASCADE_COUNT - 1 && viewDepth >= cascade_splits[cascade]) {
+        cascade++;
+    }
+    float slope = 1.0 - max(dot(norm, lightDir), 0.0);
+    vec3 offset = norm * shadow_texel_sizes[cascade] * (0.5 + 1.5 * slope);
+    vec3 coord = (shadow_matrices[cascade] * vec4(position + offset, 1.0)).xyz;
+    coord.z -= 0.0005;
+
+    vec2 texel = 1.0 / vec2(textureSize(shadow_map, 0).xy);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            lit += texture(shadow_map, vec4(coord.xy + vec2(x, y) * texel, float(cascade), coord.z));
+        }
+    }
+    return lit / 9.0;
+}
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbuffer_depth, texel, 0).r;
+    if (depth >= 1.0) {
+        discard;    // Background
+    }
+    gl_FragDepth = depth;   // Forward passes after this one test against the G-buffer's depth
+    vec4 albedo_specular = texelFetch(gbuffer_albedo, texel, 0);
+    vec4 normal_shininess = texelFetch(gbuffer_normal, texel, 0);
+
+    vec2 uv = (vec2(texel) + 0.5) / vec2(textureSize(gbuffer_depth, 0));
+    vec4 position = inverse_view_projection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 FragPos = position.xyz / position.w;
+
+    vec3 diffuse = albedo_specular.rgb;
+    float specular = albedo_specular.a;
+    float shininess = normal_shininess.z;
+    vec3 norm = decodeNormal(normal_shininess.xy);
+    vec3 viewDir = normalize(camera_pos - FragPos);
+
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+#ifdef DIRECTIONAL_LIGHT
+    vec3 lightDir = normalize(light_position);
+#else
+    vec3 lightDir = normalize(light_position - FragPos);
+#endif
+#ifdef SHADOWS
+    float shadow = shadowFactor(FragPos, norm, lightDir, viewDepth);
+#else
+    float shadow = 1.0;
+#endif
+
+    vec3 result = diffuse * ambient_light;
+    vec2 terms = shadow * phong(lightDir, norm, viewDir, shininess);
+    result += clamp(light_color * terms.x * diffuse, 0.0, 1.0) + clamp(light_color * terms.y * specular, 0.0, 1.0);
+
+#ifdef CLUSTERED_LIGHTS
+    int slice = clamp(int(log(viewDepth) * cluster_slices.x + cluster_slices.y), 0, CLUSTER_GRID.z - 1);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / cluster_tile_size), CLUSTER_GRID.xy - 1);
+    uvec2 cluster = texelFetch(light_clusters, (slice * CLUSTER_GRID.y + tile.y) * CLUSTER_GRID.x + tile.x).xy;
+    for (uint i = 0u; i < cluster.y; i++) {
+        int index = int(texelFetch(light_indices, int(cluster.x + i)).r);
+        vec4 position_radius = texelFetch(light_data, 2 * index);
+        vec3 toLight = position_radius.xyz - FragPos;
+        float distance2 = dot(toLight, toLight);
+        float radius2 = position_radius.w * position_radius.w;
+        if (distance2 >= radius2) continue;
+        float window = 1.0 - distance2 / radius2;
+        vec3 color = texelFetch(light_data, 2 * index + 1).rgb;
+        terms = phong(toLight * inversesqrt(distance2), norm, viewDir, shininess);
+        result += window * window * color * (terms.x * diffuse + terms.y * specular);
+    }
+#endif
+    FragColor = vec4(result, 1.0);
+}
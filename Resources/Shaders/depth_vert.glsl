@@ -0,0 +1,16 @@
+#version 330 core
+
+// Depth prepass. Must compute gl_Position exactly like phong_vert.glsl so shading can test with GL_EQUAL
+
+layout(location = 0) in vec3 aPosition;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+
+void main() {
+    vec3 FragPos = vec3(model * vec4(aPosition, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
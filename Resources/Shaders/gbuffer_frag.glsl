@@ -0,0 +1,46 @@
+#version 330 core
+
+// Deferred geometry pass; same material inputs and ShaderVariants defines as phong_frag.glsl, layout in GBuffer.h
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoord;
+
+layout(location = 0) out vec4 AlbedoSpecular;
+layout(location = 1) out vec4 NormalShininess;
+
+uniform vec3 diffuse;
+uniform vec3 specular;
+uniform float shininess;
+uniform float opacity;
+
+uniform sampler2D texture_diffuse;
+uniform sampler2D texture_specular;
+
+// Octahedral encoding, a unit normal in two components
+vec2 encodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : folded;
+}
+
+void main() {
+#ifdef HAS_DIFFUSE_TEXTURE
+    vec4 diffuse_sample = texture(texture_diffuse, TexCoord);
+#else
+    vec4 diffuse_sample = vec4(1.0);
+#endif
+#ifdef ALPHA_TEST
+    if (opacity * diffuse_sample.a < ALPHA_CUTOFF) {
+        discard;
+    }
+#endif
+#ifdef HAS_SPECULAR_TEXTURE
+    vec3 specular_color = specular * texture(texture_specular, TexCoord).rgb;
+#else
+    vec3 specular_color = specular;
+#endif
+
+    AlbedoSpecular = vec4(diffuse * diffuse_sample.rgb, clamp(dot(specular_color, vec3(0.2126, 0.7152, 0.0722)), 0.0, 1.0));
+    NormalShininess = vec4(encodeNormal(normalize(Normal)), shininess, 0.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+
+// Resolves weighted blended OIT; blended over the scene with (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA)
+
+uniform sampler2D accumulation;
+uniform sampler2D revealage;
+
+out vec4 FragColor;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float revealed = texelFetch(revealage, texel, 0).r;
+    if (revealed >= 1.0) {
+        discard;    // Nothing transparent covers this pixel
+    }
+    vec4 accumulated = texelFetch(accumulation, texel, 0);
+    vec3 average = accumulated.rgb / clamp(accumulated.a, 1e-4, 5e4);
+    FragColor = vec4(average, 1.0 - revealed);
+}
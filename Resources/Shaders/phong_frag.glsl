@@ -1,10 +1,14 @@
 #version 330 core
 
+// Specialized by ShaderVariants, which defines HAS_AMBIENT_TEXTURE, HAS_DIFFUSE_TEXTURE, HAS_SPECULAR_TEXTURE,
+// ALPHA_TEST, SHADOWS, CLUSTERED_LIGHTS, DIRECTIONAL_LIGHT and WEIGHTED_OIT for the variants that need them
+
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out float Revealage;   // Weighted OIT only, see WeightedOit.h
 
 // Color
 uniform vec3 ambient; // Ambient color/texture (Ka)
@@ -15,7 +19,6 @@ uniform vec3 specular; // Specular color/texture (Ks)
 uniform sampler2D texture_ambient;
 uniform sampler2D texture_diffuse;
 uniform sampler2D texture_specular;
-uniform int texture_flags;
 
 // Specular exponent
 uniform float shininess;
@@ -23,54 +26,143 @@ uniform float opacity;
 
 // Light properties
 uniform vec3 light_position;
-uniform vec3 light_color;
+uniform vec3 light_color;         // With DIRECTIONAL_LIGHT, light_position is the direction towards the light
 uniform vec3 camera_pos;
 
 uniform vec3 ambient_light;
 
-// Texture flags (bitwise)
-const int TEXTURE_FLAG_AMBIENT  = 0x1;  // Bit 0
-const int TEXTURE_FLAG_DIFFUSE  = 0x2;  // Bit 1
-const int TEXTURE_FLAG_SPECULAR = 0x4;  // Bit 2
-
+// Clustered point lights, see LightClusters.h
+const ivec3 CLUSTER_GRID = ivec3(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z);
+uniform samplerBuffer light_data;           // Per light: (position, radius), (color, 0)
+uniform usamplerBuffer light_clusters;      // Per cluster: (offset, count) into light_indices
+uniform usamplerBuffer light_indices;
+uniform vec2 cluster_tile_size;             // Pixels
+uniform vec2 cluster_slices;                // Depth slice = log(view depth) * x + y
+uniform mat4 view;
+
+// Cascaded shadows of the main light, see CascadedShadows.h
+uniform sampler2DArrayShadow shadow_map;
+uniform mat4 shadow_matrices[CASCADE_COUNT];
+uniform vec4 cascade_splits;                // View depth where each cascade ends
+uniform vec4 shadow_texel_sizes;            // World units
+
+
+// Smoothly windowed point light, zero at its radius
+vec3 pointLight(int index, vec3 norm, vec3 viewDir, vec3 diffuse, vec3 specular) {
+    vec4 position_radius = texelFetch(light_data, 2 * index);
+    vec3 toLight = position_radius.xyz - FragPos;
+    float distance2 = dot(toLight, toLight);
+    float radius2 = position_radius.w * position_radius.w;
+    if (distance2 >= radius2) {
+        return vec3(0.0);
+    }
+    float window = 1.0 - distance2 / radius2;
+    vec3 lightDir = toLight * inversesqrt(distance2);
+    float diff = max(dot(norm, lightDir), 0.0);
+    float spec = pow(max(dot(viewDir, reflect(-lightDir, norm)), 0.0), shininess);
+    vec3 color = texelFetch(light_data, 2 * index + 1).rgb;
+    return window * window * color * (diff * diffuse + spec * specular);
+}
+
+vec3 clusteredLights(vec3 norm, vec3 viewDir, vec3 diffuse, vec3 specular, float viewDepth) {
+    int slice = clamp(int(log(viewDepth) * cluster_slices.x + cluster_slices.y), 0, CLUSTER_GRID.z - 1);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / cluster_tile_size), CLUSTER_GRID.xy - 1);
+    uvec2 cluster = texelFetch(light_clusters, (slice * CLUSTER_GRID.y + tile.y) * CLUSTER_GRID.x + tile.x).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < cluster.y; i++) {
+        result += pointLight(int(texelFetch(light_indices, int(cluster.x + i)).r), norm, viewDir, diffuse, specular);
+    }
+    return result;
+}
+
+// Fraction of the main light reaching a point: 3x3 PCF in the first cascade covering its view depth.
+// Offsetting along the normal by about a texel keeps grazing surfaces from shadowing themselves
+float shadowFactor(vec3 position, vec3 norm, vec3 lightDir, float viewDepth) {
+    if (viewDepth >= cascade_splits[CASCADE_COUNT - 1]) {
+        return 1.0;
+    }
+    int cascade = 0;
+    while (cascade < CASCADE_COUNT - 1 && viewDepth >= cascade_splits[cascade]) {
+        cascade++;
+    }
+    float slope = 1.0 - max(dot(norm, lightDir), 0.0);
+    vec3 offset = norm * shadow_texel_sizes[cascade] * (0.5 + 1.5 * slope);
+    vec3 coord = (shadow_matrices[cascade] * vec4(position + offset, 1.0)).xyz;
+    coord.z -= 0.0005;
+
+    vec2 texel = 1.0 / vec2(textureSize(shadow_map, 0).xy);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            lit += texture(shadow_map, vec4(coord.xy + vec2(x, y) * texel, float(cascade), coord.z));
+        }
+    }
+    return lit / 9.0;
+}
 
 void main() {
     vec3 norm = normalize(Normal);
+#ifdef DIRECTIONAL_LIGHT
+    vec3 lightDir = normalize(light_position);
+#else
     vec3 lightDir = normalize(light_position - FragPos);
+#endif
     vec3 viewDir = normalize(camera_pos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
 
-    // Determine which textures are present using bitwise operators
-    bool has_ambient_tex = bool(texture_flags & TEXTURE_FLAG_AMBIENT);
-    bool has_diffuse_tex = bool(texture_flags & TEXTURE_FLAG_DIFFUSE);
-    bool has_specular_tex = bool(texture_flags & TEXTURE_FLAG_SPECULAR);
-
-    // Get material colors from textures or fallback to vertex colors
-    vec3 ambient = has_ambient_tex
-    ? ambient * texture(texture_ambient, TexCoord).rgb
-    : ambient;
-
-    vec3 diffuse = has_diffuse_tex
-    ? diffuse * texture(texture_diffuse, TexCoord).rgb
-    : diffuse;
-
-    vec3 specular = has_specular_tex
-    ? specular * texture(texture_specular, TexCoord).rgb
-    : specular;
+    // Get material colors from the textures the variant has, or the material's alone
+#ifdef HAS_AMBIENT_TEXTURE
+    vec3 ambient = ambient * texture(texture_ambient, TexCoord).rgb;
+#endif
+
+#ifdef HAS_DIFFUSE_TEXTURE
+    vec4 diffuse_sample = texture(texture_diffuse, TexCoord);
+#else
+    vec4 diffuse_sample = vec4(1.0);
+#endif
+    vec3 diffuse = diffuse * diffuse_sample.rgb;
+    float alpha = opacity * diffuse_sample.a;
+#ifdef ALPHA_TEST
+    if (alpha < ALPHA_CUTOFF) {
+        discard;
+    }
+#endif
+
+#ifdef HAS_SPECULAR_TEXTURE
+    vec3 specular = specular * texture(texture_specular, TexCoord).rgb;
+#endif
+
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+#ifdef SHADOWS
+    float shadow = shadowFactor(FragPos, norm, lightDir, viewDepth);
+#else
+    float shadow = 1.0;
+#endif
 
     // Ambient component
     vec3 ambientResult = diffuse * ambient_light;
 
     // Diffuse component
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuseResult = light_color * diff * diffuse;
+    vec3 diffuseResult = shadow * light_color * diff * diffuse;
     diffuseResult = clamp(diffuseResult,0.0 , 1.0);
 
     // Specular component
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
-    vec3 specularResult = light_color * spec * specular;
+    vec3 specularResult = shadow * light_color * spec * specular;
     specularResult = clamp(specularResult,0.0 , 1.0);
 
     vec3 result = ambientResult + diffuseResult + specularResult;
-    FragColor = vec4(result, opacity);
+#ifdef CLUSTERED_LIGHTS
+    result += clusteredLights(norm, viewDir, diffuse, specular, viewDepth);
+#endif
+#ifdef WEIGHTED_OIT
+    // Depth weight from McGuire and Bavoil, favouring near and more opaque surfaces
+    float weight = clamp(alpha * max(1e-2, 3e3 * pow(1.0 - gl_FragCoord.z, 3.0)), 1e-2, 3e3);
+    FragColor = vec4(result * alpha, alpha) * weight;
+    Revealage = alpha;
+#else
+    FragColor = vec4(result, alpha);
+#endif
 }
\ No newline at end of file
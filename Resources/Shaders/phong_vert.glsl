@@ -13,6 +13,8 @@ uniform mat4 view;
 uniform mat4 projection;
 uniform mat3 normal;
 
+invariant gl_Position; // Matches depth_vert.glsl for the GL_EQUAL shading pass after a depth prepass
+
 void main() {
     FragPos = vec3(model * vec4(aPosition, 1.0));
     Normal = normal * aNormal;
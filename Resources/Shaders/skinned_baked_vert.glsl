@@ -0,0 +1,65 @@
+#version 330 core
+
+#define MAX_BAKED_CLIPS 32 // Keep in sync with AnimationTexture.h
+
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in ivec4 aBoneIDs;
+layout(location = 4) in vec4 aWeights;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// Bone palettes of every clip, one frame per row and three texels (affine rows) per bone
+uniform sampler2D animation_texture;
+uniform vec4 baked_clips[MAX_BAKED_CLIPS]; // First row, last frame, sample rate, unused
+
+// Per-instance data: three rows of the model matrix, then (clip, time in seconds, unused, unused)
+uniform samplerBuffer instance_data;
+
+const int INSTANCE_STRIDE = 4;
+
+mat4 fetchBone(int bone, float row, vec2 texel_size) {
+    float x = float(3 * bone) + 0.5;
+    vec4 row0 = texture(animation_texture, vec2(x, row) * texel_size);
+    vec4 row1 = texture(animation_texture, vec2(x + 1.0, row) * texel_size);
+    vec4 row2 = texture(animation_texture, vec2(x + 2.0, row) * texel_size);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+void main() {
+    int base = gl_InstanceID * INSTANCE_STRIDE;
+    mat4 model = transpose(mat4(texelFetch(instance_data, base),
+                                texelFetch(instance_data, base + 1),
+                                texelFetch(instance_data, base + 2),
+                                vec4(0.0, 0.0, 0.0, 1.0)));
+    vec4 playback = texelFetch(instance_data, base + 3);
+
+    // Filtering between the rows of two consecutive frames interpolates the pose
+    vec4 clip = baked_clips[int(playback.x)];
+    float frame = clamp(playback.y * clip.z, 0.0, clip.y);
+    float row = clip.x + frame + 0.5;
+    vec2 texel_size = 1.0 / vec2(textureSize(animation_texture, 0));
+
+    mat4 BoneTransform = fetchBone(aBoneIDs[0], row, texel_size) * aWeights[0];
+    BoneTransform     += fetchBone(aBoneIDs[1], row, texel_size) * aWeights[1];
+    BoneTransform     += fetchBone(aBoneIDs[2], row, texel_size) * aWeights[2];
+    BoneTransform     += fetchBone(aBoneIDs[3], row, texel_size) * aWeights[3];
+
+    vec4 skinnedPosition = BoneTransform * vec4(aPosition, 1.0);
+    FragPos = vec3(model * skinnedPosition);
+
+    // Cofactor matrix: the inverse transpose up to a scale factor, which the fragment shader normalizes away
+    mat3 m = mat3(model);
+    mat3 normal = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    Normal = normal * (mat3(BoneTransform) * aNormal);
+
+    TexCoord = aTexCoord;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
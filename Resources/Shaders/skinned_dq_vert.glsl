@@ -0,0 +1,68 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in ivec4 aBoneIDs;
+layout(location = 4) in vec4 aWeights;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat3 normal;
+
+// Unit dual quaternions, two vec4 (real, dual) per bone in (x, y, z, w) order
+const int MAX_BONES = 200; // Keep in sync with MAX_UNIFORM_BONES in SkeletalMesh.h
+#ifdef BONE_BUFFER
+// Variant for palettes larger than MAX_BONES: two texels per bone
+uniform samplerBuffer bone_buffer;
+
+void getBone(int id, out vec4 real, out vec4 dual) {
+    real = texelFetch(bone_buffer, 2 * id);
+    dual = texelFetch(bone_buffer, 2 * id + 1);
+}
+#else
+uniform vec4 gBoneDQ[2 * MAX_BONES];
+
+void getBone(int id, out vec4 real, out vec4 dual) {
+    real = gBoneDQ[2 * id];
+    dual = gBoneDQ[2 * id + 1];
+}
+#endif
+
+// Rotates v by the unit quaternion q
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() {
+    // Blend up to 4 dual quaternions, flipping those in the opposite hemisphere of the first
+    vec4 real0, dual0;
+    getBone(aBoneIDs[0], real0, dual0);
+    vec4 real = real0 * aWeights[0];
+    vec4 dual = dual0 * aWeights[0];
+    for (int i = 1; i < 4; i++) {
+        vec4 bone_real, bone_dual;
+        getBone(aBoneIDs[i], bone_real, bone_dual);
+        float weight = dot(real0, bone_real) < 0.0 ? -aWeights[i] : aWeights[i];
+        real += bone_real * weight;
+        dual += bone_dual * weight;
+    }
+    float inverse_length = 1.0 / length(real);
+    real *= inverse_length;
+    dual *= inverse_length;
+
+    vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    vec4 skinnedPosition = vec4(rotate(real, aPosition) + translation, 1.0);
+    FragPos = vec3(model * skinnedPosition);
+
+    Normal = normal * rotate(real, aNormal);
+
+    TexCoord = aTexCoord;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
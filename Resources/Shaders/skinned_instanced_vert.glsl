@@ -0,0 +1,49 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in ivec4 aBoneIDs;
+layout(location = 4) in vec4 aWeights;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// Per-instance data: the model matrix followed by the bone palette, each matrix stored as the three
+// rows of its affine part in consecutive RGBA32F texels
+uniform samplerBuffer instance_data;
+uniform int instance_stride; // Texels per instance
+
+mat4 fetchAffine(int texel) {
+    vec4 row0 = texelFetch(instance_data, texel);
+    vec4 row1 = texelFetch(instance_data, texel + 1);
+    vec4 row2 = texelFetch(instance_data, texel + 2);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+void main() {
+    int base = gl_InstanceID * instance_stride;
+    mat4 model = fetchAffine(base);
+
+    // Bone i starts after the model matrix, at base + 3 * (i + 1)
+    mat4 BoneTransform = fetchAffine(base + 3 * (aBoneIDs[0] + 1)) * aWeights[0];
+    BoneTransform     += fetchAffine(base + 3 * (aBoneIDs[1] + 1)) * aWeights[1];
+    BoneTransform     += fetchAffine(base + 3 * (aBoneIDs[2] + 1)) * aWeights[2];
+    BoneTransform     += fetchAffine(base + 3 * (aBoneIDs[3] + 1)) * aWeights[3];
+
+    vec4 skinnedPosition = BoneTransform * vec4(aPosition, 1.0);
+    FragPos = vec3(model * skinnedPosition);
+
+    // Cofactor matrix: the inverse transpose up to a scale factor, which the fragment shader normalizes away
+    mat3 m = mat3(model);
+    mat3 normal = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    Normal = normal * (mat3(BoneTransform) * aNormal);
+
+    TexCoord = aTexCoord;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -15,15 +15,31 @@ uniform mat4 view;
 uniform mat4 projection;
 uniform mat3 normal;
 
-const int MAX_BONES = 200;
+const int MAX_BONES = 200; // Keep in sync with MAX_UNIFORM_BONES in SkeletalMesh.h
+#ifdef BONE_BUFFER
+// Variant for palettes larger than MAX_BONES: three texels (affine rows) per bone
+uniform samplerBuffer bone_buffer;
+
+mat4 getBone(int id) {
+    vec4 row0 = texelFetch(bone_buffer, 3 * id);
+    vec4 row1 = texelFetch(bone_buffer, 3 * id + 1);
+    vec4 row2 = texelFetch(bone_buffer, 3 * id + 2);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+#else
 uniform mat4 gBones[MAX_BONES];
 
+mat4 getBone(int id) {
+    return gBones[id];
+}
+#endif
+
 void main() {
     // Compute bone transformation matrix by blending up to 4 bones
-    mat4 BoneTransform = gBones[aBoneIDs[0]] * aWeights[0];
-    BoneTransform     += gBones[aBoneIDs[1]] * aWeights[1];
-    BoneTransform     += gBones[aBoneIDs[2]] * aWeights[2];
-    BoneTransform     += gBones[aBoneIDs[3]] * aWeights[3];
+    mat4 BoneTransform = getBone(aBoneIDs[0]) * aWeights[0];
+    BoneTransform     += getBone(aBoneIDs[1]) * aWeights[1];
+    BoneTransform     += getBone(aBoneIDs[2]) * aWeights[2];
+    BoneTransform     += getBone(aBoneIDs[3]) * aWeights[3];
 
 //    BoneTransform = mat4(1.0); // TEMPORARY DISABLE SKINNING
 
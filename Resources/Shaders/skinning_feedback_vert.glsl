@@ -0,0 +1,44 @@
+#version 330 core
+
+// Skins vertices once into a buffer via transform feedback; every pass then draws the result as a
+// static mesh. Outputs are in mesh space and captured interleaved in the static vertex layout.
+
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in ivec4 aBoneIDs;
+layout(location = 4) in vec4 aWeights;
+
+out vec3 SkinnedPosition;
+out vec3 SkinnedNormal;
+out vec2 SkinnedTexCoord;
+
+const int MAX_BONES = 200; // Keep in sync with MAX_UNIFORM_BONES in SkeletalMesh.h
+#ifdef BONE_BUFFER
+// Variant for palettes larger than MAX_BONES: three texels (affine rows) per bone
+uniform samplerBuffer bone_buffer;
+
+mat4 getBone(int id) {
+    vec4 row0 = texelFetch(bone_buffer, 3 * id);
+    vec4 row1 = texelFetch(bone_buffer, 3 * id + 1);
+    vec4 row2 = texelFetch(bone_buffer, 3 * id + 2);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+#else
+uniform mat4 gBones[MAX_BONES];
+
+mat4 getBone(int id) {
+    return gBones[id];
+}
+#endif
+
+void main() {
+    mat4 BoneTransform = getBone(aBoneIDs[0]) * aWeights[0];
+    BoneTransform     += getBone(aBoneIDs[1]) * aWeights[1];
+    BoneTransform     += getBone(aBoneIDs[2]) * aWeights[2];
+    BoneTransform     += getBone(aBoneIDs[3]) * aWeights[3];
+
+    SkinnedPosition = vec3(BoneTransform * vec4(aPosition, 1.0));
+    SkinnedNormal = mat3(BoneTransform) * aNormal;
+    SkinnedTexCoord = aTexCoord;
+}
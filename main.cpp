@@ -1,10 +1,48 @@
+#include <charconv>
 #include <iostream>
+#include <string>
+#include <string_view>
 #include <GLFW/glfw3.h>
 
+#include "src/Core.h"
 #include "src/Window.h"
+#include "src/render/DynamicResolution.h"
 
 
-int main() {
+int main(int argc, char** argv) {
+    // --deferred shades opaque static geometry through a G-buffer instead of forward
+    // --dynamic-resolution scales the scene to hold --target-ms of GPU time, within --min-scale and --max-scale
+    auto& dynamic_resolution = Window::getDynamicResolution();
+    float min_scale = dynamic_resolution.getMinScale();
+    float max_scale = dynamic_resolution.getMaxScale();
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg(argv[i]);
+        // Leaves out unchanged when the value is not a number
+        const auto value = [arg](float& out) {
+            const auto text = arg.substr(arg.find('=') + 1);
+            float parsed;
+            const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), parsed);
+            if (error != std::errc() || end != text.data() + text.size()) {
+                std::cerr << "Error: ignoring " << arg << ", not a number" << std::endl;
+                return;
+            }
+            out = parsed;
+        };
+        if (arg == "--deferred") {
+            Core::setDeferredShading(true);
+        } else if (arg == "--dynamic-resolution") {
+            dynamic_resolution.setEnabled(true);
+        } else if (arg.starts_with("--target-ms=")) {
+            float target_ms = dynamic_resolution.getTargetTime();
+            value(target_ms);
+            dynamic_resolution.setTargetTime(target_ms);
+        } else if (arg.starts_with("--min-scale=")) {
+            value(min_scale);
+        } else if (arg.starts_with("--max-scale=")) {
+            value(max_scale);
+        }
+    }
+    dynamic_resolution.setScaleRange(min_scale, max_scale);
     Window::initialize(1280, 720, "Project Name");
     while (Window::isActive()) {
         Window::update();
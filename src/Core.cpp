@@ -1,12 +1,30 @@
 #include "Core.h"
 
+#include <chrono>
 #include <iostream>
+#include <random>
 
 #include "Debug.h"
+#include "Profiler.h"
 #include "Window.h"
+#include "render/AabbTree.h"
+#include "render/AnimationSystem.h"
 #include "render/Camera.h"
+#include "render/DynamicResolution.h"
+#include "render/CascadedShadows.h"
+#include "render/FrameGraph.h"
+#include "render/GBuffer.h"
+#include "render/GpuTimer.h"
+#include "render/LightClusters.h"
 #include "render/Mesh.h"
+#include "render/OcclusionCuller.h"
+#include "render/OcclusionQueries.h"
+#include "render/RenderQueue.h"
+#include "render/SceneGraph.h"
+#include "render/ShaderVariants.h"
 #include "render/SkeletalMesh.h"
+#include "render/SkinnedCrowd.h"
+#include "render/WeightedOit.h"
 #include "render/shapes/Cone.h"
 #include "render/shapes/Cube.h"
 #include "render/shapes/Cylinder.h"
@@ -14,14 +32,92 @@
 #include "render/shapes/Sphere.h"
 
 
-static gl::SkinnedMesh skinned_mesh;
+static std::shared_ptr<gl::SkinnedMesh> skinned_mesh;
 static gl::Transform skinned_transform;
+static std::unique_ptr<gl::SkinnedCrowd> crowd;
+static gl::DrawMesh pre_skinned_mesh;   // Target of the transform feedback skinning pass (T)
+static bool pre_skinning = false;
+static gl::AnimationSystem animation_system;
+
+// A prop held in the walker's right hand: walker -> hand bone -> prop
+static gl::SceneGraph scene_graph;
+static gl::SceneNode walker_node;
+static gl::SceneNode hand_node;
+static gl::SceneNode prop_node;
+static int hand_bone = -1;
 
 static gl::DrawMesh obj_mesh;
 static gl::Transform obj_transform;
+
+// World-space index of m_shapes and the submeshes of obj_mesh. Leaf user data is the m_shapes index, or
+// MESH_SUBMESH | submesh index for obj_mesh
+static gl::AabbTree scene_index;
+constexpr uint64_t MESH_SUBMESH = 1ull << 32;
+static std::vector<int> submesh_proxies;
+static uint64_t submesh_version = 0;
+
+// Culls the frustum query's results against a depth buffer of the tagged occluders (O toggles)
+static gl::OcclusionCuller occlusion_culler;
+static bool occlusion_culling = true;
+
+// Heavy submeshes are also drawn conditionally on hardware occlusion queries (G toggles)
+static gl::OcclusionQueries occlusion_queries;
+static bool gpu_occlusion = true;
+
+// Static draws, sorted front to back. With the depth prepass (Z toggles) opaque items are drawn depth-only
+// from a position-only stream first, then shaded with GL_EQUAL so each pixel is shaded once
+static gl::RenderQueue render_queue;
+static bool depth_prepass = false;
+static gl::GpuTimer static_timer;
+
+// Blended submeshes are either depth sorted or resolved with weighted blended OIT (I toggles)
+static gl::WeightedOit weighted_oit;
+static bool use_weighted_oit = false;
+
+// Opaque and alpha-tested static geometry is either shaded forward or through a G-buffer, chosen at startup
+static bool deferred_shading = false;
+
+// The frame's passes, rebuilt every frame; transient targets come from its pool (F prints the compiled graph)
+static gl::FrameGraph frame_graph;
+static bool print_frame_graph = false;
+
+// Cascaded shadow maps of the main light (H toggles). Static casters are redrawn only when a cascade's cache is
+// invalidated, which a change to the scene index does through static_shadow_version
+static gl::CascadedShadows shadows;
+static bool shadows_enabled = true;
+static uint64_t static_shadow_version = 0;
+
+// Point lights shaded through clustered forward lighting, drifting around fixed anchors (L cycles the count)
+static gl::LightClusters light_clusters;
+static std::vector<gl::PointLight> point_lights;
+static std::vector<glm::vec4> point_light_anchors;    // Anchor position, phase
+constexpr size_t POINT_LIGHT_COUNTS[] = {0, 256, 1024};
+static size_t point_light_setting = 0;
+
+static void createPointLights(const size_t count) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    point_lights.resize(count);
+    point_light_anchors.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        point_light_anchors[i] = glm::vec4(40.0f * unit(random) - 20.0f, 0.5f + 2.5f * unit(random),
+            40.0f * unit(random) - 20.0f, 6.28318f * unit(random));
+        point_lights[i].radius = 2.0f + 3.0f * unit(random);
+        point_lights[i].color = glm::vec3(unit(random), unit(random), unit(random));
+    }
+}
+
+static void movePointLights(const double time) {
+    for (size_t i = 0; i < point_lights.size(); i++) {
+        const auto& anchor = point_light_anchors[i];
+        const float angle = static_cast<float>(time) * 0.5f + anchor.w;
+        point_lights[i].position = glm::vec3(anchor) + glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+    }
+}
 Core::Core() : m_camera(std::make_shared<gl::Camera>()), m_light(std::make_shared<gl::Light>()) {
 
-    m_light->position = glm::vec3(0, 5, 0);
+    m_light->position = glm::vec3(0.4f, 1.0f, 0.3f);
+    m_light->directional = true;
 
     auto cube = gl::Cube(1);
     auto cone = gl::Cone(8,4);
@@ -41,10 +137,12 @@ Core::Core() : m_camera(std::make_shared<gl::Camera>()), m_light(std::make_share
 
     auto object2 = Object("cube");
     object2.transform.setPosition(glm::vec3(0, 0, 5));
+    object2.occluder = occlusion_culler.addOccluder(cube.getVertexData(), cube.getIndices());
 
 
     auto object3 = Object("cylinder");
     object3.transform.setPosition(glm::vec3(5, 0, 0));
+    object3.occluder = occlusion_culler.addOccluder(cylinder.getVertexData(), cylinder.getIndices());
 
     auto object4 = Object("sphere");
     object4.transform.setPosition(glm::vec3(-5, 0, 0));
@@ -65,35 +163,434 @@ Core::Core() : m_camera(std::make_shared<gl::Camera>()), m_light(std::make_share
     obj_mesh = gl::Mesh::loadStaticMesh(name);
     obj_transform.setScale(glm::vec3(0.1));
 
-    skinned_mesh = gl::SkeletalMesh::loadFbx("Resources/Models/Samples/walking.fbx");
+    skinned_mesh = std::make_shared<gl::SkinnedMesh>(gl::SkeletalMesh::loadFbx("Resources/Models/Samples/walking.fbx"));
     skinned_transform.setScale(glm::vec3(0.01f));
-    skinned_mesh.skeleton.setCurrentAnimation(0);
+    skinned_mesh->skeleton.compressAnimations();
+    gl::SkeletalMesh::printMemoryReport(*skinned_mesh, "walking.fbx");
+    skinned_mesh->skeleton.setCurrentAnimation(0);
+    pre_skinned_mesh = gl::Graphics::createPreSkinnedMesh(skinned_mesh->draw_mesh);
+
+    walker_node = scene_graph.addNode(gl::SCENE_ROOT);  // Follows skinned_transform, set each frame
+    hand_node = scene_graph.addNode(walker_node);
+    prop_node = scene_graph.addNode(hand_node, glm::vec3(0.0f, 10.0f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(8.0f));
+    if (const auto it = skinned_mesh->skeleton.bone_map_.find("mixamorig:RightHand"); it != skinned_mesh->skeleton.bone_map_.end()) {
+        hand_bone = static_cast<int>(it->second);
+    }
+
+    // A grid of walkers sharing the mesh above, each with its own speed and phase
+    constexpr int crowd_rows = 20;
+    constexpr int crowd_columns = 25;
+    constexpr float crowd_spacing = 1.5f;
+    crowd = std::make_unique<gl::SkinnedCrowd>(skinned_mesh);
+    const float walk_duration = skinned_mesh->skeleton.getAnimationDuration(0);
+    for (int row = 0; row < crowd_rows; row++) {
+        for (int column = 0; column < crowd_columns; column++) {
+            const int i = row * crowd_columns + column;
+            gl::Transform transform;
+            transform.setPosition(glm::vec3((column - crowd_columns / 2) * crowd_spacing, -0.5f, 10.0f + row * crowd_spacing));
+            transform.setScale(glm::vec3(0.01f));
+            const double speed = 0.8 + 0.4 * ((i * 37) % 101) / 100.0;
+            const double phase = walk_duration * ((i * 53) % 97) / 97.0;
+            crowd->addInstance(transform, 0, speed, phase);
+        }
+    }
+    // Walkers past this distance are posed on the GPU from a pre-sampled texture
+    constexpr float baked_distance = 15.0f;
+    crowd->setAnimationTexture(std::make_shared<gl::AnimationTexture>(gl::AnimationTextures::bake(skinned_mesh->skeleton)),
+        baked_distance);
+
+    animation_system.addSkeleton(&skinned_mesh->skeleton);
+    animation_system.addCrowd(crowd.get());
 
 
 }
 
 static bool animation_playing = true;
 
+// Skinning benchmark (B): draws extra copies of the walker for a fixed number of frames in each skinning
+// mode and prints the average GPU time of the skinned pass
+constexpr int BENCHMARK_COPIES = 100;
+constexpr int BENCHMARK_FRAMES = 240;   // Per mode
+constexpr int BENCHMARK_WARMUP = 10;    // Frames ignored after switching modes, timer results arrive late
+static gl::GpuTimer skinned_timer;
+static int benchmark_frame = -1;        // -1 when not running
+static double benchmark_gpu_ms[2] = {};
+
+static gl::Transform benchmarkTransform(const int i) {
+    gl::Transform transform = skinned_transform;
+    transform.setPosition(glm::vec3((i % 10 - 5) * 1.0f, 0.0f, -3.0f - (i / 10) * 1.0f));
+    return transform;
+}
+
+static void stepSkinningBenchmark() {
+    const int mode = benchmark_frame / BENCHMARK_FRAMES;
+    if (benchmark_frame % BENCHMARK_FRAMES >= BENCHMARK_WARMUP) {
+        benchmark_gpu_ms[mode] += skinned_timer.getMilliseconds();
+    }
+
+    benchmark_frame++;
+    if (benchmark_frame < 2 * BENCHMARK_FRAMES) {
+        gl::Graphics::setSkinningMode(benchmark_frame < BENCHMARK_FRAMES ? gl::LINEAR_BLEND : gl::DUAL_QUATERNION);
+        return;
+    }
+
+    const auto palette_size = skinned_mesh->skeleton.palette_size_;
+    const char* names[2] = {"Linear blend", "Dual quaternion"};
+    const size_t bytes_per_bone[2] = {sizeof(glm::mat4), 2 * sizeof(glm::vec4)};
+    for (int i = 0; i < 2; i++) {
+        debug::print(std::string(names[i]) + " skinning: "
+            + std::to_string(benchmark_gpu_ms[i] / (BENCHMARK_FRAMES - BENCHMARK_WARMUP)) + " ms GPU per frame, "
+            + std::to_string((BENCHMARK_COPIES + 1) * palette_size * bytes_per_bone[i]) + " palette bytes per frame");
+    }
+    gl::Graphics::setSkinningMode(gl::LINEAR_BLEND);
+    benchmark_frame = -1;
+}
+
+// Main light, clustered point lights and shadows for the active shader
+static void setLighting(const gl::Light& light) {
+    gl::Graphics::setLight(light);
+    gl::Graphics::setLightClusters(light_clusters);
+    gl::Graphics::setShadows(shadows_enabled ? &shadows : nullptr);
+}
+
+/**
+ * Renders the cascades of the main light. Static casters are drawn only into cascades whose cache was invalidated;
+ * the walker and its prop are drawn every frame on top of the cached depth. With pre-skinning the walker is drawn
+ * from pre_skinned_mesh, skinned by the "Pre-skinning" pass.
+ * @param viewport - Size of the scene framebuffer, restored at the end
+ */
+void Core::renderShadows(const glm::ivec2& viewport) const {
+    const auto start = std::chrono::steady_clock::now();
+    shadows.update(*m_camera, -glm::normalize(m_light->position), scene_index.getBounds(), static_shadow_version);
+
+    // The walker's palette is drawn into the shadow maps, so its animation job has to finish first
+    animation_system.sync();
+
+    static std::vector<uint64_t> casters;
+    size_t static_casters = 0;
+    for (int cascade = 0; cascade < gl::CascadedShadows::CASCADE_COUNT; cascade++) {
+        const auto& light_view = shadows.getLightView();
+        const auto& projection = shadows.getProjection(cascade);
+        if (shadows.needsStaticPass(cascade)) {
+            shadows.beginStaticPass(cascade);
+            gl::Graphics::useShadowCasterShader();
+            gl::Graphics::setViewProjection(light_view, projection);
+            casters.clear();
+            scene_index.queryFrustum(gl::Frustum::fromMatrix(projection * light_view), casters);
+            for (const auto id : casters) {
+                const bool submesh = id & MESH_SUBMESH;
+                const auto* shape = submesh ? &obj_mesh.objects[id & ~MESH_SUBMESH].shape : m_shapes[id].shape;
+                const auto& material = submesh ? obj_mesh.objects[id & ~MESH_SUBMESH].material : m_shapes[id].material;
+                if (material.alpha_mode == gl::ALPHA_BLEND) continue;
+                const auto& transform = submesh ? obj_transform : m_shapes[id].transform;
+                gl::Graphics::drawDepth(shape, transform.getModelMatrix());
+            }
+            static_casters += casters.size();
+        }
+
+        shadows.beginDynamicPass(cascade);
+        if (pre_skinning) {
+            gl::Graphics::useShadowCasterShader();
+            gl::Graphics::setViewProjection(light_view, projection);
+            for (const auto& obj : pre_skinned_mesh.objects) {
+                gl::Graphics::drawDepth(&obj.shape, skinned_transform.getModelMatrix());
+            }
+        } else {
+            gl::Graphics::useSkinnedShadowCasterShader();
+            gl::Graphics::setViewProjection(light_view, projection);
+            gl::Graphics::drawSkinnedDepth(skinned_mesh.get(), skinned_transform);
+        }
+        if (hand_bone >= 0) {
+            // World matrix from the last scene graph update, a frame behind the hand
+            gl::Graphics::useShadowCasterShader();
+            gl::Graphics::setViewProjection(light_view, projection);
+            gl::Graphics::drawDepth(gl::Graphics::getShape("cube"), scene_graph.getWorldMatrix(prop_node));
+        }
+    }
+    shadows.end(viewport.x, viewport.y);
+
+    Profiler::time("Shadow pass (CPU)",
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    Profiler::count("Static shadow casters drawn", static_casters);
+}
+
 void Core::draw() const {
-    gl::Graphics::usePhongShader();
-    gl::Graphics::setCameraUniforms(m_camera.get());
-    gl::Graphics::setLight(*m_light);
-    for (const auto& obj : m_shapes) {
-        gl::Graphics::drawObject(obj.shape, obj.transform, obj.material);
+    const auto viewport = Window::getRenderSize();
+    static std::vector<uint64_t> visible;
+    visible.clear();
+    const glm::mat4 view_projection = m_camera->getProjection() * m_camera->getViewMatrix();
+    scene_index.queryFrustum(gl::Frustum::fromMatrix(view_projection), visible);
+
+    if (occlusion_culling) {
+        const auto start = std::chrono::steady_clock::now();
+        occlusion_culler.render(view_projection);
+        const auto rasterized = std::chrono::steady_clock::now();
+
+        const size_t tested = visible.size();
+        std::erase_if(visible, [this](const uint64_t id) {
+            const int proxy = id & MESH_SUBMESH ? submesh_proxies[id & ~MESH_SUBMESH] : m_shapes[id].proxy;
+            return !occlusion_culler.isVisible(scene_index.getFatBounds(proxy));
+        });
+        const auto end = std::chrono::steady_clock::now();
+
+        Profiler::time("Occlusion raster (CPU)", std::chrono::duration<double, std::milli>(rasterized - start).count());
+        Profiler::time("Occlusion tests (CPU)", std::chrono::duration<double, std::milli>(end - rasterized).count());
+        Profiler::count("Occlusion culled", tested - visible.size());
+        Profiler::count("Occlusion culled %", tested ? 100 * (tested - visible.size()) / tested : 0);
+    }
+
+    render_queue.clear();
+    for (const auto id : visible) {
+        const bool submesh = id & MESH_SUBMESH;
+        const auto* shape = submesh ? &obj_mesh.objects[id & ~MESH_SUBMESH].shape : m_shapes[id].shape;
+        const auto& transform = submesh ? obj_transform : m_shapes[id].transform;
+        const auto& material = submesh ? obj_mesh.objects[id & ~MESH_SUBMESH].material : m_shapes[id].material;
+        render_queue.submit(shape, transform, material, id);
+    }
+    render_queue.sort(*m_camera, !use_weighted_oit);
+    Profiler::count("Static objects drawn", visible.size());
+
+    occlusion_queries.beginFrame(m_camera.get());
+    const auto draw_item = [](const gl::RenderItem& item) {
+        if (gpu_occlusion && occlusion_queries.isHeavy(*item.shape)) {
+            occlusion_queries.drawObject(item.key, item.shape, *item.model_matrix, *item.normal_matrix, *item.material);
+        } else {
+            gl::Graphics::drawObject(item.shape, *item.model_matrix, *item.normal_matrix, *item.material);
+        }
+    };
+
+    GLint scene_framebuffer;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &scene_framebuffer);
+    frame_graph.reset();
+    auto scene = frame_graph.importFramebuffer("Scene", scene_framebuffer, viewport.x, viewport.y);
+    auto clusters = frame_graph.importBuffer("Light clusters");
+    auto shadow_maps = frame_graph.importTexture("Shadow maps", shadows.getShadowTexture());
+    auto pre_skinned = frame_graph.importBuffer("Pre-skinned walker");
+
+    // Passes that shade with setLighting sample both
+    const auto read_lighting = [&](gl::FrameGraph::Builder& builder) {
+        builder.read(clusters);
+        if (shadows_enabled) builder.read(shadow_maps);
+    };
+
+    frame_graph.addPass("Light binning", [&](gl::FrameGraph::Builder& builder) {
+        clusters = builder.write(clusters);
+    }, [this, viewport](const gl::FrameGraph&) {
+        const auto start = std::chrono::steady_clock::now();
+        light_clusters.update(point_lights, *m_camera, viewport.x, viewport.y);
+        Profiler::time("Light binning (CPU)",
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    });
+
+    // Skins the walker once for the shadow and skinned passes, which then draw it as a static mesh
+    if (pre_skinning) {
+        frame_graph.addPass("Pre-skinning", [&](gl::FrameGraph::Builder& builder) {
+            pre_skinned = builder.write(pre_skinned);
+        }, [this](const gl::FrameGraph&) {
+            animation_system.sync();
+            gl::Graphics::preSkin(skinned_mesh.get(), pre_skinned_mesh);
+        });
+    }
+
+    // Culled when shadows are off, since nothing reads the maps then
+    frame_graph.addPass("Shadows", [&](gl::FrameGraph::Builder& builder) {
+        if (pre_skinning) builder.read(pre_skinned);
+        shadow_maps = builder.write(shadow_maps);
+    }, [this, viewport](const gl::FrameGraph&) {
+        renderShadows(viewport);
+    });
+
+    if (deferred_shading) {
+        gl::GBuffer g_buffer;
+        frame_graph.addPass("G-buffer", [&](gl::FrameGraph::Builder& builder) {
+            g_buffer = gl::GBuffer::create(builder, viewport.x, viewport.y);
+        }, [this, draw_item](const gl::FrameGraph&) {
+            static_timer.begin();
+            gl::GBuffer::clear();
+            gl::Graphics::useGBufferShader();
+            gl::Graphics::setCameraUniforms(m_camera.get());
+            for (const auto& item : render_queue.getOpaque()) {
+                draw_item(item);
+            }
+            for (const auto& item : render_queue.getAlphaTested()) {
+                draw_item(item);
+            }
+        });
+        frame_graph.addPass("Deferred lighting", [&](gl::FrameGraph::Builder& builder) {
+            g_buffer.read(builder);
+            read_lighting(builder);
+            scene = builder.write(scene);
+        }, [this, g_buffer](const gl::FrameGraph& graph) {
+            gl::Graphics::useDeferredLightingShader();
+            gl::Graphics::setCameraUniforms(m_camera.get());
+            setLighting(*m_light);
+            gl::Graphics::drawDeferredLighting(graph, g_buffer, m_camera.get());
+            static_timer.end();
+        });
+    } else {
+        if (depth_prepass) {
+            frame_graph.addPass("Depth prepass", [&](gl::FrameGraph::Builder& builder) {
+                scene = builder.write(scene);
+            }, [this](const gl::FrameGraph&) {
+                static_timer.begin();
+                gl::Graphics::useDepthShader();
+                gl::Graphics::setCameraUniforms(m_camera.get());
+                render_queue.drawDepthPrepass();
+            });
+        }
+        frame_graph.addPass("Forward opaque", [&](gl::FrameGraph::Builder& builder) {
+            read_lighting(builder);
+            scene = builder.write(scene);
+        }, [this, draw_item](const gl::FrameGraph&) {
+            if (!depth_prepass) static_timer.begin();
+            gl::Graphics::usePhongShader();
+            gl::Graphics::setCameraUniforms(m_camera.get());
+            setLighting(*m_light);
+            gl::Graphics::setDepthEqual(depth_prepass);
+            for (const auto& item : render_queue.getOpaque()) {
+                draw_item(item);
+            }
+            gl::Graphics::setDepthEqual(false);
+            for (const auto& item : render_queue.getAlphaTested()) {
+                draw_item(item);
+            }
+            static_timer.end();
+        });
     }
-    gl::Graphics::drawMesh(&obj_mesh, obj_transform);
 
-    gl::Graphics::useSkinnedShader();
-    gl::Graphics::setCameraUniforms(m_camera.get());
-    gl::Graphics::setLight(*m_light);
+    frame_graph.addPass("Skinned", [&](gl::FrameGraph::Builder& builder) {
+        read_lighting(builder);
+        if (pre_skinning) builder.read(pre_skinned);
+        scene = builder.write(scene);
+    }, [this](const gl::FrameGraph&) {
+        gl::Graphics::useSkinnedShader();
+        gl::Graphics::setCameraUniforms(m_camera.get());
+        setLighting(*m_light);
+
+        // Animation jobs overlap the static draws above; wait for them and upload before drawing skinned meshes.
+        // Already done by the shadow or pre-skinning pass when those run
+        animation_system.sync();
+        skinned_timer.begin();
+        const int copies = benchmark_frame >= 0 ? BENCHMARK_COPIES : 0;
+        if (pre_skinning) {
+            // Skinned once by the pre-skinning pass, so every draw of the walker is an ordinary static mesh draw
+            gl::Graphics::usePhongShader();
+            gl::Graphics::setCameraUniforms(m_camera.get());
+            setLighting(*m_light);
+            gl::Graphics::drawMesh(&pre_skinned_mesh, skinned_transform);
+            for (int i = 0; i < copies; i++) {
+                gl::Graphics::drawMesh(&pre_skinned_mesh, benchmarkTransform(i));
+            }
+        } else {
+            gl::Graphics::drawSkinned(skinned_mesh.get(), skinned_transform);
+            for (int i = 0; i < copies; i++) {
+                gl::Graphics::drawSkinned(skinned_mesh.get(), benchmarkTransform(i));
+            }
+        }
+        skinned_timer.end();
+        Profiler::time("Skinned pass (GPU)", skinned_timer.getMilliseconds());
+
+        if (hand_bone >= 0) {
+            auto& skeleton = skinned_mesh->skeleton;
+            skeleton.updateBoneMatrices();
+            scene_graph.setLocalMatrix(walker_node, skinned_transform.getModelMatrix());
+            scene_graph.setLocalMatrix(hand_node, skeleton.global_transforms_[hand_bone + 1]);
+            const auto start = std::chrono::steady_clock::now();
+            Profiler::count("Scene nodes updated", scene_graph.updateWorldTransforms());
+            Profiler::time("Scene graph update", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+            gl::Graphics::usePhongShader();
+            gl::Graphics::setCameraUniforms(m_camera.get());
+            setLighting(*m_light);
+            gl::Graphics::drawObject(gl::Graphics::getShape("cube"), scene_graph.getWorldMatrix(prop_node),
+                scene_graph.getNormalMatrix(prop_node));
+        }
+    });
+
+    frame_graph.addPass("Crowd", [&](gl::FrameGraph::Builder& builder) {
+        read_lighting(builder);
+        scene = builder.write(scene);
+    }, [this](const gl::FrameGraph&) {
+        gl::Graphics::useSkinnedInstancedShader();
+        gl::Graphics::setCameraUniforms(m_camera.get());
+        setLighting(*m_light);
+        gl::Graphics::drawCrowd(crowd.get());
+
+        gl::Graphics::useSkinnedBakedShader();
+        gl::Graphics::setCameraUniforms(m_camera.get());
+        setLighting(*m_light);
+        gl::Graphics::drawCrowdBaked(crowd.get());
+    });
+
+    // Blended submeshes last, over all opaque geometry including the characters
+    if (!render_queue.getBlended().empty() && use_weighted_oit) {
+        gl::WeightedOit::Targets oit_targets;
+        frame_graph.addPass("Transparency", [&](gl::FrameGraph::Builder& builder) {
+            read_lighting(builder);
+            builder.read(scene);
+            oit_targets = gl::WeightedOit::create(builder, viewport.x, viewport.y);
+        }, [this, draw_item, viewport, scene](const gl::FrameGraph& graph) {
+            gl::Graphics::usePhongShader();
+            gl::Graphics::setCameraUniforms(m_camera.get());
+            setLighting(*m_light);
+            weighted_oit.begin(graph.getFramebuffer(scene), viewport.x, viewport.y);
+            gl::Graphics::setWeightedOit(true);
+            for (const auto& item : render_queue.getBlended()) {
+                draw_item(item);
+            }
+            gl::Graphics::setWeightedOit(false);
+        });
+        frame_graph.addPass("OIT composite", [&](gl::FrameGraph::Builder& builder) {
+            builder.read(oit_targets.accumulation);
+            builder.read(oit_targets.revealage);
+            scene = builder.write(scene);
+        }, [oit_targets](const gl::FrameGraph& graph) {
+            weighted_oit.composite(graph, oit_targets);
+        });
+    } else if (!render_queue.getBlended().empty()) {
+        frame_graph.addPass("Transparency", [&](gl::FrameGraph::Builder& builder) {
+            read_lighting(builder);
+            scene = builder.write(scene);
+        }, [this, draw_item](const gl::FrameGraph&) {
+            gl::Graphics::usePhongShader();
+            gl::Graphics::setCameraUniforms(m_camera.get());
+            setLighting(*m_light);
+            gl::Graphics::setBlending(true);
+            for (const auto& item : render_queue.getBlended()) {
+                draw_item(item);
+            }
+            gl::Graphics::setBlending(false);
+        });
+    }
 
-    gl::Graphics::drawSkinned(&skinned_mesh, skinned_transform);
+    // Boxes test against the finished depth buffer; results decide next frame's conditional draws
+    frame_graph.addPass("Occlusion queries", [&](gl::FrameGraph::Builder& builder) {
+        builder.read(scene);
+        builder.setSideEffect();
+    }, [this](const gl::FrameGraph&) {
+        occlusion_queries.issueQueries(m_camera.get());
+    });
+
+    frame_graph.markOutput(scene);
+    frame_graph.compile();
+    if (print_frame_graph) {
+        frame_graph.print();
+        print_frame_graph = false;
+    }
+    Profiler::count("Frame graph transient KB", frame_graph.getTransientBytes() / 1024);
+    Profiler::count("Frame graph aliasing saved KB",
+        (frame_graph.getTransientBytes() - frame_graph.getAllocatedBytes()) / 1024);
+    frame_graph.execute();
+    Profiler::count("Shader variants compiled", gl::ShaderVariants::getProgramCount());
+    Profiler::time("Static pass (GPU)", static_timer.getMilliseconds());
 }
 
 static glm::vec2 rotation(0.0f, 0.0f);
 static auto last_mouse_pos = Window::getMousePosition();
 void Core::update(double delta_time) {
     controller(delta_time);
+    updateSceneIndex();
+    movePointLights(Window::getCurrentTime());
 
 
 
@@ -115,9 +612,45 @@ void Core::update(double delta_time) {
         m_camera->setLook(newLook);
     }
 
-    if (animation_playing) {
-        skinned_mesh.skeleton.playCurrentAnimation(delta_time);
+    if (benchmark_frame >= 0) {
+        stepSkinningBenchmark();
+    }
+
+    // Still updated while paused so crowd instances switch paths as the camera moves
+    animation_system.update(animation_playing ? delta_time : 0.0, *m_camera);
+}
+
+// Inserts new objects into the scene index and moves those whose transform changed since the last update
+void Core::updateSceneIndex() {
+    for (size_t i = 0; i < m_shapes.size(); i++) {
+        auto& obj = m_shapes[i];
+        if (obj.proxy >= 0 && obj.indexed_version == obj.transform.getVersion()) continue;
+
+        const auto bounds = gl::AABB{obj.shape->min, obj.shape->max}.transformed(obj.transform.getModelMatrix());
+        if (obj.proxy < 0) {
+            obj.proxy = scene_index.createProxy(bounds, i);
+        } else {
+            scene_index.moveProxy(obj.proxy, bounds);
+        }
+        static_shadow_version++;
+        if (obj.occluder >= 0) {
+            occlusion_culler.setOccluderTransform(obj.occluder, obj.transform.getModelMatrix());
+        }
+        obj.indexed_version = obj.transform.getVersion();
+    }
+
+    if (submesh_proxies.size() == obj_mesh.objects.size() && submesh_version == obj_transform.getVersion()) return;
+    for (size_t i = 0; i < obj_mesh.objects.size(); i++) {
+        const auto& shape = obj_mesh.objects[i].shape;
+        const auto bounds = gl::AABB{shape.min, shape.max}.transformed(obj_transform.getModelMatrix());
+        if (i >= submesh_proxies.size()) {
+            submesh_proxies.push_back(scene_index.createProxy(bounds, MESH_SUBMESH | i));
+        } else {
+            scene_index.moveProxy(submesh_proxies[i], bounds);
+        }
     }
+    submesh_version = obj_transform.getVersion();
+    static_shadow_version++;
 }
 
 void Core::controller(double delta_time) {
@@ -155,12 +688,81 @@ void Core::controller(double delta_time) {
     }
 }
 
+void Core::setDeferredShading(const bool deferred) {
+    deferred_shading = deferred;
+}
+
 void Core::keyPressed(int key) {
     switch (key) {
     case GLFW_KEY_P: {
         animation_playing = !animation_playing;
         break;
     }
+    case GLFW_KEY_K: {
+        const auto mode = gl::Graphics::getSkinningMode();
+        gl::Graphics::setSkinningMode(mode == gl::LINEAR_BLEND ? gl::DUAL_QUATERNION : gl::LINEAR_BLEND);
+        break;
+    }
+    case GLFW_KEY_O: {
+        occlusion_culling = !occlusion_culling;
+        debug::print(std::string("Occlusion culling ") + (occlusion_culling ? "on" : "off"));
+        break;
+    }
+    case GLFW_KEY_G: {
+        gpu_occlusion = !gpu_occlusion;
+        debug::print(std::string("GPU occlusion queries ") + (gpu_occlusion ? "on" : "off"));
+        break;
+    }
+    case GLFW_KEY_Z: {
+        depth_prepass = !depth_prepass;
+        debug::print(std::string("Depth prepass ") + (depth_prepass ? "on" : "off"));
+        break;
+    }
+    case GLFW_KEY_I: {
+        use_weighted_oit = !use_weighted_oit;
+        debug::print(std::string("Weighted blended OIT ") + (use_weighted_oit ? "on" : "off"));
+        break;
+    }
+    case GLFW_KEY_F: {
+        print_frame_graph = true;
+        break;
+    }
+    case GLFW_KEY_R: {
+        auto& dynamic_resolution = Window::getDynamicResolution();
+        dynamic_resolution.setEnabled(!dynamic_resolution.isEnabled());
+        debug::print(std::string("Dynamic resolution ") + (dynamic_resolution.isEnabled() ? "on" : "off"));
+        break;
+    }
+    case GLFW_KEY_H: {
+        shadows_enabled = !shadows_enabled;
+        debug::print(std::string("Shadows ") + (shadows_enabled ? "on" : "off"));
+        break;
+    }
+    case GLFW_KEY_L: {
+        point_light_setting = (point_light_setting + 1) % std::size(POINT_LIGHT_COUNTS);
+        createPointLights(POINT_LIGHT_COUNTS[point_light_setting]);
+        debug::print("Point lights: " + std::to_string(point_lights.size()));
+        break;
+    }
+    case GLFW_KEY_T: {
+        if (benchmark_frame >= 0) break;    // Would time linear blend pre-skinning under both modes' labels
+        pre_skinning = !pre_skinning;
+        debug::print(std::string("Transform feedback pre-skinning ") + (pre_skinning ? "on" : "off"));
+        break;
+    }
+    case GLFW_KEY_B: {
+        if (benchmark_frame < 0) {
+            if (pre_skinning) {
+                // preSkin is always linear blend, so the skinned shaders must draw for the modes to differ
+                pre_skinning = false;
+                debug::print("Transform feedback pre-skinning off for the skinning benchmark");
+            }
+            benchmark_frame = 0;
+            benchmark_gpu_ms[0] = benchmark_gpu_ms[1] = 0.0;
+            gl::Graphics::setSkinningMode(gl::LINEAR_BLEND);
+        }
+        break;
+    }
 
     }
 }
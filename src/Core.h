@@ -18,6 +18,10 @@ struct Object {
     const gl::DrawShape* shape;
     gl::Transform transform;
     gl::DrawMaterial material;
+
+    int proxy = -1;                 // Leaf in the scene index, -1 until indexed
+    uint64_t indexed_version = 0;   // Transform version the leaf was last updated for
+    int occluder = -1;              // Occluder id in the occlusion culler, -1 if this object hides nothing
 };
 
 class Core {
@@ -30,7 +34,12 @@ public:
     void controller(double delta_time);
 
     void keyPressed(int key);
+
+    static void setDeferredShading(bool deferred);
 private:
+    void updateSceneIndex();
+    void renderShadows(const glm::ivec2& viewport) const;
+
     std::shared_ptr<gl::Camera> m_camera;
     std::shared_ptr<gl::Light> m_light;
     std::vector<Object> m_shapes;
@@ -1,6 +1,8 @@
 #pragma once
 #include <iostream>
 
+#include "GL/glew.h"
+
 #ifndef NDEBUG
     #define DEBUG_ENABLED 1
 #else
@@ -0,0 +1,115 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+std::vector<std::thread> JobSystem::workers_;
+std::deque<JobSystem::Job> JobSystem::queue_;
+std::mutex JobSystem::mutex_;
+std::condition_variable JobSystem::wake_;
+bool JobSystem::running_ = false;
+
+/**
+ * Starts the worker threads.
+ * @param num_workers - Number of workers, or 0 for one per hardware thread besides the main thread
+ */
+void JobSystem::initialize(unsigned int num_workers) {
+    if (running_) return;
+    if (num_workers == 0) {
+        const unsigned int hardware_threads = std::thread::hardware_concurrency();
+        num_workers = hardware_threads > 1 ? hardware_threads - 1 : 0;
+    }
+
+    running_ = true;
+    for (unsigned int i = 0; i < num_workers; i++) {
+        workers_.emplace_back(workerLoop);
+    }
+}
+
+void JobSystem::shutDown() {
+    {
+        std::lock_guard lock(mutex_);
+        running_ = false;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+    queue_.clear();
+}
+
+/**
+ * Splits [0, count) into jobs of at most grain_size items and queues them. Runs everything on the
+ * calling thread when there are no workers.
+ * @param count - Number of items
+ * @param grain_size - Items per job; large enough that a job outweighs the cost of queueing it
+ * @param function - Called once per job with the item range [begin, end)
+ * @return Counter to wait on
+ */
+JobCounter JobSystem::dispatch(const size_t count, size_t grain_size, const JobFunction& function) {
+    grain_size = std::max<size_t>(grain_size, 1);
+    const size_t num_jobs = (count + grain_size - 1) / grain_size;
+    auto counter = std::make_shared<std::atomic<size_t>>(num_jobs);
+    if (num_jobs == 0) return counter;
+
+    if (workers_.empty()) {
+        function(0, count);
+        counter->store(0);
+        return counter;
+    }
+
+    const auto shared_function = std::make_shared<const JobFunction>(function);
+    {
+        std::lock_guard lock(mutex_);
+        for (size_t begin = 0; begin < count; begin += grain_size) {
+            queue_.push_back({shared_function, begin, std::min(begin + grain_size, count), counter});
+        }
+    }
+    wake_.notify_all();
+    return counter;
+}
+
+// Blocks until every job of a dispatch has finished, running queued jobs in the meantime
+void JobSystem::wait(const JobCounter& counter) {
+    if (!counter) return;
+    while (counter->load(std::memory_order_acquire) != 0) {
+        if (!runNextJob()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+unsigned int JobSystem::getWorkerCount() {
+    return static_cast<unsigned int>(workers_.size());
+}
+
+void JobSystem::workerLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(mutex_);
+            wake_.wait(lock, [] { return !queue_.empty() || !running_; });
+            if (!running_) return;
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        runJob(job);
+    }
+}
+
+bool JobSystem::runNextJob() {
+    Job job;
+    {
+        std::lock_guard lock(mutex_);
+        if (queue_.empty()) return false;
+        job = std::move(queue_.front());
+        queue_.pop_front();
+    }
+    runJob(job);
+    return true;
+}
+
+void JobSystem::runJob(const Job& job) {
+    (*job.function)(job.begin, job.end);
+    job.counter->fetch_sub(1, std::memory_order_release);
+}
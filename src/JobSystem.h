@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of jobs of one dispatch still running; JobSystem::wait on it is a barrier
+using JobCounter = std::shared_ptr<std::atomic<size_t>>;
+using JobFunction = std::function<void(size_t begin, size_t end)>;
+
+/**
+ * A fixed pool of worker threads running ranges of data-parallel work.
+ * Jobs must not touch GL, which stays on the main thread. A thread waiting on a counter runs queued
+ * jobs itself instead of blocking, so waiting never deadlocks and the main thread adds to the pool.
+ */
+class JobSystem {
+public:
+    static void initialize(unsigned int num_workers = 0);
+    static void shutDown();
+
+    static JobCounter dispatch(size_t count, size_t grain_size, const JobFunction& function);
+    static void wait(const JobCounter& counter);
+    static unsigned int getWorkerCount();
+
+private:
+    struct Job {
+        std::shared_ptr<const JobFunction> function;
+        size_t begin, end;
+        JobCounter counter;
+    };
+
+    static void workerLoop();
+    static bool runNextJob();
+    static void runJob(const Job& job);
+
+    static std::vector<std::thread> workers_;
+    static std::deque<Job> queue_;
+    static std::mutex mutex_;
+    static std::condition_variable wake_;
+    static bool running_;
+};
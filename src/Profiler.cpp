@@ -0,0 +1,56 @@
+#include "Profiler.h"
+
+#include <ranges>
+
+#include "imgui.h"
+
+std::mutex Profiler::mutex_;
+std::map<std::string, size_t> Profiler::current_;
+std::map<std::string, size_t> Profiler::previous_;
+std::map<std::string, double> Profiler::current_times_;
+std::map<std::string, double> Profiler::previous_times_;
+
+// Publishes last frame's counters and starts new ones
+void Profiler::beginFrame() {
+    std::lock_guard lock(mutex_);
+    previous_.swap(current_);
+    previous_times_.swap(current_times_);
+    for (auto& value : current_ | std::views::values) {
+        value = 0;
+    }
+    for (auto& value : current_times_ | std::views::values) {
+        value = 0.0;
+    }
+}
+
+/**
+ * Adds to a counter for the current frame. Callers on hot paths should sum locally and call once.
+ * @param name - Counter label shown in the UI
+ * @param amount - Value to add
+ */
+void Profiler::count(const std::string& name, const size_t amount) {
+    std::lock_guard lock(mutex_);
+    current_[name] += amount;
+}
+
+/**
+ * Adds to a timing for the current frame.
+ * @param name - Timing label shown in the UI
+ * @param milliseconds - Duration to add
+ */
+void Profiler::time(const std::string& name, const double milliseconds) {
+    std::lock_guard lock(mutex_);
+    current_times_[name] += milliseconds;
+}
+
+void Profiler::drawUI() {
+    std::lock_guard lock(mutex_);
+    if (ImGui::CollapsingHeader("Profiler", ImGuiTreeNodeFlags_DefaultOpen)) {
+        for (const auto& [name, value] : previous_times_) {
+            ImGui::Text("%s: %.3f ms", name.c_str(), value);
+        }
+        for (const auto& [name, value] : previous_) {
+            ImGui::Text("%s: %zu", name.c_str(), value);
+        }
+    }
+}
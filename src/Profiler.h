@@ -0,0 +1,23 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * Per-frame counters and timings shown in the UI. Values are accumulated during a frame and displayed
+ * during the next one, so the UI always shows complete numbers. May be called from job threads.
+ */
+class Profiler {
+public:
+    static void beginFrame();
+    static void count(const std::string& name, size_t amount);
+    static void time(const std::string& name, double milliseconds);
+    static void drawUI();
+
+private:
+    static std::mutex mutex_;
+    static std::map<std::string, size_t> current_;
+    static std::map<std::string, size_t> previous_;
+    static std::map<std::string, double> current_times_;
+    static std::map<std::string, double> previous_times_;
+};
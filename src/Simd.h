@@ -0,0 +1,155 @@
+#pragma once
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__)
+    #define SIMD_AVX 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define SIMD_SSE 1
+#endif
+
+#if defined(SIMD_AVX) || defined(SIMD_SSE)
+    #include <immintrin.h>
+#endif
+
+/**
+ * Thin wrappers over SSE/AVX registers so hot loops can be written once and compiled for the widest
+ * instruction set available. simd::f32xN is the widest type for the current build and falls back to
+ * plain floats on targets without SSE (e.g. Apple Silicon), so every caller keeps a scalar path.
+ * All loads and stores are unaligned.
+ */
+namespace simd {
+
+    // Scalar fallback for targets without SSE
+    struct f32x1 {
+        static constexpr int width = 1;
+        using mask = bool;
+        float v;
+
+        static f32x1 load(const float* p) { return {*p}; }
+        static f32x1 set1(const float x) { return {x}; }
+        void store(float* p) const { *p = v; }
+
+        friend f32x1 operator+(const f32x1 a, const f32x1 b) { return {a.v + b.v}; }
+        friend f32x1 operator-(const f32x1 a, const f32x1 b) { return {a.v - b.v}; }
+        friend f32x1 operator*(const f32x1 a, const f32x1 b) { return {a.v * b.v}; }
+        friend f32x1 operator/(const f32x1 a, const f32x1 b) { return {a.v / b.v}; }
+        friend mask operator<(const f32x1 a, const f32x1 b) { return a.v < b.v; }
+        friend mask operator>(const f32x1 a, const f32x1 b) { return a.v > b.v; }
+        friend f32x1 sqrt(const f32x1 a) { return {std::sqrt(a.v)}; }
+        friend f32x1 abs(const f32x1 a) { return {std::fabs(a.v)}; }
+        friend f32x1 min(const f32x1 a, const f32x1 b) { return {a.v < b.v ? a.v : b.v}; }
+        friend f32x1 max(const f32x1 a, const f32x1 b) { return {a.v > b.v ? a.v : b.v}; }
+        friend f32x1 select(const mask m, const f32x1 a, const f32x1 b) { return m ? a : b; }
+        friend bool any(const mask m) { return m; }
+        friend bool all(const mask m) { return m; }
+        friend int bits(const mask m) { return m ? 1 : 0; }  // Bit i set if lane i is true
+    };
+
+#ifdef SIMD_SSE
+    struct f32x4 {
+        static constexpr int width = 4;
+        struct mask { __m128 m; };
+        __m128 v;
+
+        static f32x4 load(const float* p) { return {_mm_loadu_ps(p)}; }
+        static f32x4 set1(const float x) { return {_mm_set1_ps(x)}; }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+
+        friend f32x4 operator+(const f32x4 a, const f32x4 b) { return {_mm_add_ps(a.v, b.v)}; }
+        friend f32x4 operator-(const f32x4 a, const f32x4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+        friend f32x4 operator*(const f32x4 a, const f32x4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+        friend f32x4 operator/(const f32x4 a, const f32x4 b) { return {_mm_div_ps(a.v, b.v)}; }
+        friend mask operator<(const f32x4 a, const f32x4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+        friend mask operator>(const f32x4 a, const f32x4 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+        friend f32x4 sqrt(const f32x4 a) { return {_mm_sqrt_ps(a.v)}; }
+        friend f32x4 abs(const f32x4 a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+        friend f32x4 min(const f32x4 a, const f32x4 b) { return {_mm_min_ps(a.v, b.v)}; }
+        friend f32x4 max(const f32x4 a, const f32x4 b) { return {_mm_max_ps(a.v, b.v)}; }
+        friend f32x4 select(const mask m, const f32x4 a, const f32x4 b) {
+            return {_mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v))};
+        }
+        friend bool any(const mask m) { return _mm_movemask_ps(m.m) != 0; }
+        friend bool all(const mask m) { return _mm_movemask_ps(m.m) == 0xF; }
+        friend int bits(const mask m) { return _mm_movemask_ps(m.m); }
+    };
+#endif
+
+#ifdef SIMD_AVX
+    struct f32x8 {
+        static constexpr int width = 8;
+        struct mask { __m256 m; };
+        __m256 v;
+
+        static f32x8 load(const float* p) { return {_mm256_loadu_ps(p)}; }
+        static f32x8 set1(const float x) { return {_mm256_set1_ps(x)}; }
+        void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+        friend f32x8 operator+(const f32x8 a, const f32x8 b) { return {_mm256_add_ps(a.v, b.v)}; }
+        friend f32x8 operator-(const f32x8 a, const f32x8 b) { return {_mm256_sub_ps(a.v, b.v)}; }
+        friend f32x8 operator*(const f32x8 a, const f32x8 b) { return {_mm256_mul_ps(a.v, b.v)}; }
+        friend f32x8 operator/(const f32x8 a, const f32x8 b) { return {_mm256_div_ps(a.v, b.v)}; }
+        friend mask operator<(const f32x8 a, const f32x8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+        friend mask operator>(const f32x8 a, const f32x8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+        friend f32x8 sqrt(const f32x8 a) { return {_mm256_sqrt_ps(a.v)}; }
+        friend f32x8 abs(const f32x8 a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+        friend f32x8 min(const f32x8 a, const f32x8 b) { return {_mm256_min_ps(a.v, b.v)}; }
+        friend f32x8 max(const f32x8 a, const f32x8 b) { return {_mm256_max_ps(a.v, b.v)}; }
+        friend f32x8 select(const mask m, const f32x8 a, const f32x8 b) { return {_mm256_blendv_ps(b.v, a.v, m.m)}; }
+        friend bool any(const mask m) { return _mm256_movemask_ps(m.m) != 0; }
+        friend bool all(const mask m) { return _mm256_movemask_ps(m.m) == 0xFF; }
+        friend int bits(const mask m) { return _mm256_movemask_ps(m.m); }
+    };
+    using f32xN = f32x8;
+#elif defined(SIMD_SSE)
+    using f32xN = f32x4;
+#else
+    using f32xN = f32x1;
+#endif
+
+    constexpr int WIDTH = f32xN::width;
+
+    /**
+     * out = a * b for column-major 4x4 matrices whose bottom row is (0, 0, 0, 1), skipping the work a
+     * full mat4 product spends on that row. out may alias a or b.
+     */
+    inline void mulAffine(const float* a, const float* b, float* out) {
+#ifdef SIMD_SSE
+        const __m128 a0 = _mm_loadu_ps(a);
+        const __m128 a1 = _mm_loadu_ps(a + 4);
+        const __m128 a2 = _mm_loadu_ps(a + 8);
+        const __m128 a3 = _mm_loadu_ps(a + 12);
+        __m128 r[4];
+        for (int j = 0; j < 4; j++) {
+            const float* col = b + 4 * j;
+            r[j] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(col[0])), _mm_mul_ps(a1, _mm_set1_ps(col[1]))),
+                              _mm_mul_ps(a2, _mm_set1_ps(col[2])));
+        }
+        r[3] = _mm_add_ps(r[3], a3);
+        for (int j = 0; j < 4; j++) {
+            _mm_storeu_ps(out + 4 * j, r[j]);
+        }
+#else
+        float r[16];
+        for (int j = 0; j < 4; j++) {
+            const float* col = b + 4 * j;
+            for (int i = 0; i < 3; i++) {
+                r[4 * j + i] = a[i] * col[0] + a[4 + i] * col[1] + a[8 + i] * col[2];
+            }
+            r[4 * j + 3] = 0.0f;
+        }
+        for (int i = 0; i < 3; i++) r[12 + i] += a[12 + i];
+        r[15] = 1.0f;
+        std::memcpy(out, r, sizeof(r));
+#endif
+    }
+
+    /**
+     * Rounds a count up to the next multiple of the widest SIMD width, used to pad SoA streams so
+     * kernels never need a scalar tail.
+     */
+    constexpr unsigned int padToWidth(const unsigned int count) {
+        return (count + 7u) & ~7u;
+    }
+}
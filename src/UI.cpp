@@ -2,10 +2,14 @@
 // Created by Marcus Winter on 11/19/25.
 //
 
+#include <GL/glew.h>
 #include "UI.h"
 
 
 #include "imgui.h"
+#include "Profiler.h"
+#include "Window.h"
+#include "render/DynamicResolution.h"
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
 
@@ -31,9 +35,11 @@ void UI::update() {
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
     ImGui::SetNextWindowPos({0, 0});
-    ImGui::SetNextWindowSize({200,200});
+    ImGui::SetNextWindowSize({260,200});
     ImGui::Begin("Settings");
     ImGui::Text("Hello, ImGui!");
+    Profiler::drawUI();
+    Window::getDynamicResolution().drawUI();
     ImGui::End();
 
     ImGui::Render();
@@ -5,10 +5,14 @@
 
 #define GLM_ENABLE_EXPERIMENTAL
 
+#include <cmath>
 #include <sstream>
 
+#include "render/DynamicResolution.h"
 #include "render/Graphics.h"
 #include "Core.h"
+#include "JobSystem.h"
+#include "Profiler.h"
 #include "imgui_internal.h"
 #include "UI.h"
 #include "backends/imgui_impl_glfw.h"
@@ -21,6 +25,7 @@ namespace gl {}
 
     int Window::width_, Window::height_;
     float Window::aspect_ratio_;
+    gl::DynamicResolution Window::dynamic_resolution_;
     bool Window::keys_[1024] = { false };
     bool Window::cursor_visible_ = true;
     double Window::mouse_x_, Window::mouse_y_ = 0;
@@ -37,6 +42,7 @@ namespace gl {}
         ui_ = new UI(window_);
 
         gl::Graphics::initialize();
+        JobSystem::initialize();
 
         core_ = new Core();
 
@@ -53,6 +59,7 @@ namespace gl {}
     void Window::update() {
         s_currentTime = glfwGetTime();
         displayFrameRate();
+        Profiler::beginFrame();
 
 
         const auto delta_time = static_cast<float>(s_currentTime - s_lastTime);
@@ -67,18 +74,23 @@ namespace gl {}
     }
 
     void Window::display() {
-        // Ensure proper viewport and disable scissor test for 3D rendering
-        glViewport(0, 0, width_, height_);
+        // The scene goes to the dynamic resolution target (or the window), with the viewport set for it
+        dynamic_resolution_.begin(width_, height_);
         glDisable(GL_SCISSOR_TEST);
 
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // Alpha = 1.0 for opaque background
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Reset blend state for 3D rendering
-        glEnable(GL_BLEND);
+        // Reset blend state for 3D rendering, only blended materials enable it
+        glDisable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
         core_->draw();
+
+        // Upscaled before UI::update draws at native resolution
+        dynamic_resolution_.end(width_, height_);
+        Profiler::time("Scene (GPU)", dynamic_resolution_.getSceneTime());
+        Profiler::count("Resolution scale %", static_cast<size_t>(std::lround(100.0f * dynamic_resolution_.getScale())));
     }
 
     void Window::shutDown() {
@@ -86,6 +98,7 @@ namespace gl {}
             glfwDestroyWindow(window_);
         }
         delete core_;
+        JobSystem::shutDown();
         delete ui_;
         gl::Graphics::tearDown();
         glfwTerminate();
@@ -114,6 +127,19 @@ float Window::getAspectRatio() {
         return aspect_ratio_;
     }
 
+glm::ivec2 Window::getSize() {
+        return {width_, height_};
+}
+
+// Size the scene is rendered at, smaller than getSize() while dynamic resolution scales it down
+glm::ivec2 Window::getRenderSize() {
+        return dynamic_resolution_.getRenderSize();
+}
+
+gl::DynamicResolution& Window::getDynamicResolution() {
+        return dynamic_resolution_;
+}
+
 bool Window::isCursorVisible() {
         return cursor_visible_;
 }
@@ -129,6 +155,8 @@ int Window::initializeGLFW(int width, int height) {
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
         glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_DEPTH_BITS, 24);    // Depth is blitted into offscreen targets of format GL_DEPTH24_STENCIL8
+        glfwWindowHint(GLFW_STENCIL_BITS, 8);
 #ifdef __APPLE__
         glfwWindowHint(GLFW_COCOA_RETINA_FRAMEBUFFER, GLFW_FALSE); // Disable Retina scaling
 #endif
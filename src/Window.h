@@ -4,6 +4,9 @@
 #include "glm/vec2.hpp"
 
 class Core;
+namespace gl {
+    class DynamicResolution;
+}
 
 namespace gl {}
     class Window {
@@ -24,6 +27,9 @@ namespace gl {}
         static glm::vec2 getMousePosition();
 
         static float getAspectRatio();
+        static glm::ivec2 getSize();
+        static glm::ivec2 getRenderSize();
+        static gl::DynamicResolution& getDynamicResolution();
         static bool isCursorVisible();
         static double getCurrentTime();
 
@@ -47,6 +53,7 @@ namespace gl {}
         static GLFWwindow *window_;
         static int width_, height_;
         static float aspect_ratio_;
+        static gl::DynamicResolution dynamic_resolution_;
 
         static bool keys_[1024];
         static bool cursor_visible_;
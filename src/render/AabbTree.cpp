@@ -0,0 +1,277 @@
+#include "AabbTree.h"
+
+#include <algorithm>
+
+namespace gl {
+
+    /**
+     * @param fat_margin - Distance leaf boxes extend past the tight bounds, in world units
+     */
+    AabbTree::AabbTree(const float fat_margin) : fat_margin_(fat_margin) {
+    }
+
+    /**
+     * Adds a leaf for a world-space box.
+     * @param bounds - Tight world-space bounds
+     * @param user_data - Returned by queries for this leaf
+     * @return Proxy id, stable until destroyProxy
+     */
+    int AabbTree::createProxy(const AABB& bounds, const uint64_t user_data) {
+        const int proxy = allocateNode();
+        nodes_[proxy].bounds = bounds.expanded(fat_margin_);
+        nodes_[proxy].user_data = user_data;
+        nodes_[proxy].height = 0;
+        insertLeaf(proxy);
+        num_proxies_++;
+        return proxy;
+    }
+
+    void AabbTree::destroyProxy(const int proxy) {
+        removeLeaf(proxy);
+        freeNode(proxy);
+        num_proxies_--;
+    }
+
+    /**
+     * Updates a leaf's bounds. Nothing changes while the new bounds stay inside the fat box; otherwise the leaf is
+     * reinserted with a fresh fat box.
+     * @return Whether the tree changed
+     */
+    bool AabbTree::moveProxy(const int proxy, const AABB& bounds) {
+        if (nodes_[proxy].bounds.contains(bounds)) return false;
+
+        removeLeaf(proxy);
+        nodes_[proxy].bounds = bounds.expanded(fat_margin_);
+        insertLeaf(proxy);
+        return true;
+    }
+
+    int AabbTree::getHeight() const {
+        return root_ == NULL_PROXY ? 0 : nodes_[root_].height;
+    }
+
+    // Fat bounds of everything in the tree, empty if the tree is
+    AABB AabbTree::getBounds() const {
+        return root_ == NULL_PROXY ? AABB() : nodes_[root_].bounds;
+    }
+
+    int AabbTree::allocateNode() {
+        if (free_list_ == NULL_PROXY) {
+            nodes_.emplace_back();
+            return static_cast<int>(nodes_.size()) - 1;
+        }
+        const int node = free_list_;
+        free_list_ = nodes_[node].parent;
+        nodes_[node] = Node();
+        return node;
+    }
+
+    void AabbTree::freeNode(const int node) {
+        nodes_[node].parent = free_list_;
+        nodes_[node].height = -1;
+        free_list_ = node;
+    }
+
+    // Descends towards the sibling whose enlargement costs the least surface area, then splits it
+    void AabbTree::insertLeaf(const int leaf) {
+        if (root_ == NULL_PROXY) {
+            root_ = leaf;
+            nodes_[leaf].parent = NULL_PROXY;
+            return;
+        }
+
+        const AABB leaf_bounds = nodes_[leaf].bounds;
+        int index = root_;
+        while (!nodes_[index].isLeaf()) {
+            const Node& node = nodes_[index];
+            const float area = node.bounds.surfaceArea();
+            const float combined_area = AABB::merge(node.bounds, leaf_bounds).surfaceArea();
+
+            // Cost of pairing the leaf with this node, and the growth every descendant pairing inherits
+            const float cost = 2.0f * combined_area;
+            const float inheritance_cost = 2.0f * (combined_area - area);
+
+            auto childCost = [&](const int child) {
+                const AABB& child_bounds = nodes_[child].bounds;
+                const float merged = AABB::merge(child_bounds, leaf_bounds).surfaceArea();
+                return (nodes_[child].isLeaf() ? merged : merged - child_bounds.surfaceArea()) + inheritance_cost;
+            };
+            const float cost1 = childCost(node.child1);
+            const float cost2 = childCost(node.child2);
+
+            if (cost < cost1 && cost < cost2) break;
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+
+        const int sibling = index;
+        const int old_parent = nodes_[sibling].parent;
+        const int new_parent = allocateNode();  // May reallocate nodes_, so no references are held across it
+        nodes_[new_parent].parent = old_parent;
+        nodes_[new_parent].bounds = AABB::merge(leaf_bounds, nodes_[sibling].bounds);
+        nodes_[new_parent].height = nodes_[sibling].height + 1;
+        nodes_[new_parent].child1 = sibling;
+        nodes_[new_parent].child2 = leaf;
+        nodes_[sibling].parent = new_parent;
+        nodes_[leaf].parent = new_parent;
+
+        if (old_parent == NULL_PROXY) {
+            root_ = new_parent;
+        } else if (nodes_[old_parent].child1 == sibling) {
+            nodes_[old_parent].child1 = new_parent;
+        } else {
+            nodes_[old_parent].child2 = new_parent;
+        }
+
+        refitAncestors(nodes_[leaf].parent);
+    }
+
+    // Replaces the leaf's parent with its sibling
+    void AabbTree::removeLeaf(const int leaf) {
+        if (leaf == root_) {
+            root_ = NULL_PROXY;
+            return;
+        }
+
+        const int parent = nodes_[leaf].parent;
+        const int grandparent = nodes_[parent].parent;
+        const int sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+
+        nodes_[sibling].parent = grandparent;
+        freeNode(parent);
+        if (grandparent == NULL_PROXY) {
+            root_ = sibling;
+            return;
+        }
+        if (nodes_[grandparent].child1 == parent) {
+            nodes_[grandparent].child1 = sibling;
+        } else {
+            nodes_[grandparent].child2 = sibling;
+        }
+        refitAncestors(grandparent);
+    }
+
+    // Rebalances and recomputes bounds and heights from a node up to the root
+    void AabbTree::refitAncestors(int node) {
+        while (node != NULL_PROXY) {
+            node = balance(node);
+            Node& n = nodes_[node];
+            const Node& child1 = nodes_[n.child1];
+            const Node& child2 = nodes_[n.child2];
+            n.height = 1 + std::max(child1.height, child2.height);
+            n.bounds = AABB::merge(child1.bounds, child2.bounds);
+            node = n.parent;
+        }
+    }
+
+    /**
+     * Rotates the taller grandchild up when a node's subtrees differ in height by more than one.
+     * @return The node now at this position in the tree
+     */
+    int AabbTree::balance(const int a) {
+        Node& node_a = nodes_[a];
+        if (node_a.isLeaf() || node_a.height < 2) return a;
+
+        const int b = node_a.child1;
+        const int c = node_a.child2;
+        Node& node_b = nodes_[b];
+        Node& node_c = nodes_[c];
+        const int difference = node_c.height - node_b.height;
+
+        // Lifts "up" (a child of a) into a's place; a keeps its other child "stay" and takes the shorter grandchild
+        auto rotate = [&](const int up, Node& node_up, const int stay, bool up_is_child2) {
+            const int f = node_up.child1;
+            const int g = node_up.child2;
+            Node& node_f = nodes_[f];
+            Node& node_g = nodes_[g];
+
+            node_up.child1 = a;
+            node_up.parent = node_a.parent;
+            node_a.parent = up;
+            if (node_up.parent == NULL_PROXY) {
+                root_ = up;
+            } else if (nodes_[node_up.parent].child1 == a) {
+                nodes_[node_up.parent].child1 = up;
+            } else {
+                nodes_[node_up.parent].child2 = up;
+            }
+
+            const bool keep_f = node_f.height > node_g.height;
+            const int taller = keep_f ? f : g;
+            const int shorter = keep_f ? g : f;
+            node_up.child2 = taller;
+            if (up_is_child2) node_a.child2 = shorter; else node_a.child1 = shorter;
+            nodes_[shorter].parent = a;
+
+            node_a.bounds = AABB::merge(nodes_[stay].bounds, nodes_[shorter].bounds);
+            node_up.bounds = AABB::merge(node_a.bounds, nodes_[taller].bounds);
+            node_a.height = 1 + std::max(nodes_[stay].height, nodes_[shorter].height);
+            node_up.height = 1 + std::max(node_a.height, nodes_[taller].height);
+            return up;
+        };
+
+        if (difference > 1) return rotate(c, node_c, b, true);
+        if (difference < -1) return rotate(b, node_b, c, false);
+        return a;
+    }
+
+    void AabbTree::collectLeaves(const int node, std::vector<uint64_t>& results) const {
+        if (nodes_[node].isLeaf()) {
+            results.push_back(nodes_[node].user_data);
+            return;
+        }
+        collectLeaves(nodes_[node].child1, results);
+        collectLeaves(nodes_[node].child2, results);
+    }
+
+    // Depth-first traversal; a subtree classified INSIDE is collected without further tests
+    template<typename Test>
+    void AabbTree::query(const Test& test, std::vector<uint64_t>& results) const {
+        if (root_ == NULL_PROXY) return;
+
+        std::vector<int> stack;
+        stack.reserve(64);
+        stack.push_back(root_);
+        while (!stack.empty()) {
+            const int index = stack.back();
+            stack.pop_back();
+            const Node& node = nodes_[index];
+
+            const Overlap overlap = test(node.bounds);
+            if (overlap == Overlap::OUTSIDE) continue;
+            if (overlap == Overlap::INSIDE || node.isLeaf()) {
+                collectLeaves(index, results);
+                continue;
+            }
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+
+    void AabbTree::queryAabb(const AABB& bounds, std::vector<uint64_t>& results) const {
+        query([&](const AABB& box) {
+            if (!bounds.overlaps(box)) return Overlap::OUTSIDE;
+            return bounds.contains(box) ? Overlap::INSIDE : Overlap::INTERSECTING;
+        }, results);
+    }
+
+    void AabbTree::querySphere(const glm::vec3& center, const float radius, std::vector<uint64_t>& results) const {
+        query([&](const AABB& box) {
+            return box.overlapsSphere(center, radius) ? Overlap::INTERSECTING : Overlap::OUTSIDE;
+        }, results);
+    }
+
+    void AabbTree::queryFrustum(const Frustum& frustum, std::vector<uint64_t>& results) const {
+        query([&](const AABB& box) { return frustum.classify(box); }, results);
+    }
+
+    /**
+     * Collects every leaf whose fat box the segment from origin to origin + direction * max_distance touches.
+     */
+    void AabbTree::queryRay(const glm::vec3& origin, const glm::vec3& direction, const float max_distance,
+        std::vector<uint64_t>& results) const {
+        const glm::vec3 inverse_direction = 1.0f / direction;
+        query([&](const AABB& box) {
+            return box.intersectsRay(origin, inverse_direction, max_distance) ? Overlap::INTERSECTING : Overlap::OUTSIDE;
+        }, results);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+
+namespace gl {
+
+    constexpr int NULL_PROXY = -1;
+
+    /**
+     * Dynamic bounding volume tree over world-space boxes, for visibility, proximity and picking queries.
+     * Leaves store fat boxes (the tight box grown by a margin), so objects moving a little within them
+     * need no tree update. Inserts pick the sibling by surface area cost and every change is refit and
+     * rebalanced with rotations on the way back up, keeping queries logarithmic as objects move.
+     * Queries return the user data of leaves whose fat box passes the test; callers refine as needed.
+     */
+    class AabbTree {
+    public:
+        explicit AabbTree(float fat_margin = 0.1f);
+
+        int createProxy(const AABB& bounds, uint64_t user_data);
+        void destroyProxy(int proxy);
+        bool moveProxy(int proxy, const AABB& bounds);
+
+        uint64_t getUserData(int proxy) const { return nodes_[proxy].user_data; }
+        const AABB& getFatBounds(int proxy) const { return nodes_[proxy].bounds; }
+        size_t size() const { return num_proxies_; }
+        int getHeight() const;
+        AABB getBounds() const;
+
+        void queryAabb(const AABB& bounds, std::vector<uint64_t>& results) const;
+        void querySphere(const glm::vec3& center, float radius, std::vector<uint64_t>& results) const;
+        void queryFrustum(const Frustum& frustum, std::vector<uint64_t>& results) const;
+        void queryRay(const glm::vec3& origin, const glm::vec3& direction, float max_distance,
+            std::vector<uint64_t>& results) const;
+
+    private:
+        struct Node {
+            AABB bounds;
+            uint64_t user_data = 0;
+            int parent = NULL_PROXY;    // Next free node while on the free list
+            int child1 = NULL_PROXY;
+            int child2 = NULL_PROXY;
+            int height = -1;            // 0 for leaves, -1 for free nodes
+
+            bool isLeaf() const { return child1 == NULL_PROXY; }
+        };
+
+        int allocateNode();
+        void freeNode(int node);
+        void insertLeaf(int leaf);
+        void removeLeaf(int leaf);
+        int balance(int node);
+        void refitAncestors(int node);
+        void collectLeaves(int node, std::vector<uint64_t>& results) const;
+        template<typename Test>
+        void query(const Test& test, std::vector<uint64_t>& results) const;
+
+        std::vector<Node> nodes_;
+        int root_ = NULL_PROXY;
+        int free_list_ = NULL_PROXY;
+        size_t num_proxies_ = 0;
+        float fat_margin_;
+    };
+}
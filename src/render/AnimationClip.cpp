@@ -0,0 +1,363 @@
+#include "AnimationClip.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <ranges>
+
+#include "SkeletalMesh.h"
+#include "../Simd.h"
+
+namespace gl {
+
+    void LocalPose::resize(const unsigned int bone_count) {
+        num_bones = bone_count;
+        padded_bones = simd::padToWidth(bone_count);
+        for (auto* stream : {&tx, &ty, &tz, &qx, &qy, &qz}) {
+            stream->assign(padded_bones, 0.0f);
+        }
+        // Padding lanes hold the identity so normalization never divides by zero
+        for (auto* stream : {&qw, &sx, &sy, &sz}) {
+            stream->assign(padded_bones, 1.0f);
+        }
+    }
+
+    // Appends one bone, growing the streams by a whole padding block once the current one is full
+    unsigned int LocalPose::addBone(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+        if (num_bones == padded_bones) {
+            padded_bones = simd::padToWidth(num_bones + 1);
+            for (auto* stream : {&tx, &ty, &tz, &qx, &qy, &qz}) {
+                stream->resize(padded_bones, 0.0f);
+            }
+            for (auto* stream : {&qw, &sx, &sy, &sz}) {
+                stream->resize(padded_bones, 1.0f);
+            }
+        }
+        setBone(num_bones, translation, rotation, scale);
+        return num_bones++;
+    }
+
+    void LocalPose::setBone(const unsigned int bone, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+        tx[bone] = translation.x; ty[bone] = translation.y; tz[bone] = translation.z;
+        qx[bone] = rotation.x; qy[bone] = rotation.y; qz[bone] = rotation.z; qw[bone] = rotation.w;
+        sx[bone] = scale.x; sy[bone] = scale.y; sz[bone] = scale.z;
+    }
+
+    glm::mat4 LocalPose::getBoneMatrix(const unsigned int bone) const {
+        const glm::quat rotation(qw[bone], qx[bone], qy[bone], qz[bone]);
+        return glm::translate(glm::mat4(1.0f), glm::vec3(tx[bone], ty[bone], tz[bone]))
+             * glm::mat4_cast(rotation)
+             * glm::scale(glm::mat4(1.0f), glm::vec3(sx[bone], sy[bone], sz[bone]));
+    }
+
+    /**
+     * Converts every bone's TRS to an affine matrix, simd::WIDTH bones at a time.
+     * @param matrices - Output array with room for num_bones matrices
+     */
+    void LocalPose::toMatrices(glm::mat4* matrices) const {
+        toMatrices(0, num_bones, matrices);
+    }
+
+    /**
+     * Converts a range of bones' TRS to affine matrices, simd::WIDTH bones at a time.
+     * @param first - First bone to convert
+     * @param count - Number of bones to convert
+     * @param matrices - Output array indexed by bone; only [first, first + count) is written
+     */
+    void LocalPose::toMatrices(const unsigned int first, const unsigned int count, glm::mat4* matrices) const {
+        using V = simd::f32xN;
+        const V one = V::set1(1.0f);
+        const V two = V::set1(2.0f);
+        const unsigned int end = std::min(first + count, num_bones);
+
+        // Blocks start on a multiple of the width so the last one never reads past the padding
+        for (unsigned int b = first - first % V::width; b < end; b += V::width) {
+            const V x = V::load(&qx[b]), y = V::load(&qy[b]), z = V::load(&qz[b]), w = V::load(&qw[b]);
+            const V sx_ = V::load(&sx[b]), sy_ = V::load(&sy[b]), sz_ = V::load(&sz[b]);
+            const V xx = x * x, yy = y * y, zz = z * z;
+            const V xy = x * y, xz = x * z, yz = y * z;
+            const V wx = w * x, wy = w * y, wz = w * z;
+
+            // Rotation-scale columns, same layout as glm::mat3_cast(q) * scale
+            float m[12][V::width];
+            ((one - two * (yy + zz)) * sx_).store(m[0]);
+            (two * (xy + wz) * sx_).store(m[1]);
+            (two * (xz - wy) * sx_).store(m[2]);
+            (two * (xy - wz) * sy_).store(m[3]);
+            ((one - two * (xx + zz)) * sy_).store(m[4]);
+            (two * (yz + wx) * sy_).store(m[5]);
+            (two * (xz + wy) * sz_).store(m[6]);
+            (two * (yz - wx) * sz_).store(m[7]);
+            ((one - two * (xx + yy)) * sz_).store(m[8]);
+            V::load(&tx[b]).store(m[9]);
+            V::load(&ty[b]).store(m[10]);
+            V::load(&tz[b]).store(m[11]);
+
+            const unsigned int lane_begin = b < first ? first - b : 0;
+            const unsigned int lane_end = std::min<unsigned int>(V::width, end - b);
+            for (unsigned int lane = lane_begin; lane < lane_end; lane++) {
+                glm::mat4& out = matrices[b + lane];
+                out[0] = glm::vec4(m[0][lane], m[1][lane], m[2][lane], 0.0f);
+                out[1] = glm::vec4(m[3][lane], m[4][lane], m[5][lane], 0.0f);
+                out[2] = glm::vec4(m[6][lane], m[7][lane], m[8][lane], 0.0f);
+                out[3] = glm::vec4(m[9][lane], m[10][lane], m[11][lane], 1.0f);
+            }
+        }
+    }
+
+    /**
+     * Splits an affine matrix into translation, rotation and (possibly negative) scale.
+     * Assumes no shear, which holds for bone and node transforms exported by Assimp.
+     */
+    void AnimationClip::decompose(const glm::mat4& matrix, glm::vec3& translation, glm::quat& rotation, glm::vec3& scale) {
+        translation = glm::vec3(matrix[3]);
+        glm::mat3 basis(matrix);
+        scale = glm::vec3(glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]));
+        if (glm::determinant(basis) < 0.0f) {
+            scale.x = -scale.x;
+        }
+        for (int i = 0; i < 3; i++) {
+            if (scale[i] != 0.0f) basis[i] /= scale[i];
+        }
+        rotation = glm::normalize(glm::quat_cast(basis));
+    }
+
+    /**
+     * Converts the rigid part of a skinning matrix to a unit dual quaternion. Scale is dropped, which
+     * dual quaternion skinning cannot represent.
+     * @param out - Two vec4 in (x, y, z, w) order: the rotation, then the dual part encoding translation
+     */
+    void AnimationClip::toDualQuaternion(const glm::mat4& matrix, glm::vec4* out) {
+        glm::vec3 translation, scale;
+        glm::quat rotation;
+        decompose(matrix, translation, rotation, scale);
+        const glm::quat dual = 0.5f * (glm::quat(0.0f, translation) * rotation);
+        out[0] = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+        out[1] = glm::vec4(dual.x, dual.y, dual.z, dual.w);
+    }
+
+    void AnimationClip::bindPose(const Skeleton& skeleton, LocalPose& pose) {
+        pose.resize(skeleton.num_bones_);
+        for (unsigned int i = 0; i < skeleton.num_bones_; i++) {
+            glm::vec3 t, s;
+            glm::quat r;
+            decompose(skeleton.bones_[i].bind_pose_transform, t, r, s);
+            pose.setBone(i, t, r, s);
+        }
+    }
+
+    /**
+     * Estimates the rate the source keys were authored at from the densest channel, so baking at the
+     * "native" rate neither drops keys nor blows up clips whose ticks_per_second is very high.
+     */
+    float AnimationClip::nativeSampleRate(const Animation& animation) {
+        const double duration_seconds = animation.duration / animation.ticks_per_second;
+        if (duration_seconds <= 0.0) return 30.0f;
+
+        size_t max_keys = 0;
+        for (const auto& channel : animation.channels | std::views::values) {
+            max_keys = std::max({max_keys, channel.position_keys.size(), channel.rotation_keys.size(), channel.scale_keys.size()});
+        }
+        if (max_keys < 2) return 30.0f;
+        return std::clamp(static_cast<float>((max_keys - 1) / duration_seconds), 1.0f, 120.0f);
+    }
+
+    /**
+     * Resamples an animation onto a uniform grid in bone order.
+     * @param animation - The source animation, with channels keyed by bone id
+     * @param skeleton - The skeleton the animation targets, supplies bind poses for unanimated bones
+     * @param sample_rate - Frames per second, or 0 to use the rate the source keys were authored at
+     * @return The baked clip
+     */
+    BakedClip AnimationClip::bake(const Animation& animation, const Skeleton& skeleton, const float sample_rate) {
+        BakedClip clip;
+        clip.num_bones = skeleton.num_bones_;
+        clip.padded_bones = simd::padToWidth(clip.num_bones);
+        clip.duration = static_cast<float>(animation.duration / animation.ticks_per_second);
+        clip.looping = animation.looping;
+
+        const float rate = sample_rate > 0.0f ? sample_rate : nativeSampleRate(animation);
+        clip.num_frames = std::max(2u, static_cast<unsigned int>(std::ceil(clip.duration * rate)) + 1);
+        // Effective rate so the last frame lands exactly on the end of the clip
+        clip.sample_rate = clip.duration > 0.0f ? static_cast<float>(clip.num_frames - 1) / clip.duration : rate;
+
+        LocalPose rest;
+        bindPose(skeleton, rest);
+
+        std::vector<const AnimationChannel*> channels(clip.num_bones, nullptr);
+        for (const auto& [bone_id, channel] : animation.channels) {
+            if (bone_id < clip.num_bones) channels[bone_id] = &channel;
+        }
+
+        const size_t stream_size = static_cast<size_t>(clip.num_frames) * clip.padded_bones;
+        for (auto* stream : {&clip.tx, &clip.ty, &clip.tz, &clip.qx, &clip.qy, &clip.qz}) {
+            stream->assign(stream_size, 0.0f);
+        }
+        for (auto* stream : {&clip.qw, &clip.sx, &clip.sy, &clip.sz}) {
+            stream->assign(stream_size, 1.0f);
+        }
+
+        for (unsigned int frame = 0; frame < clip.num_frames; frame++) {
+            const double seconds = clip.duration * static_cast<double>(frame) / (clip.num_frames - 1);
+            const double ticks = std::min(seconds * animation.ticks_per_second, animation.duration);
+            const size_t base = static_cast<size_t>(frame) * clip.padded_bones;
+
+            for (unsigned int bone = 0; bone < clip.num_bones; bone++) {
+                glm::vec3 t(rest.tx[bone], rest.ty[bone], rest.tz[bone]);
+                glm::quat r(rest.qw[bone], rest.qx[bone], rest.qy[bone], rest.qz[bone]);
+                glm::vec3 s(rest.sx[bone], rest.sy[bone], rest.sz[bone]);
+                if (channels[bone]) {
+                    channels[bone]->sample(ticks, t, r, s);
+                }
+
+                const size_t i = base + bone;
+                // Keep consecutive frames in the same hemisphere so the sampler's nlerp takes the short arc
+                if (frame > 0) {
+                    const size_t prev = i - clip.padded_bones;
+                    const float dot = r.x * clip.qx[prev] + r.y * clip.qy[prev] + r.z * clip.qz[prev] + r.w * clip.qw[prev];
+                    if (dot < 0.0f) r = -r;
+                }
+
+                clip.tx[i] = t.x; clip.ty[i] = t.y; clip.tz[i] = t.z;
+                clip.qx[i] = r.x; clip.qy[i] = r.y; clip.qz[i] = r.z; clip.qw[i] = r.w;
+                clip.sx[i] = s.x; clip.sy[i] = s.y; clip.sz[i] = s.z;
+            }
+        }
+
+        return clip;
+    }
+
+    /**
+     * Adjusts an nlerp parameter so the result follows slerp's constant angular velocity, using a
+     * polynomial fit in t and the absolute cosine d between the two quaternions.
+     */
+    template<typename V>
+    static V slerpCorrection(const V t, const V d) {
+        const V A = V::set1(1.0904f) + d * (V::set1(-3.2452f) + d * (V::set1(3.55645f) - d * V::set1(1.43519f)));
+        const V B = V::set1(0.848013f) + d * (V::set1(-1.06021f) + d * V::set1(0.215638f));
+        const V centered = t - V::set1(0.5f);
+        const V correction = A * centered * centered + B;
+        return t + t * centered * (t - V::set1(1.0f)) * correction;
+    }
+
+    /**
+     * Normalized linear interpolation along the shorter arc between two rotations.
+     * @param slerp_fixup - Correct t so the result is within ~1e-4 of slerp
+     */
+    glm::quat AnimationClip::nlerp(const glm::quat& a, glm::quat b, float t, const bool slerp_fixup) {
+        float dot = glm::dot(a, b);
+        if (dot < 0.0f) {
+            b = -b;
+            dot = -dot;
+        }
+        if (slerp_fixup) {
+            t = slerpCorrection(simd::f32x1{t}, simd::f32x1{dot}).v;
+        }
+        return glm::normalize(a + (b - a) * t);
+    }
+
+    // The ten streams of one pose, in LocalPose's order: tx, ty, tz, qx, qy, qz, qw, sx, sy, sz
+    using PoseStreams = std::array<const float*, 10>;
+
+    /**
+     * Interpolates every bone between two poses, simd::WIDTH bones per iteration.
+     * Rotations use nlerp, optionally with slerpCorrection applied per bone.
+     * @param alphas - Per-bone factors for translation, rotation and scale, or nullptr to use alpha for all
+     */
+    template<typename V>
+    static void interpolateStreams(const PoseStreams& a, const PoseStreams& b, const std::array<const float*, 3>* alphas,
+                                   const float alpha, const unsigned int padded_bones, const bool slerp_fixup, LocalPose& pose) {
+        const V zero = V::set1(0.0f);
+        const V one = V::set1(1.0f);
+        V t = V::set1(alpha);
+
+        auto lerp = [&](const int stream, std::vector<float>& dst, const size_t bone) {
+            const V from = V::load(a[stream] + bone);
+            const V to = V::load(b[stream] + bone);
+            (from + (to - from) * t).store(&dst[bone]);
+        };
+
+        for (size_t bone = 0; bone < padded_bones; bone += V::width) {
+            if (alphas) t = V::load((*alphas)[0] + bone);
+            lerp(0, pose.tx, bone); lerp(1, pose.ty, bone); lerp(2, pose.tz, bone);
+            if (alphas) t = V::load((*alphas)[2] + bone);
+            lerp(7, pose.sx, bone); lerp(8, pose.sy, bone); lerp(9, pose.sz, bone);
+            if (alphas) t = V::load((*alphas)[1] + bone);
+
+            const V ax = V::load(a[3] + bone), ay = V::load(a[4] + bone);
+            const V az = V::load(a[5] + bone), aw = V::load(a[6] + bone);
+            V bx = V::load(b[3] + bone), by = V::load(b[4] + bone);
+            V bz = V::load(b[5] + bone), bw = V::load(b[6] + bone);
+
+            const V dot = ax * bx + ay * by + az * bz + aw * bw;
+            const V sign = select(dot < zero, V::set1(-1.0f), one);
+            bx = bx * sign; by = by * sign; bz = bz * sign; bw = bw * sign;
+
+            const V k = slerp_fixup ? slerpCorrection(t, abs(dot)) : t;
+
+            const V qx = ax + (bx - ax) * k;
+            const V qy = ay + (by - ay) * k;
+            const V qz = az + (bz - az) * k;
+            const V qw = aw + (bw - aw) * k;
+            const V inv_length = one / sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+            (qx * inv_length).store(&pose.qx[bone]);
+            (qy * inv_length).store(&pose.qy[bone]);
+            (qz * inv_length).store(&pose.qz[bone]);
+            (qw * inv_length).store(&pose.qw[bone]);
+        }
+    }
+
+    static PoseStreams frameStreams(const BakedClip& clip, const size_t offset) {
+        return {&clip.tx[offset], &clip.ty[offset], &clip.tz[offset], &clip.qx[offset], &clip.qy[offset],
+                &clip.qz[offset], &clip.qw[offset], &clip.sx[offset], &clip.sy[offset], &clip.sz[offset]};
+    }
+
+    static PoseStreams poseStreams(const LocalPose& pose) {
+        return {pose.tx.data(), pose.ty.data(), pose.tz.data(), pose.qx.data(), pose.qy.data(), pose.qz.data(),
+                pose.qw.data(), pose.sx.data(), pose.sy.data(), pose.sz.data()};
+    }
+
+    /**
+     * Interpolates two poses of the same skeleton bone by bone, with separate factors per bone and channel,
+     * for samplers whose keys are not on a shared grid. Padding lanes of the factors must be valid floats.
+     * @param translation_alphas, rotation_alphas, scale_alphas - padded_bones factors each
+     * @param pose - Output pose, resized to the inputs' bone count if needed
+     */
+    void AnimationClip::interpolate(const LocalPose& from, const LocalPose& to, const float* translation_alphas,
+                                    const float* rotation_alphas, const float* scale_alphas, const bool slerp_fixup,
+                                    LocalPose& pose) {
+        if (pose.num_bones != from.num_bones) {
+            pose.resize(from.num_bones);
+        }
+        const std::array<const float*, 3> alphas = {translation_alphas, rotation_alphas, scale_alphas};
+        interpolateStreams<simd::f32xN>(poseStreams(from), poseStreams(to), &alphas, 0.0f, from.padded_bones,
+                                        slerp_fixup, pose);
+    }
+
+    /**
+     * Samples a baked clip into a local pose.
+     * @param clip - The clip to sample
+     * @param time_in_seconds - Playback time, wrapped for looping clips and clamped otherwise
+     * @param pose - Output pose, resized to the clip's bone count if needed
+     * @param slerp_fixup - Correct nlerp towards constant angular velocity
+     */
+    void AnimationClip::sample(const BakedClip& clip, float time_in_seconds, LocalPose& pose, const bool slerp_fixup) {
+        if (pose.num_bones != clip.num_bones) {
+            pose.resize(clip.num_bones);
+        }
+        if (clip.num_frames == 0) return;
+
+        if (clip.looping && clip.duration > 0.0f) {
+            time_in_seconds = std::fmod(time_in_seconds, clip.duration);
+            if (time_in_seconds < 0.0f) time_in_seconds += clip.duration;
+        }
+        const float frame = std::clamp(time_in_seconds * clip.sample_rate, 0.0f, static_cast<float>(clip.num_frames - 1));
+        const unsigned int f0 = std::min(static_cast<unsigned int>(frame), clip.num_frames - 2);
+        const float alpha = std::clamp(frame - static_cast<float>(f0), 0.0f, 1.0f);
+
+        const size_t offset0 = static_cast<size_t>(f0) * clip.padded_bones;
+        const size_t offset1 = offset0 + clip.padded_bones;
+        interpolateStreams<simd::f32xN>(frameStreams(clip, offset0), frameStreams(clip, offset1), nullptr, alpha,
+                                        clip.padded_bones, slerp_fixup, pose);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace gl {
+    struct Animation;
+    struct Skeleton;
+
+    /**
+     * Local (parent-relative) translation, rotation and scale of every bone in a skeleton.
+     * Stored structure-of-arrays and padded to a multiple of the SIMD width so samplers can write,
+     * and the hierarchy pass can read, several bones per instruction.
+     */
+    struct LocalPose {
+        unsigned int num_bones = 0;
+        unsigned int padded_bones = 0;
+
+        std::vector<float> tx, ty, tz;          // Translation
+        std::vector<float> qx, qy, qz, qw;      // Rotation quaternion
+        std::vector<float> sx, sy, sz;          // Scale
+
+        void resize(unsigned int bone_count);
+        unsigned int addBone(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+        void setBone(unsigned int bone, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+        glm::mat4 getBoneMatrix(unsigned int bone) const;
+        void toMatrices(glm::mat4* matrices) const;
+        void toMatrices(unsigned int first, unsigned int count, glm::mat4* matrices) const;
+    };
+
+    /**
+     * An animation baked into a contiguous, bone-ordered layout on a uniform time grid.
+     * Each stream is frame-major: stream[frame * padded_bones + bone]. Bones the source clip does not
+     * animate are filled with their bind pose, so sampling always produces a complete pose.
+     */
+    struct BakedClip {
+        unsigned int num_bones = 0;
+        unsigned int padded_bones = 0;
+        unsigned int num_frames = 0;
+        float sample_rate = 30.0f;  // Frames per second
+        float duration = 0.0f;      // In seconds
+        bool looping = true;
+
+        std::vector<float> tx, ty, tz;
+        std::vector<float> qx, qy, qz, qw;
+        std::vector<float> sx, sy, sz;
+    };
+
+    class AnimationClip {
+    public:
+        static BakedClip bake(const Animation& animation, const Skeleton& skeleton, float sample_rate = 0.0f);
+        static void sample(const BakedClip& clip, float time_in_seconds, LocalPose& pose, bool slerp_fixup = false);
+        static void bindPose(const Skeleton& skeleton, LocalPose& pose);
+        static glm::quat nlerp(const glm::quat& a, glm::quat b, float t, bool slerp_fixup);
+        static void interpolate(const LocalPose& from, const LocalPose& to, const float* translation_alphas,
+                                const float* rotation_alphas, const float* scale_alphas, bool slerp_fixup, LocalPose& pose);
+
+        static void decompose(const glm::mat4& matrix, glm::vec3& translation, glm::quat& rotation, glm::vec3& scale);
+        static void toDualQuaternion(const glm::mat4& matrix, glm::vec4* out);
+
+    private:
+        static float nativeSampleRate(const Animation& animation);
+    };
+}
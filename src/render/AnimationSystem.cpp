@@ -0,0 +1,68 @@
+#include "AnimationSystem.h"
+
+#include "Camera.h"
+#include "SkeletalMesh.h"
+#include "SkinnedCrowd.h"
+#include "../Profiler.h"
+
+namespace gl {
+
+    namespace {
+        // Roughly equal work per job: a skeleton plays one clip, a crowd slot samples one instance
+        constexpr size_t SKELETONS_PER_JOB = 4;
+        constexpr size_t INSTANCES_PER_JOB = 16;
+
+        thread_local PoseScratch scratch;
+    }
+
+    void AnimationSystem::addSkeleton(Skeleton* skeleton) {
+        skeletons_.push_back(skeleton);
+    }
+
+    void AnimationSystem::addCrowd(SkinnedCrowd* crowd) {
+        crowds_.push_back(crowd);
+    }
+
+    /**
+     * Queues sampling and palette computation for every skeleton and crowd instance, and counts the bones
+     * evaluated in the profiler.
+     * @param time_since_previous - Seconds to advance playback by, 0 while paused
+     * @param camera - Decides the animation LOD and path of crowd instances
+     */
+    void AnimationSystem::update(const double time_since_previous, const Camera& camera) {
+        sync();
+        const glm::vec3 camera_position = camera.getPosition();
+        const float projection_scale = camera.getProjection()[1][1];
+
+        pending_.push_back(JobSystem::dispatch(skeletons_.size(), SKELETONS_PER_JOB,
+            [this, time_since_previous](const size_t begin, const size_t end) {
+                size_t evaluated = 0;
+                for (size_t i = begin; i < end; i++) {
+                    skeletons_[i]->playCurrentAnimation(time_since_previous);
+                    evaluated += skeletons_[i]->num_bones_;
+                }
+                Profiler::count("Bones evaluated", evaluated);
+            }));
+
+        for (auto* crowd : crowds_) {
+            crowd->prepare(time_since_previous, camera_position, projection_scale);
+            pending_.push_back(JobSystem::dispatch(crowd->getNearCount(), INSTANCES_PER_JOB,
+                [crowd](const size_t begin, const size_t end) {
+                    Profiler::count("Bones evaluated", crowd->writePalettes(begin, end, scratch));
+                }));
+        }
+    }
+
+    // Waits for the jobs queued by update() and uploads the crowd palettes
+    void AnimationSystem::sync() {
+        if (pending_.empty()) return;
+        for (const auto& counter : pending_) {
+            JobSystem::wait(counter);
+        }
+        pending_.clear();
+
+        for (auto* crowd : crowds_) {
+            crowd->upload();
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+
+#include "../JobSystem.h"
+#include "glm/glm.hpp"
+
+namespace gl {
+    struct Skeleton;
+    class Camera;
+    class SkinnedCrowd;
+
+    /**
+     * Updates every registered skeleton and crowd as parallel jobs on the JobSystem.
+     * update() only queues the work so the main thread can keep drawing; sync() is the barrier that
+     * waits for it and uploads the results, and must run before the animated meshes are drawn.
+     */
+    class AnimationSystem {
+    public:
+        void addSkeleton(Skeleton* skeleton);
+        void addCrowd(SkinnedCrowd* crowd);
+
+        void update(double time_since_previous, const Camera& camera);
+        void sync();
+
+    private:
+        std::vector<Skeleton*> skeletons_;
+        std::vector<SkinnedCrowd*> crowds_;
+        std::vector<JobCounter> pending_;
+    };
+}
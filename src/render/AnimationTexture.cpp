@@ -0,0 +1,77 @@
+#include "AnimationTexture.h"
+
+#include "SkeletalMesh.h"
+#include "../Debug.h"
+
+namespace gl {
+
+    /**
+     * Samples every animation of a skeleton at a fixed rate and uploads the resulting bone palettes.
+     * Each clip gets one extra row at its end time so the shader can filter between the last two frames
+     * without wrapping.
+     * @param skeleton - Skeleton with baked or compressed animations
+     * @param sample_rate - Frames per second stored in the texture
+     */
+    AnimationTexture AnimationTextures::bake(const Skeleton& skeleton, const float sample_rate) {
+        AnimationTexture result;
+        result.sample_rate = sample_rate;
+        result.width = 3 * static_cast<int>(skeleton.palette_size_);
+
+        size_t num_clips = skeleton.animations_.size();
+        if (num_clips > MAX_BAKED_CLIPS) {
+            debug::error("Skeleton has more than " + std::to_string(MAX_BAKED_CLIPS) + " animations, the rest are not baked");
+            num_clips = MAX_BAKED_CLIPS;
+        }
+
+        LocalPose pose;
+        std::vector<glm::mat4> global_transforms;
+        std::vector<glm::mat4> palette(skeleton.palette_size_);
+        std::vector<glm::vec4> texels;
+
+        for (size_t clip = 0; clip < num_clips; clip++) {
+            const float duration = skeleton.getAnimationDuration(clip);
+            const int last_frame = std::max(1, static_cast<int>(std::ceil(duration * sample_rate)));
+            result.clips.emplace_back(result.height, last_frame, sample_rate, 0.0f);
+
+            for (int frame = 0; frame <= last_frame; frame++) {
+                const float time = std::min(frame / sample_rate, duration);
+                skeleton.sampleAnimation(clip, time, pose);
+                skeleton.computeBoneMatrices(pose, global_transforms, palette.data());
+                for (const auto& m : palette) {
+                    for (int row = 0; row < 3; row++) {
+                        texels.emplace_back(m[0][row], m[1][row], m[2][row], m[3][row]);
+                    }
+                }
+            }
+            result.height += last_frame + 1;
+        }
+
+        GLint max_size = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        if (result.width == 0 || result.height == 0 || result.width > max_size || result.height > max_size) {
+            debug::error("Animation texture of " + std::to_string(result.width) + "x" + std::to_string(result.height)
+                + " is empty or exceeds GL_MAX_TEXTURE_SIZE");
+            result.clips.clear();
+            return result;
+        }
+
+        glGenTextures(1, &result.texture);
+        glBindTexture(GL_TEXTURE_2D, result.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, result.width, result.height, 0, GL_RGBA, GL_FLOAT, texels.data());
+        // Linear filtering blends consecutive frames; lookups hit texel centers horizontally so bones never mix
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        debug::print("Baked animation texture: " + std::to_string(result.width) + "x" + std::to_string(result.height)
+            + " (" + std::to_string(texels.size() * sizeof(glm::vec4) / 1024) + " KB)");
+        return result;
+    }
+
+    void AnimationTextures::deleteTexture(AnimationTexture& animation_texture) {
+        glDeleteTextures(1, &animation_texture.texture);
+        animation_texture.texture = 0;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+namespace gl {
+    struct Skeleton;
+
+    // Keep in sync with skinned_baked_vert.glsl
+    constexpr int MAX_BAKED_CLIPS = 32;
+
+    /**
+     * Every clip of a skeleton pre-sampled into one RGBA32F texture of bone palettes.
+     * Each row is one frame and holds three texels (the rows of the affine part) per skinning bone;
+     * clips are stacked vertically. The GPU reads poses straight from it, so characters drawn this way cost no
+     * CPU sampling or palette uploads.
+     */
+    struct AnimationTexture {
+        GLuint texture = 0;
+        int width = 0;                  // 3 texels per skinning bone
+        int height = 0;                 // Total frames over all clips
+        float sample_rate = 30.0f;
+        std::vector<glm::vec4> clips;   // Per clip: first row, last frame, sample rate, unused
+    };
+
+    class AnimationTextures {
+    public:
+        static AnimationTexture bake(const Skeleton& skeleton, float sample_rate = 30.0f);
+        static void deleteTexture(AnimationTexture& animation_texture);
+    };
+}
@@ -0,0 +1,105 @@
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gl {
+
+    float AABB::surfaceArea() const {
+        const glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool AABB::contains(const AABB& other) const {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+            && other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+    }
+
+    bool AABB::overlaps(const AABB& other) const {
+        return min.x <= other.max.x && other.min.x <= max.x
+            && min.y <= other.max.y && other.min.y <= max.y
+            && min.z <= other.max.z && other.min.z <= max.z;
+    }
+
+    bool AABB::overlapsSphere(const glm::vec3& center, const float radius) const {
+        const glm::vec3 closest = glm::clamp(center, min, max);
+        const glm::vec3 offset = center - closest;
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    /**
+     * Slab test against a ray.
+     * @param origin - Ray origin
+     * @param inverse_direction - 1 / direction per component; infinities for axis-parallel rays are fine
+     * @param max_distance - Length of the ray in multiples of its direction
+     */
+    bool AABB::intersectsRay(const glm::vec3& origin, const glm::vec3& inverse_direction, const float max_distance) const {
+        float t_min = 0.0f;
+        float t_max = max_distance;
+        for (int axis = 0; axis < 3; axis++) {
+            float t0 = (min[axis] - origin[axis]) * inverse_direction[axis];
+            float t1 = (max[axis] - origin[axis]) * inverse_direction[axis];
+            if (t0 > t1) std::swap(t0, t1);
+            // NaN from 0 * inf (origin on a slab plane) compares false and leaves the interval untouched
+            if (t0 > t_min) t_min = t0;
+            if (t1 < t_max) t_max = t1;
+            if (t_min > t_max) return false;
+        }
+        return true;
+    }
+
+    AABB AABB::expanded(const float margin) const {
+        return {min - glm::vec3(margin), max + glm::vec3(margin)};
+    }
+
+    // Bounds of the transformed box, from the transformed center and the absolute rotation-scale applied to the extent
+    AABB AABB::transformed(const glm::mat4& matrix) const {
+        const glm::vec3 c = glm::vec3(matrix * glm::vec4(center(), 1.0f));
+        const glm::vec3 e = extent();
+        const glm::vec3 world_extent = glm::abs(glm::vec3(matrix[0])) * e.x
+                                     + glm::abs(glm::vec3(matrix[1])) * e.y
+                                     + glm::abs(glm::vec3(matrix[2])) * e.z;
+        return {c - world_extent, c + world_extent};
+    }
+
+    AABB AABB::merge(const AABB& a, const AABB& b) {
+        return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+    }
+
+    // Gribb-Hartmann plane extraction; planes are normalized so sphere tests can use distances
+    Frustum Frustum::fromMatrix(const glm::mat4& view_projection) {
+        const glm::mat4& m = view_projection;
+        const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        Frustum frustum;
+        frustum.planes = {row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2};
+        for (auto& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    Overlap Frustum::classify(const AABB& box) const {
+        const glm::vec3 c = box.center();
+        const glm::vec3 e = box.extent();
+        Overlap result = Overlap::INSIDE;
+        for (const auto& plane : planes) {
+            const glm::vec3 normal(plane);
+            const float distance = glm::dot(normal, c) + plane.w;
+            const float radius = glm::dot(glm::abs(normal), e);
+            if (distance < -radius) return Overlap::OUTSIDE;
+            if (distance < radius) result = Overlap::INTERSECTING;
+        }
+        return result;
+    }
+
+    bool Frustum::overlapsSphere(const glm::vec3& center, const float radius) const {
+        for (const auto& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+        }
+        return true;
+    }
+}
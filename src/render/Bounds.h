@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <limits>
+
+#include "glm/glm.hpp"
+
+namespace gl {
+
+    enum class Overlap {
+        OUTSIDE,
+        INTERSECTING,
+        INSIDE
+    };
+
+    // Axis-aligned bounding box; default constructed empty so merging into it just takes the other box
+    struct AABB {
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+        bool empty() const { return min.x > max.x; }
+        glm::vec3 center() const { return 0.5f * (min + max); }
+        glm::vec3 extent() const { return 0.5f * (max - min); }
+        float surfaceArea() const;
+        bool contains(const AABB& other) const;
+        bool overlaps(const AABB& other) const;
+        bool overlapsSphere(const glm::vec3& center, float radius) const;
+        bool intersectsRay(const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance) const;
+
+        AABB expanded(float margin) const;
+        AABB transformed(const glm::mat4& matrix) const;
+        static AABB merge(const AABB& a, const AABB& b);
+    };
+
+    // Six inward-facing planes (xyz normal, w offset) extracted from a view-projection matrix
+    struct Frustum {
+        std::array<glm::vec4, 6> planes;
+
+        static Frustum fromMatrix(const glm::mat4& view_projection);
+        Overlap classify(const AABB& box) const;
+        bool overlapsSphere(const glm::vec3& center, float radius) const;
+    };
+}
@@ -16,6 +16,8 @@ namespace gl {
         glm::vec3 getLook() const;
         glm::vec3 getRight() const;
         glm::vec3 getUp() const;
+        float getNear() const { return near_; }
+        float getFar() const { return far_; }
 
     private:
         glm::vec3 position_;
@@ -0,0 +1,173 @@
+#include "CascadedShadows.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Camera.h"
+#include "../Debug.h"
+
+namespace gl {
+
+    /**
+     * @param resolution - Width and height of each cascade's map
+     * @param max_distance - View depth past which nothing is shadowed, if nearer than the camera's far plane
+     */
+    CascadedShadows::CascadedShadows(const int resolution, const float max_distance) :
+        resolution_(resolution), max_distance_(max_distance) {
+    }
+
+    void CascadedShadows::initialize() {
+        glGenTextures(2, shadow_maps_);
+        for (const GLuint map : shadow_maps_) {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, map);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution_, resolution_, CASCADE_COUNT, 0,
+                GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(2, framebuffers_);
+        for (int i = 0; i < 2; i++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[i]);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+            attachLayer(framebuffers_[i], i, 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                debug::error("Shadow map framebuffer is incomplete");
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, scene_framebuffer_);
+    }
+
+    void CascadedShadows::attachLayer(const GLuint framebuffer, const int map, const int cascade) const {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow_maps_[map], 0, cascade);
+    }
+
+    /**
+     * Fits the cascades to the camera and marks those whose cached static map must be rebuilt.
+     * @param light_direction - Direction the light travels in
+     * @param static_bounds - Bounds of every static caster, so casters outside a cascade still land in its depth range
+     * @param static_version - Changes whenever static geometry does
+     */
+    void CascadedShadows::update(const Camera& camera, const glm::vec3& light_direction, const AABB& static_bounds,
+        const uint64_t static_version) {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &scene_framebuffer_);
+        if (shadow_maps_[0] == 0) {
+            initialize();
+        }
+        const glm::vec3 direction = glm::normalize(light_direction);
+        if (direction != light_direction_ || static_version != static_version_) {
+            for (auto& cascade : cascades_) cascade.cached = false;
+            light_direction_ = direction;
+            static_version_ = static_version;
+            const glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            light_view_ = glm::lookAt(glm::vec3(0.0f), direction, up);
+        }
+
+        // Practical split scheme, blending logarithmic and uniform splits
+        constexpr float LAMBDA = 0.75f;
+        const float near = camera.getNear();
+        const float far = std::min(camera.getFar(), max_distance_);
+        const glm::mat4 projection = camera.getProjection();
+        const glm::mat4 inverse_view_projection = glm::inverse(projection * camera.getViewMatrix());
+        const auto ndc_depth = [&projection](const float view_depth) {
+            return (projection[2][2] * -view_depth + projection[3][2]) / view_depth;
+        };
+
+        float slice_near = near;
+        for (int i = 0; i < CASCADE_COUNT; i++) {
+            auto& cascade = cascades_[i];
+            const float t = static_cast<float>(i + 1) / CASCADE_COUNT;
+            const float slice_far = LAMBDA * near * std::pow(far / near, t) + (1.0f - LAMBDA) * (near + (far - near) * t);
+            cascade.split = slice_far;
+
+            glm::vec3 corners[8];
+            glm::vec3 center(0.0f);
+            for (int c = 0; c < 8; c++) {
+                const glm::vec4 ndc((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f,
+                    ndc_depth((c & 4) ? slice_far : slice_near), 1.0f);
+                const glm::vec4 world = inverse_view_projection * ndc;
+                corners[c] = glm::vec3(world) / world.w;
+                center += corners[c] / 8.0f;
+            }
+            float radius = 0.0f;
+            for (const auto& corner : corners) {
+                radius = std::max(radius, glm::length(corner - center));
+            }
+            radius = std::ceil(radius * 16.0f) / 16.0f;     // Ignore float noise so the cache survives
+            slice_near = slice_far;
+
+            const glm::vec3 light_center = glm::vec3(light_view_ * glm::vec4(center, 1.0f));
+            const glm::vec2 offset = glm::abs(glm::vec2(light_center) - cascade.center);
+            if (cascade.cached && radius == cascade.radius
+                && std::max(offset.x, offset.y) + radius <= cascade.half_size
+                && light_center.z - radius >= cascade.min_z && light_center.z + radius <= cascade.max_z) {
+                continue;
+            }
+
+            // Re-center on whole texels of the enlarged cascade, then refit its depth range to the static casters
+            cascade.cached = false;
+            cascade.radius = radius;
+            cascade.half_size = radius * CACHE_MARGIN;
+            const float texel = 2.0f * cascade.half_size / resolution_;
+            cascade.center = glm::floor(glm::vec2(light_center) / texel) * texel;
+
+            cascade.min_z = light_center.z - cascade.half_size;
+            cascade.max_z = light_center.z + cascade.half_size;
+            if (!static_bounds.empty()) {
+                const AABB light_bounds = static_bounds.transformed(light_view_);
+                cascade.min_z = std::min(cascade.min_z, light_bounds.min.z);
+                cascade.max_z = std::max(cascade.max_z, light_bounds.max.z);
+            }
+            cascade.projection = glm::ortho(cascade.center.x - cascade.half_size, cascade.center.x + cascade.half_size,
+                cascade.center.y - cascade.half_size, cascade.center.y + cascade.half_size, -cascade.max_z, -cascade.min_z);
+        }
+    }
+
+    // Maps world space to the cascade's texture coordinates and depth
+    glm::mat4 CascadedShadows::getShadowMatrix(const int cascade) const {
+        const glm::mat4 bias = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+        return bias * cascades_[cascade].projection * light_view_;
+    }
+
+    /**
+     * Binds and clears the cascade's cached map. Draw every static caster with getLightView() and
+     * getProjection(cascade) next.
+     */
+    void CascadedShadows::beginStaticPass(const int cascade) {
+        attachLayer(framebuffers_[0], 0, cascade);
+        glViewport(0, 0, resolution_, resolution_);
+        glEnable(GL_DEPTH_CLAMP);   // Casters between the light and the near plane still write
+        glDepthMask(GL_TRUE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        cascades_[cascade].cached = true;
+    }
+
+    /**
+     * Copies the cascade's cached map into the sampled one and binds it. Draw the dynamic casters next.
+     */
+    void CascadedShadows::beginDynamicPass(const int cascade) {
+        attachLayer(framebuffers_[0], 0, cascade);
+        attachLayer(framebuffers_[1], 1, cascade);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers_[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers_[1]);
+        glBlitFramebuffer(0, 0, resolution_, resolution_, 0, 0, resolution_, resolution_, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[1]);
+        glViewport(0, 0, resolution_, resolution_);
+        glEnable(GL_DEPTH_CLAMP);
+        glDepthMask(GL_TRUE);
+    }
+
+    // Returns to the framebuffer bound when update was called
+    void CascadedShadows::end(const int viewport_width, const int viewport_height) {
+        glBindFramebuffer(GL_FRAMEBUFFER, scene_framebuffer_);
+        glViewport(0, 0, viewport_width, viewport_height);
+        glDisable(GL_DEPTH_CLAMP);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+
+#include "Bounds.h"
+#include "GL/glew.h"
+
+namespace gl {
+    class Camera;
+
+    /**
+     * Cascaded shadow maps for a directional light, with static casters cached.
+     * Each cascade fits a bounding sphere of its slice of the view frustum, which keeps its size constant as the
+     * camera turns, and snaps its center to whole shadow map texels so edges do not shimmer as it moves.
+     * The cascade's projection covers that sphere with a margin and is only re-centered once the sphere leaves
+     * it, so the static casters rendered into its cached map stay valid until then, or until the light or the
+     * static geometry changes. Every frame the cached depth is copied into the sampled map and only dynamic
+     * casters are drawn on top, so the per-frame cost is a copy plus the dynamic casters.
+     */
+    class CascadedShadows {
+    public:
+        static constexpr int CASCADE_COUNT = 4;   // Defined for the shaders by ShaderVariants::getDefines
+
+        explicit CascadedShadows(int resolution = 1024, float max_distance = 60.0f);
+        CascadedShadows(const CascadedShadows&) = delete;
+        CascadedShadows& operator=(const CascadedShadows&) = delete;
+
+        void update(const Camera& camera, const glm::vec3& light_direction, const AABB& static_bounds,
+            uint64_t static_version);
+        bool needsStaticPass(int cascade) const { return !cascades_[cascade].cached; }
+        void beginStaticPass(int cascade);
+        void beginDynamicPass(int cascade);
+        void end(int viewport_width, int viewport_height);
+
+        const glm::mat4& getLightView() const { return light_view_; }
+        const glm::mat4& getProjection(int cascade) const { return cascades_[cascade].projection; }
+        glm::mat4 getShadowMatrix(int cascade) const;
+        float getSplit(int cascade) const { return cascades_[cascade].split; }
+        float getTexelSize(int cascade) const { return 2.0f * cascades_[cascade].half_size / resolution_; }
+        GLuint getShadowTexture() const { return shadow_maps_[1]; }
+
+    private:
+        static constexpr float CACHE_MARGIN = 1.25f;    // Cached area relative to the cascade's sphere
+
+        struct Cascade {
+            glm::mat4 projection = glm::mat4(1.0f);
+            glm::vec2 center = glm::vec2(0.0f);         // Light space
+            float half_size = 0.0f;
+            float min_z = 0.0f;                         // Light-space depth range
+            float max_z = 0.0f;
+            float radius = 0.0f;                        // Sphere radius the cache was built for
+            float split = 0.0f;                         // View depth where the cascade ends
+            bool cached = false;
+        };
+
+        void initialize();
+        void attachLayer(GLuint framebuffer, int map, int cascade) const;
+
+        int resolution_;
+        float max_distance_;
+        Cascade cascades_[CASCADE_COUNT];
+        glm::vec3 light_direction_ = glm::vec3(0.0f);
+        uint64_t static_version_ = 0;
+        glm::mat4 light_view_ = glm::mat4(1.0f);
+
+        GLuint shadow_maps_[2] = {};    // Depth texture arrays: static cache, sampled map
+        GLuint framebuffers_[2] = {};
+        GLint scene_framebuffer_ = 0;
+    };
+}
@@ -0,0 +1,323 @@
+#include "ClipCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "SkeletalMesh.h"
+#include "../Debug.h"
+
+namespace gl {
+
+    // Longest run of frames a single pair of keys may span, bounds the cost of key reduction
+    constexpr size_t MAX_SEGMENT_FRAMES = 64;
+    constexpr float QUAT_COMPONENT_RANGE = 0.70710678f; // 1/sqrt(2), bound on the three smallest components
+    constexpr uint32_t QUAT_COMPONENT_MAX = (1u << 15) - 1;
+
+    /**
+     * Picks the frames to keep so that interpolating between consecutive kept keys reproduces every
+     * frame within tolerance. Works on the quantized values so the reported error includes quantization.
+     * @param decoded - Quantized value of the track at every frame
+     * @param interpolate - Interpolates two values the way the sampler does
+     * @param error - Error of a reconstructed value against the original at a frame
+     */
+    template<typename T, typename Interpolate, typename Error>
+    static std::vector<uint16_t> reduceKeys(const std::vector<T>& decoded, Interpolate interpolate, Error error, const float tolerance) {
+        const size_t num_frames = decoded.size();
+        std::vector<uint16_t> keys = {0};
+
+        bool constant = true;
+        for (size_t f = 1; f < num_frames && constant; f++) {
+            constant = error(decoded[0], f) <= tolerance;
+        }
+        if (constant) return keys;
+
+        size_t a = 0;
+        while (a < num_frames - 1) {
+            size_t b = a + 1;
+            while (b + 1 < num_frames && b + 1 - a <= MAX_SEGMENT_FRAMES) {
+                const size_t c = b + 1;
+                bool fits = true;
+                for (size_t f = a + 1; f < c && fits; f++) {
+                    const float t = static_cast<float>(f - a) / static_cast<float>(c - a);
+                    fits = error(interpolate(decoded[a], decoded[c], t), f) <= tolerance;
+                }
+                if (!fits) break;
+                b = c;
+            }
+            keys.push_back(static_cast<uint16_t>(b));
+            a = b;
+        }
+        return keys;
+    }
+
+    // Largest error of the reconstruction over every frame of the track
+    template<typename T, typename Interpolate, typename Error>
+    static float measureError(const std::vector<T>& decoded, const std::vector<uint16_t>& keys, Interpolate interpolate, Error error) {
+        float max_error = 0.0f;
+        if (keys.size() == 1) {
+            for (size_t f = 0; f < decoded.size(); f++) {
+                max_error = std::max(max_error, error(decoded[0], f));
+            }
+            return max_error;
+        }
+        for (size_t k = 0; k + 1 < keys.size(); k++) {
+            const size_t a = keys[k], b = keys[k + 1];
+            for (size_t f = a; f <= b; f++) {
+                const float t = static_cast<float>(f - a) / static_cast<float>(b - a);
+                max_error = std::max(max_error, error(interpolate(decoded[a], decoded[b], t), f));
+            }
+        }
+        return max_error;
+    }
+
+    static size_t sourceBytes(const Animation& source, size_t& num_keys) {
+        size_t bytes = 0;
+        for (const auto& [bone_id, channel] : source.channels) {
+            bytes += channel.position_keys.size() * sizeof(PositionKey);
+            bytes += channel.rotation_keys.size() * sizeof(RotationKey);
+            bytes += channel.scale_keys.size() * sizeof(ScaleKey);
+            num_keys += channel.position_keys.size() + channel.rotation_keys.size() + channel.scale_keys.size();
+        }
+        return bytes;
+    }
+
+    /**
+     * Compresses a baked clip.
+     * @param clip - The baked clip to compress, must have fewer than 65536 frames
+     * @param source - The animation the clip was baked from, used to report the compression ratio
+     * @param settings - Error tolerances for key reduction
+     * @return The compressed clip, with stats filled in; an empty clip (num_frames 0) if it cannot be compressed
+     */
+    CompressedClip ClipCompression::compress(const BakedClip& clip, const Animation& source, const CompressionSettings& settings) {
+        if (clip.num_frames > std::numeric_limits<uint16_t>::max()) {
+            debug::error("Clip has too many frames to compress: " + std::to_string(clip.num_frames));
+            return {};
+        }
+
+        CompressedClip compressed;
+        compressed.num_bones = clip.num_bones;
+        compressed.num_frames = clip.num_frames;
+        compressed.sample_rate = clip.sample_rate;
+        compressed.duration = clip.duration;
+        compressed.looping = clip.looping;
+
+        auto& stats = compressed.stats;
+        stats.source_bytes = sourceBytes(source, stats.source_keys);
+
+        const auto lerp = [](const glm::vec3& a, const glm::vec3& b, const float t) { return glm::mix(a, b, t); };
+        const auto nlerp = [](const glm::quat& a, const glm::quat& b, const float t) { return AnimationClip::nlerp(a, b, t, false); };
+
+        std::vector<glm::vec3> original(clip.num_frames), decoded(clip.num_frames);
+        std::vector<glm::quat> original_rotations(clip.num_frames), decoded_rotations(clip.num_frames);
+        std::vector<std::array<uint16_t, 3>> encoded(clip.num_frames);
+
+        // Translation and scale share a layout: three streams quantized against the track's range
+        auto compressVec3Track = [&](const std::vector<float>& xs, const std::vector<float>& ys, const std::vector<float>& zs,
+                                     const unsigned int bone, const float tolerance, std::vector<CompressedClip::Track>& tracks,
+                                     std::vector<uint16_t>& frames, std::vector<uint16_t>& values, float& max_error) {
+            glm::vec3 min(std::numeric_limits<float>::max());
+            glm::vec3 max(std::numeric_limits<float>::lowest());
+            for (unsigned int f = 0; f < clip.num_frames; f++) {
+                const size_t i = static_cast<size_t>(f) * clip.padded_bones + bone;
+                original[f] = glm::vec3(xs[i], ys[i], zs[i]);
+                min = glm::min(min, original[f]);
+                max = glm::max(max, original[f]);
+            }
+            CompressedClip::Track track;
+            track.min = min;
+            track.extent = max - min;
+            for (unsigned int f = 0; f < clip.num_frames; f++) {
+                for (int c = 0; c < 3; c++) {
+                    encoded[f][c] = encodeRange(original[f][c], track.min[c], track.extent[c]);
+                    decoded[f][c] = decodeRange(encoded[f][c], track.min[c], track.extent[c]);
+                }
+            }
+
+            const auto error = [&](const glm::vec3& value, const size_t f) { return glm::length(value - original[f]); };
+            const auto keys = reduceKeys(decoded, lerp, error, tolerance);
+            max_error = std::max(max_error, measureError(decoded, keys, lerp, error));
+
+            track.first_key = static_cast<uint32_t>(frames.size());
+            track.num_keys = static_cast<uint32_t>(keys.size());
+            for (const auto key : keys) {
+                frames.push_back(key);
+                values.insert(values.end(), encoded[key].begin(), encoded[key].end());
+            }
+            tracks.push_back(track);
+        };
+
+        for (unsigned int bone = 0; bone < clip.num_bones; bone++) {
+            compressVec3Track(clip.tx, clip.ty, clip.tz, bone, settings.position_error, compressed.translation_tracks,
+                              compressed.translation_frames, compressed.translation_values, stats.max_position_error);
+            compressVec3Track(clip.sx, clip.sy, clip.sz, bone, settings.scale_error, compressed.scale_tracks,
+                              compressed.scale_frames, compressed.scale_values, stats.max_scale_error);
+
+            for (unsigned int f = 0; f < clip.num_frames; f++) {
+                const size_t i = static_cast<size_t>(f) * clip.padded_bones + bone;
+                original_rotations[f] = glm::quat(clip.qw[i], clip.qx[i], clip.qy[i], clip.qz[i]);
+                encodeRotation(original_rotations[f], encoded[f].data());
+                decoded_rotations[f] = decodeRotation(encoded[f].data());
+            }
+            const auto angle = [&](const glm::quat& value, const size_t f) {
+                const float dot = std::min(1.0f, std::fabs(glm::dot(value, original_rotations[f])));
+                return 2.0f * std::acos(dot);
+            };
+            const auto keys = reduceKeys(decoded_rotations, nlerp, angle, settings.angular_error);
+            stats.max_angular_error = std::max(stats.max_angular_error, measureError(decoded_rotations, keys, nlerp, angle));
+
+            CompressedClip::Track track;
+            track.first_key = static_cast<uint32_t>(compressed.rotation_frames.size());
+            track.num_keys = static_cast<uint32_t>(keys.size());
+            for (const auto key : keys) {
+                compressed.rotation_frames.push_back(key);
+                compressed.rotation_values.insert(compressed.rotation_values.end(), encoded[key].begin(), encoded[key].end());
+            }
+            compressed.rotation_tracks.push_back(track);
+        }
+
+        stats.compressed_keys = compressed.translation_frames.size() + compressed.rotation_frames.size() + compressed.scale_frames.size();
+        stats.compressed_bytes = sizeof(CompressedClip)
+            + (compressed.translation_tracks.size() + compressed.rotation_tracks.size() + compressed.scale_tracks.size()) * sizeof(CompressedClip::Track)
+            + (stats.compressed_keys * 4) * sizeof(uint16_t); // One frame number and three values per key
+
+        return compressed;
+    }
+
+    // Index of the last key at or before the frame
+    static uint32_t findKey(const uint16_t* frames, const uint32_t num_keys, const float frame) {
+        const auto it = std::upper_bound(frames, frames + num_keys, frame,
+            [](const float value, const uint16_t key) { return value < static_cast<float>(key); });
+        return it == frames ? 0 : static_cast<uint32_t>(it - frames - 1);
+    }
+
+    /**
+     * Decompresses and interpolates every bone of a compressed clip into a local pose. The keys around the time
+     * are decoded into two SoA poses, which are then interpolated simd::WIDTH bones at a time like a baked clip.
+     * @param clip - The clip to sample
+     * @param time_in_seconds - Playback time, wrapped for looping clips and clamped otherwise
+     * @param pose - Output pose, resized to the clip's bone count if needed
+     * @param slerp_fixup - Correct nlerp towards constant angular velocity
+     */
+    void ClipCompression::sample(const CompressedClip& clip, float time_in_seconds, LocalPose& pose, const bool slerp_fixup) {
+        if (pose.num_bones != clip.num_bones) {
+            pose.resize(clip.num_bones);
+        }
+        if (clip.num_frames == 0 || clip.rotation_tracks.size() != clip.num_bones) return;
+
+        if (clip.looping && clip.duration > 0.0f) {
+            time_in_seconds = std::fmod(time_in_seconds, clip.duration);
+            if (time_in_seconds < 0.0f) time_in_seconds += clip.duration;
+        }
+        const float frame = std::clamp(time_in_seconds * clip.sample_rate, 0.0f, static_cast<float>(clip.num_frames - 1));
+
+        // Per thread, since crowds sample from jobs
+        thread_local LocalPose from, to;
+        thread_local std::vector<float> translation_alphas, rotation_alphas, scale_alphas;
+        if (from.num_bones != clip.num_bones) {
+            from.resize(clip.num_bones);
+            to.resize(clip.num_bones);
+        }
+        for (auto* alphas : {&translation_alphas, &rotation_alphas, &scale_alphas}) {
+            alphas->assign(from.padded_bones, 0.0f);
+        }
+
+        // Returns the key pair surrounding the frame and the interpolation factor between them
+        auto locate = [frame](const CompressedClip::Track& track, const std::vector<uint16_t>& frames, uint32_t& k0, uint32_t& k1) {
+            const uint16_t* track_frames = &frames[track.first_key];
+            k0 = findKey(track_frames, track.num_keys, frame);
+            k1 = std::min(k0 + 1, track.num_keys - 1);
+            if (k0 == k1) return 0.0f;
+            const float span = static_cast<float>(track_frames[k1] - track_frames[k0]);
+            return std::clamp((frame - track_frames[k0]) / span, 0.0f, 1.0f);
+        };
+
+        auto decodeVec3 = [](const CompressedClip::Track& track, const uint16_t* values) {
+            glm::vec3 result;
+            for (int c = 0; c < 3; c++) {
+                result[c] = decodeRange(values[c], track.min[c], track.extent[c]);
+            }
+            return result;
+        };
+
+        uint32_t k0, k1;
+        for (unsigned int bone = 0; bone < clip.num_bones; bone++) {
+            const auto& translation = clip.translation_tracks[bone];
+            translation_alphas[bone] = locate(translation, clip.translation_frames, k0, k1);
+            const glm::vec3 t0 = decodeVec3(translation, &clip.translation_values[(translation.first_key + k0) * 3]);
+            const glm::vec3 t1 = decodeVec3(translation, &clip.translation_values[(translation.first_key + k1) * 3]);
+
+            const auto& scale = clip.scale_tracks[bone];
+            scale_alphas[bone] = locate(scale, clip.scale_frames, k0, k1);
+            const glm::vec3 s0 = decodeVec3(scale, &clip.scale_values[(scale.first_key + k0) * 3]);
+            const glm::vec3 s1 = decodeVec3(scale, &clip.scale_values[(scale.first_key + k1) * 3]);
+
+            const auto& rotation = clip.rotation_tracks[bone];
+            rotation_alphas[bone] = locate(rotation, clip.rotation_frames, k0, k1);
+            const glm::quat q0 = decodeRotation(&clip.rotation_values[(rotation.first_key + k0) * 3]);
+            const glm::quat q1 = decodeRotation(&clip.rotation_values[(rotation.first_key + k1) * 3]);
+
+            from.setBone(bone, t0, q0, s0);
+            to.setBone(bone, t1, q1, s1);
+        }
+
+        AnimationClip::interpolate(from, to, translation_alphas.data(), rotation_alphas.data(), scale_alphas.data(),
+                                   slerp_fixup, pose);
+    }
+
+    /**
+     * Packs a unit quaternion into 48 bits: the index of the largest component (2 bits) and the
+     * other three at 15 bits each. The largest is rebuilt from the unit length, made positive by
+     * flipping the quaternion's sign since q and -q are the same rotation.
+     */
+    void ClipCompression::encodeRotation(const glm::quat& rotation, uint16_t* out) {
+        const float components[4] = {rotation.x, rotation.y, rotation.z, rotation.w};
+        int largest = 0;
+        for (int i = 1; i < 4; i++) {
+            if (std::fabs(components[i]) > std::fabs(components[largest])) largest = i;
+        }
+        const float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+        uint64_t bits = static_cast<uint64_t>(largest) << 45;
+        int shift = 30;
+        for (int i = 0; i < 4; i++) {
+            if (i == largest) continue;
+            const float normalized = std::clamp(components[i] * sign / QUAT_COMPONENT_RANGE * 0.5f + 0.5f, 0.0f, 1.0f);
+            const auto quantized = static_cast<uint64_t>(std::lround(normalized * QUAT_COMPONENT_MAX));
+            bits |= quantized << shift;
+            shift -= 15;
+        }
+        out[0] = static_cast<uint16_t>(bits);
+        out[1] = static_cast<uint16_t>(bits >> 16);
+        out[2] = static_cast<uint16_t>(bits >> 32);
+    }
+
+    glm::quat ClipCompression::decodeRotation(const uint16_t* in) {
+        const uint64_t bits = static_cast<uint64_t>(in[0]) | static_cast<uint64_t>(in[1]) << 16 | static_cast<uint64_t>(in[2]) << 32;
+        const int largest = static_cast<int>(bits >> 45) & 0x3;
+
+        float components[4];
+        float sum = 0.0f;
+        int shift = 30;
+        for (int i = 0; i < 4; i++) {
+            if (i == largest) continue;
+            const auto quantized = static_cast<float>((bits >> shift) & QUAT_COMPONENT_MAX);
+            components[i] = (quantized / QUAT_COMPONENT_MAX * 2.0f - 1.0f) * QUAT_COMPONENT_RANGE;
+            sum += components[i] * components[i];
+            shift -= 15;
+        }
+        components[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+        return glm::normalize(glm::quat(components[3], components[0], components[1], components[2]));
+    }
+
+    uint16_t ClipCompression::encodeRange(const float value, const float min, const float extent) {
+        if (extent <= 0.0f) return 0;
+        const float normalized = std::clamp((value - min) / extent, 0.0f, 1.0f);
+        return static_cast<uint16_t>(std::lround(normalized * 65535.0f));
+    }
+
+    float ClipCompression::decodeRange(const uint16_t value, const float min, const float extent) {
+        return min + extent * (static_cast<float>(value) / 65535.0f);
+    }
+}
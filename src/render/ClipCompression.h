@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace gl {
+    struct Animation;
+    struct BakedClip;
+    struct LocalPose;
+
+    struct CompressionSettings {
+        float position_error = 0.001f;  // Max translation error per bone, in the bone's local units
+        float angular_error = 0.001f;   // Max rotation error per bone, in radians
+        float scale_error = 0.001f;     // Max scale error per bone
+        bool discard_source_keys = true; // Free the Assimp keys and the baked clip once compressed
+    };
+
+    struct CompressionStats {
+        size_t source_bytes = 0;        // Assimp keys as loaded (double time + float value per key)
+        size_t compressed_bytes = 0;
+        size_t source_keys = 0;
+        size_t compressed_keys = 0;
+        float max_position_error = 0.0f;
+        float max_angular_error = 0.0f; // In radians
+        float max_scale_error = 0.0f;
+
+        float ratio() const { return compressed_bytes ? (float) source_bytes / (float) compressed_bytes : 0.0f; }
+    };
+
+    /**
+     * A baked clip with redundant keys removed and the rest quantized.
+     * Keys are stored per bone and per channel as a frame number on the baked clip's uniform grid.
+     * Rotations are packed smallest-three into 48 bits; translations and scales are 16 bits per
+     * component relative to the track's range.
+     */
+    struct CompressedClip {
+        struct Track {
+            uint32_t first_key = 0;
+            uint32_t num_keys = 0;
+            glm::vec3 min = glm::vec3(0.0f);    // Quantization range (unused for rotations)
+            glm::vec3 extent = glm::vec3(0.0f);
+        };
+
+        unsigned int num_bones = 0;
+        unsigned int num_frames = 0;
+        float sample_rate = 30.0f;
+        float duration = 0.0f;
+        bool looping = true;
+
+        std::vector<Track> translation_tracks, rotation_tracks, scale_tracks;  // One per bone
+        std::vector<uint16_t> translation_frames, rotation_frames, scale_frames;
+        std::vector<uint16_t> translation_values, rotation_values, scale_values; // Three per key
+
+        CompressionStats stats;
+    };
+
+    class ClipCompression {
+    public:
+        static CompressedClip compress(const BakedClip& clip, const Animation& source, const CompressionSettings& settings = {});
+        static void sample(const CompressedClip& clip, float time_in_seconds, LocalPose& pose, bool slerp_fixup = false);
+
+    private:
+        static void encodeRotation(const glm::quat& rotation, uint16_t* out);
+        static glm::quat decodeRotation(const uint16_t* in);
+        static uint16_t encodeRange(float value, float min, float extent);
+        static float decodeRange(uint16_t value, float min, float extent);
+    };
+}
@@ -0,0 +1,139 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "imgui.h"
+#include "../Debug.h"
+
+namespace gl {
+
+    void DynamicResolution::setEnabled(const bool enabled) {
+        enabled_ = enabled;
+        settle_frames_ = SETTLE_FRAMES;
+    }
+
+    /**
+     * @param milliseconds - GPU time the scene should take, leaving the rest of the frame for UI and presentation
+     */
+    void DynamicResolution::setTargetTime(const double milliseconds) {
+        target_ms_ = std::max(milliseconds, 0.1);
+    }
+
+    void DynamicResolution::setScaleRange(const float min_scale, const float max_scale) {
+        min_scale_ = std::clamp(min_scale, MIN_SCALE, MAX_SCALE);
+        max_scale_ = std::clamp(max_scale, min_scale_, MAX_SCALE);
+        scale_ = std::clamp(scale_, min_scale_, max_scale_);
+    }
+
+    // Allocates the target for the largest scale, smaller scales render into its lower left corner
+    void DynamicResolution::resize(const int width, const int height) {
+        if (framebuffer_ == 0) {
+            glGenFramebuffers(1, &framebuffer_);
+            glGenTextures(1, &color_);
+            glGenRenderbuffers(1, &depth_);
+        }
+        target_size_ = glm::ivec2(width, height);
+
+        glBindTexture(GL_TEXTURE_2D, color_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth_);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            debug::error("Dynamic resolution framebuffer is incomplete");
+        }
+    }
+
+    /**
+     * Starts timing the scene and binds the framebuffer to render it into, with a viewport of getRenderSize().
+     * @param width, height - Size of the window's framebuffer
+     */
+    void DynamicResolution::begin(const int width, const int height) {
+        timer_.begin();
+        if (!enabled_) {
+            render_size_ = glm::ivec2(width, height);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, width, height);
+            return;
+        }
+
+        const glm::ivec2 target_size(static_cast<int>(std::ceil(width * max_scale_)),
+            static_cast<int>(std::ceil(height * max_scale_)));
+        if (target_size != target_size_) {
+            resize(target_size.x, target_size.y);
+        }
+        render_size_ = glm::max(glm::ivec2(glm::round(glm::vec2(width, height) * scale_)), glm::ivec2(1));
+        render_size_ = glm::min(render_size_, target_size_);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+        glViewport(0, 0, render_size_.x, render_size_.y);
+    }
+
+    /**
+     * Upscales the scene into the window's framebuffer, leaving it bound with a full viewport, then picks the next
+     * frame's scale.
+     */
+    void DynamicResolution::end(const int width, const int height) {
+        if (enabled_) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, render_size_.x, render_size_.y, 0, 0, width, height, GL_COLOR_BUFFER_BIT,
+                GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, width, height);
+        }
+        timer_.end();
+        adapt();
+    }
+
+    void DynamicResolution::adapt() {
+        const double scene_ms = timer_.getMilliseconds();
+        if (!enabled_ || scene_ms <= 0.0) return;
+        if (settle_frames_ > 0) {
+            settle_frames_--;
+            return;
+        }
+
+        float next = scale_;
+        if (scene_ms > target_ms_) {
+            const float ideal = scale_ * static_cast<float>(std::sqrt(target_ms_ / scene_ms));
+            next = std::floor(ideal / SCALE_STEP) * SCALE_STEP;
+        } else if (scene_ms < HEADROOM * target_ms_) {
+            const float ideal = scale_ * static_cast<float>(std::sqrt(HEADROOM * target_ms_ / scene_ms));
+            next = std::min(std::floor(ideal / SCALE_STEP) * SCALE_STEP, scale_ + MAX_RISE);
+        }
+        next = std::clamp(next, min_scale_, max_scale_);
+        if (std::abs(next - scale_) >= 0.5f * SCALE_STEP) {
+            scale_ = next;
+            settle_frames_ = SETTLE_FRAMES;
+        }
+    }
+
+    // Settings section of the UI window
+    void DynamicResolution::drawUI() {
+        if (!ImGui::CollapsingHeader("Dynamic resolution")) return;
+
+        bool enabled = enabled_;
+        if (ImGui::Checkbox("Enabled (R)", &enabled)) {
+            setEnabled(enabled);
+        }
+        float target_ms = static_cast<float>(target_ms_);
+        if (ImGui::SliderFloat("Target ms", &target_ms, 2.0f, 33.0f, "%.1f")) {
+            setTargetTime(target_ms);
+        }
+        float min_scale = min_scale_;
+        float max_scale = max_scale_;
+        const bool min_changed = ImGui::SliderFloat("Min scale", &min_scale, MIN_SCALE, MAX_SCALE, "%.2f");
+        const bool max_changed = ImGui::SliderFloat("Max scale", &max_scale, MIN_SCALE, MAX_SCALE, "%.2f");
+        if (min_changed || max_changed) {
+            setScaleRange(min_scale, max_scale);
+        }
+    }
+}
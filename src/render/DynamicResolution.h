@@ -0,0 +1,62 @@
+#pragma once
+#include "GpuTimer.h"
+
+namespace gl {
+
+    /**
+     * Dynamic resolution scaling. While enabled, the 3D scene is rendered into an offscreen target at a fraction of
+     * the window's size and upscaled into the window afterwards, so UI drawn after end() stays at native resolution.
+     * The fraction (scale, per axis) follows the GPU time of the scene measured with timer queries: since that time
+     * is mostly proportional to the pixel count, the scale moves towards sqrt(target / measured). It changes in
+     * SCALE_STEP increments and waits for the timer to catch up after each change, so frame graph transients are
+     * only reallocated for a handful of sizes. Drops apply at once; rises only with some headroom, and gradually.
+     */
+    class DynamicResolution {
+    public:
+        static constexpr float SCALE_STEP = 0.05f;
+        static constexpr float MIN_SCALE = 0.25f;   // Bounds of setScaleRange
+        static constexpr float MAX_SCALE = 2.0f;
+
+        DynamicResolution() = default;
+        DynamicResolution(const DynamicResolution&) = delete;
+        DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+        void setEnabled(bool enabled);
+        void setTargetTime(double milliseconds);
+        void setScaleRange(float min_scale, float max_scale);
+
+        void begin(int width, int height);
+        void end(int width, int height);
+        void drawUI();
+
+        bool isEnabled() const { return enabled_; }
+        double getTargetTime() const { return target_ms_; }
+        float getMinScale() const { return min_scale_; }
+        float getMaxScale() const { return max_scale_; }
+        float getScale() const { return enabled_ ? scale_ : 1.0f; }
+        double getSceneTime() const { return timer_.getMilliseconds(); }
+        glm::ivec2 getRenderSize() const { return render_size_; }
+
+    private:
+        static constexpr int SETTLE_FRAMES = 6;        // Timer results arrive a few frames late
+        static constexpr float HEADROOM = 0.85f;       // Scale rises only below this fraction of the target time
+        static constexpr float MAX_RISE = 2 * SCALE_STEP;
+
+        void resize(int width, int height);
+        void adapt();
+
+        bool enabled_ = false;
+        double target_ms_ = 12.0;
+        float min_scale_ = 0.5f;
+        float max_scale_ = 1.0f;
+        float scale_ = 1.0f;
+        int settle_frames_ = 0;
+
+        GpuTimer timer_;
+        GLuint framebuffer_ = 0;
+        GLuint color_ = 0;
+        GLuint depth_ = 0;          // DEPTH24_STENCIL8 like the window's, so it can be blitted into other targets
+        glm::ivec2 target_size_ = glm::ivec2(0);
+        glm::ivec2 render_size_ = glm::ivec2(0);
+    };
+}
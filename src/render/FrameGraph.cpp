@@ -0,0 +1,416 @@
+#include "FrameGraph.h"
+
+#include <algorithm>
+
+#include "../Debug.h"
+
+namespace gl {
+
+    namespace {
+        struct FormatInfo {
+            GLenum format;
+            GLenum type;
+            size_t bytes;           // Per texel
+            GLenum attachment;      // 0 for color formats
+        };
+
+        FormatInfo getFormatInfo(const GLenum internal_format) {
+            switch (internal_format) {
+            case GL_RGBA8: return {GL_RGBA, GL_UNSIGNED_BYTE, 4, 0};
+            case GL_RGBA16F: return {GL_RGBA, GL_HALF_FLOAT, 8, 0};
+            case GL_RGBA32F: return {GL_RGBA, GL_FLOAT, 16, 0};
+            case GL_RG16F: return {GL_RG, GL_HALF_FLOAT, 4, 0};
+            case GL_R8: return {GL_RED, GL_UNSIGNED_BYTE, 1, 0};
+            case GL_R16F: return {GL_RED, GL_HALF_FLOAT, 2, 0};
+            case GL_R32F: return {GL_RED, GL_FLOAT, 4, 0};
+            case GL_DEPTH24_STENCIL8: return {GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 4, GL_DEPTH_STENCIL_ATTACHMENT};
+            case GL_DEPTH_COMPONENT24: return {GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 4, GL_DEPTH_ATTACHMENT};
+            case GL_DEPTH_COMPONENT32F: return {GL_DEPTH_COMPONENT, GL_FLOAT, 4, GL_DEPTH_ATTACHMENT};
+            default:
+                debug::error("Unsupported frame graph texture format " + std::to_string(internal_format));
+                return {GL_RGBA, GL_UNSIGNED_BYTE, 4, 0};
+            }
+        }
+
+        size_t getByteSize(const FrameTextureDesc& desc) {
+            return static_cast<size_t>(desc.width) * desc.height * getFormatInfo(desc.format).bytes;
+        }
+    }
+
+    // Declares a transient texture written by this pass
+    FrameResource FrameGraph::Builder::create(const std::string& name, const FrameTextureDesc& desc) {
+        auto& resource = graph_.resources_.emplace_back();
+        resource.name = name;
+        resource.kind = TRANSIENT_TEXTURE;
+        resource.desc = desc;
+        const FrameResource version = graph_.addVersion(static_cast<int>(graph_.resources_.size() - 1), pass_);
+        graph_.passes_[pass_].writes.push_back(version);
+        return version;
+    }
+
+    FrameResource FrameGraph::Builder::read(const FrameResource resource) {
+        graph_.passes_[pass_].reads.push_back(resource);
+        return resource;
+    }
+
+    /**
+     * Declares that this pass modifies a resource, drawing over its current contents.
+     * @return the new version, which later passes must use instead of resource
+     */
+    FrameResource FrameGraph::Builder::write(const FrameResource resource) {
+        const int index = graph_.versions_[resource].resource;
+        if (graph_.resources_[index].latest != resource) {
+            debug::error("Pass " + graph_.passes_[pass_].name + " writes an old version of "
+                + graph_.resources_[index].name);
+        }
+        read(resource);
+        const FrameResource version = graph_.addVersion(index, pass_);
+        graph_.passes_[pass_].writes.push_back(version);
+        return version;
+    }
+
+    // Keeps the pass even if nothing reads what it writes, e.g. because it issues queries
+    void FrameGraph::Builder::setSideEffect() {
+        graph_.passes_[pass_].side_effect = true;
+    }
+
+    // Starts a new frame's graph. Pooled textures and framebuffers are kept
+    void FrameGraph::reset() {
+        resources_.clear();
+        versions_.clear();
+        passes_.clear();
+        order_.clear();
+    }
+
+    FrameResource FrameGraph::addVersion(const int resource, const int producer) {
+        auto& version = versions_.emplace_back();
+        version.resource = resource;
+        version.producer = producer;
+        resources_[resource].latest = static_cast<int>(versions_.size() - 1);
+        return resources_[resource].latest;
+    }
+
+    FrameResource FrameGraph::importTexture(const std::string& name, const GLuint texture) {
+        auto& resource = resources_.emplace_back();
+        resource.name = name;
+        resource.kind = IMPORTED_TEXTURE;
+        resource.object = texture;
+        return addVersion(static_cast<int>(resources_.size() - 1), -1);
+    }
+
+    // Only orders the passes using it, e.g. texture buffers uploaded by one pass and sampled by others
+    FrameResource FrameGraph::importBuffer(const std::string& name) {
+        auto& resource = resources_.emplace_back();
+        resource.name = name;
+        resource.kind = IMPORTED_BUFFER;
+        return addVersion(static_cast<int>(resources_.size() - 1), -1);
+    }
+
+    /**
+     * @param framebuffer - Bound, with a width x height viewport, before each pass that writes it
+     */
+    FrameResource FrameGraph::importFramebuffer(const std::string& name, const GLuint framebuffer, const int width,
+        const int height) {
+        auto& resource = resources_.emplace_back();
+        resource.name = name;
+        resource.kind = IMPORTED_FRAMEBUFFER;
+        resource.desc.width = width;
+        resource.desc.height = height;
+        resource.object = framebuffer;
+        return addVersion(static_cast<int>(resources_.size() - 1), -1);
+    }
+
+    /**
+     * Adds a pass. setup runs immediately and declares the pass's resources; execute runs during execute().
+     */
+    void FrameGraph::addPass(const std::string& name, const Setup& setup, const Execute& execute) {
+        auto& pass = passes_.emplace_back();
+        pass.name = name;
+        pass.execute = execute;
+        Builder builder(*this, static_cast<int>(passes_.size() - 1));
+        setup(builder);
+    }
+
+    // Marks a result of the frame, keeping the passes it depends on
+    void FrameGraph::markOutput(const FrameResource resource) {
+        versions_[resource].output = true;
+    }
+
+    void FrameGraph::compile() {
+        frame_++;
+        evictTextures();
+        cullPasses();
+        orderPasses();
+        assignTextures();
+    }
+
+    // Drops passes none of whose writes are read or output, then those only they read from, and so on
+    void FrameGraph::cullPasses() {
+        for (auto& version : versions_) {
+            version.references = version.output ? 1 : 0;
+        }
+        for (auto& pass : passes_) {
+            pass.references = static_cast<int>(pass.writes.size());
+            pass.culled = false;
+            for (const auto read : pass.reads) {
+                versions_[read].references++;
+            }
+        }
+
+        std::vector<int> unreferenced;
+        const auto cull = [&](Pass& pass) {
+            pass.culled = true;
+            for (const auto read : pass.reads) {
+                if (--versions_[read].references == 0) {
+                    unreferenced.push_back(read);
+                }
+            }
+        };
+        for (int i = 0; i < static_cast<int>(versions_.size()); i++) {
+            if (versions_[i].references == 0) unreferenced.push_back(i);
+        }
+        for (auto& pass : passes_) {
+            if (pass.references == 0 && !pass.side_effect) cull(pass);
+        }
+        while (!unreferenced.empty()) {
+            const int producer = versions_[unreferenced.back()].producer;
+            unreferenced.pop_back();
+            if (producer < 0) continue;
+            auto& pass = passes_[producer];
+            if (--pass.references == 0 && !pass.side_effect && !pass.culled) {
+                cull(pass);
+            }
+        }
+    }
+
+    // Topological order of the remaining passes; of those ready, the one added first goes next
+    void FrameGraph::orderPasses() {
+        const int count = static_cast<int>(passes_.size());
+        std::vector<int> waiting(count, 0);
+        std::vector<std::vector<int>> dependents(count);
+        for (int i = 0; i < count; i++) {
+            if (passes_[i].culled) continue;
+            for (const auto read : passes_[i].reads) {
+                const int producer = versions_[read].producer;
+                if (producer < 0 || producer == i) continue;
+                dependents[producer].push_back(i);
+                waiting[i]++;
+            }
+        }
+
+        std::vector<int> ready;
+        for (int i = 0; i < count; i++) {
+            if (!passes_[i].culled && waiting[i] == 0) ready.push_back(i);
+        }
+        while (!ready.empty()) {
+            const auto first = std::min_element(ready.begin(), ready.end());
+            const int pass = *first;
+            ready.erase(first);
+            order_.push_back(pass);
+            for (const int dependent : dependents[pass]) {
+                if (--waiting[dependent] == 0) ready.push_back(dependent);
+            }
+        }
+        if (order_.size() != static_cast<size_t>(std::count_if(passes_.begin(), passes_.end(),
+            [](const Pass& pass) { return !pass.culled; }))) {
+            debug::error("Frame graph has a dependency cycle");
+        }
+    }
+
+    /**
+     * Gives each transient a pooled texture for the passes between its first and last use, reusing those whose
+     * transients are no longer used once a pass has run.
+     */
+    void FrameGraph::assignTextures() {
+        for (auto& resource : resources_) {
+            resource.texture = -1;
+            resource.first_use = resource.last_use = -1;
+        }
+        for (int position = 0; position < static_cast<int>(order_.size()); position++) {
+            const auto& pass = passes_[order_[position]];
+            for (const auto* list : {&pass.reads, &pass.writes}) {
+                for (const auto version : *list) {
+                    auto& resource = resources_[versions_[version].resource];
+                    if (resource.kind != TRANSIENT_TEXTURE) continue;
+                    if (resource.first_use < 0) resource.first_use = position;
+                    resource.last_use = position;
+                }
+            }
+        }
+
+        for (auto& texture : pool_) {
+            texture.busy = false;
+        }
+        transient_bytes_ = 0;
+        allocated_bytes_ = 0;
+        for (int position = 0; position < static_cast<int>(order_.size()); position++) {
+            for (auto& resource : resources_) {
+                if (resource.kind != TRANSIENT_TEXTURE || resource.first_use != position) continue;
+                resource.texture = acquireTexture(resource.desc);
+                transient_bytes_ += getByteSize(resource.desc);
+            }
+            for (const auto& resource : resources_) {
+                if (resource.texture >= 0 && resource.last_use == position) {
+                    pool_[resource.texture].busy = false;
+                }
+            }
+        }
+        for (const auto& texture : pool_) {
+            if (texture.last_frame == frame_) allocated_bytes_ += getByteSize(texture.desc);
+        }
+    }
+
+    int FrameGraph::acquireTexture(const FrameTextureDesc& desc) {
+        for (int i = 0; i < static_cast<int>(pool_.size()); i++) {
+            auto& texture = pool_[i];
+            if (texture.busy || !(texture.desc == desc)) continue;
+            texture.busy = true;
+            texture.last_frame = frame_;
+            return i;
+        }
+
+        auto& texture = pool_.emplace_back();
+        texture.desc = desc;
+        texture.last_frame = frame_;
+        texture.busy = true;
+        const auto info = getFormatInfo(desc.format);
+        glGenTextures(1, &texture.texture);
+        glBindTexture(GL_TEXTURE_2D, texture.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, info.format, info.type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return static_cast<int>(pool_.size() - 1);
+    }
+
+    // Deletes textures left over from other sizes or paths, with the framebuffers using them
+    void FrameGraph::evictTextures() {
+        for (const auto& texture : pool_) {
+            if (frame_ - texture.last_frame <= EVICT_FRAMES) continue;
+            for (auto it = framebuffers_.begin(); it != framebuffers_.end();) {
+                if (std::find(it->first.begin(), it->first.end(), texture.texture) != it->first.end()) {
+                    glDeleteFramebuffers(1, &it->second);
+                    it = framebuffers_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            glDeleteTextures(1, &texture.texture);
+        }
+        std::erase_if(pool_, [this](const PooledTexture& texture) { return frame_ - texture.last_frame > EVICT_FRAMES; });
+    }
+
+    // Framebuffer with the pass's written transients attached, color targets in the order they were declared
+    GLuint FrameGraph::getPassFramebuffer(const Pass& pass) const {
+        std::vector<GLuint> attachments;
+        GLuint depth = 0;
+        GLenum depth_attachment = 0;
+        for (const auto version : pass.writes) {
+            const auto& resource = resources_[versions_[version].resource];
+            if (resource.kind != TRANSIENT_TEXTURE) continue;
+            const auto info = getFormatInfo(resource.desc.format);
+            if (info.attachment != 0) {
+                depth = pool_[resource.texture].texture;
+                depth_attachment = info.attachment;
+            } else {
+                attachments.push_back(pool_[resource.texture].texture);
+            }
+        }
+        const size_t color_count = attachments.size();
+        attachments.push_back(depth);
+        if (const auto it = framebuffers_.find(attachments); it != framebuffers_.end()) {
+            return it->second;
+        }
+
+        GLuint framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        std::vector<GLenum> draw_buffers;
+        for (size_t i = 0; i < color_count; i++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, attachments[i], 0);
+            draw_buffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+        }
+        if (depth != 0) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, depth_attachment, GL_TEXTURE_2D, depth, 0);
+        }
+        if (draw_buffers.empty()) {
+            glDrawBuffer(GL_NONE);
+        } else {
+            glDrawBuffers(static_cast<GLsizei>(draw_buffers.size()), draw_buffers.data());
+        }
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            debug::error("Frame graph framebuffer of pass " + pass.name + " is incomplete");
+        }
+        framebuffers_[attachments] = framebuffer;
+        return framebuffer;
+    }
+
+    /**
+     * Runs the compiled passes in order, then restores the framebuffer and viewport bound before.
+     */
+    void FrameGraph::execute() const {
+        GLint previous_framebuffer;
+        GLint previous_viewport[4];
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+        glGetIntegerv(GL_VIEWPORT, previous_viewport);
+
+        for (const int index : order_) {
+            const auto& pass = passes_[index];
+            const Resource* target = nullptr;
+            bool transient_target = false;
+            for (const auto version : pass.writes) {
+                const auto& resource = resources_[versions_[version].resource];
+                if (resource.kind == TRANSIENT_TEXTURE) {
+                    if (!transient_target) target = &resource;
+                    transient_target = true;
+                } else if (resource.kind == IMPORTED_FRAMEBUFFER && !transient_target) {
+                    target = &resource;
+                }
+            }
+            if (transient_target) {
+                glBindFramebuffer(GL_FRAMEBUFFER, getPassFramebuffer(pass));
+                glViewport(0, 0, target->desc.width, target->desc.height);
+            } else if (target) {
+                glBindFramebuffer(GL_FRAMEBUFFER, target->object);
+                glViewport(0, 0, target->desc.width, target->desc.height);
+            }
+            pass.execute(*this);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+        glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+    }
+
+    GLuint FrameGraph::getTexture(const FrameResource resource) const {
+        const auto& entry = resources_[versions_[resource].resource];
+        if (entry.kind == TRANSIENT_TEXTURE) {
+            return entry.texture >= 0 ? pool_[entry.texture].texture : 0;
+        }
+        return entry.kind == IMPORTED_TEXTURE ? entry.object : 0;
+    }
+
+    GLuint FrameGraph::getFramebuffer(const FrameResource resource) const {
+        const auto& entry = resources_[versions_[resource].resource];
+        return entry.kind == IMPORTED_FRAMEBUFFER ? entry.object : 0;
+    }
+
+    // Prints the compiled pass order, culled passes and which pooled texture each transient landed in
+    void FrameGraph::print() const {
+        debug::print("Frame graph passes:");
+        for (size_t i = 0; i < order_.size(); i++) {
+            debug::print("  " + std::to_string(i + 1) + ". " + passes_[order_[i]].name);
+        }
+        for (const auto& pass : passes_) {
+            if (pass.culled) debug::print("  culled: " + pass.name);
+        }
+        for (const auto& resource : resources_) {
+            if (resource.texture < 0) continue;
+            debug::print("  " + resource.name + " -> texture " + std::to_string(resource.texture) + ", passes "
+                + std::to_string(resource.first_use + 1) + "-" + std::to_string(resource.last_use + 1));
+        }
+        debug::print("  transient " + std::to_string(transient_bytes_ / 1024) + " KB in "
+            + std::to_string(allocated_bytes_ / 1024) + " KB of textures");
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "GL/glew.h"
+
+namespace gl {
+
+    using FrameResource = int;     // Handle to one version of a frame graph resource
+    constexpr FrameResource NULL_RESOURCE = -1;
+
+    struct FrameTextureDesc {
+        int width = 0;
+        int height = 0;
+        GLenum format = GL_RGBA8;   // Sized internal format; depth formats become the depth attachment
+
+        bool operator==(const FrameTextureDesc&) const = default;
+    };
+
+    /**
+     * Builds a frame from passes that declare which named textures and buffers they read and write.
+     * Every write makes a new version of its resource, so the declarations form a graph. compile() drops passes
+     * whose results nothing reads (unless they have side effects), orders the rest by their dependencies, keeping
+     * the order they were added in where it is free, and assigns each transient texture a pooled GL texture.
+     * Transients whose lifetimes do not overlap share one, so the peak memory is that of the most targets alive
+     * at once rather than their sum. A transient's contents are undefined until its first writer clears it.
+     * Before each pass runs, its written transients are bound as one framebuffer, or the imported framebuffer
+     * it writes. Imported resources are owned elsewhere and only ordered.
+     */
+    class FrameGraph {
+    public:
+        class Builder {
+        public:
+            FrameResource create(const std::string& name, const FrameTextureDesc& desc);
+            FrameResource read(FrameResource resource);
+            FrameResource write(FrameResource resource);
+            void setSideEffect();
+
+        private:
+            friend class FrameGraph;
+            Builder(FrameGraph& graph, int pass) : graph_(graph), pass_(pass) {}
+
+            FrameGraph& graph_;
+            int pass_;
+        };
+        using Setup = std::function<void(Builder&)>;
+        using Execute = std::function<void(const FrameGraph&)>;
+
+        FrameGraph() = default;
+        FrameGraph(const FrameGraph&) = delete;
+        FrameGraph& operator=(const FrameGraph&) = delete;
+
+        void reset();
+        FrameResource importTexture(const std::string& name, GLuint texture);
+        FrameResource importBuffer(const std::string& name);
+        FrameResource importFramebuffer(const std::string& name, GLuint framebuffer, int width, int height);
+        void addPass(const std::string& name, const Setup& setup, const Execute& execute);
+        void markOutput(FrameResource resource);
+
+        void compile();
+        void execute() const;
+        void print() const;
+
+        GLuint getTexture(FrameResource resource) const;
+        GLuint getFramebuffer(FrameResource resource) const;
+        size_t getTransientBytes() const { return transient_bytes_; }
+        size_t getAllocatedBytes() const { return allocated_bytes_; }
+
+    private:
+        static constexpr int EVICT_FRAMES = 120;   // Pooled textures unused this long are deleted
+
+        enum ResourceKind { TRANSIENT_TEXTURE, IMPORTED_TEXTURE, IMPORTED_BUFFER, IMPORTED_FRAMEBUFFER };
+
+        struct Resource {
+            std::string name;
+            ResourceKind kind;
+            FrameTextureDesc desc;
+            GLuint object = 0;          // Imported texture or framebuffer
+            int latest = NULL_RESOURCE; // Newest version; only it may be written
+            int texture = -1;           // Pooled texture of a transient, set by compile()
+            int first_use = -1;         // Positions in order_
+            int last_use = -1;
+        };
+
+        struct Version {
+            int resource;
+            int producer = -1;          // Pass that wrote it, -1 for the imported contents
+            int references = 0;         // Reading passes, plus one if it is an output
+            bool output = false;
+        };
+
+        struct Pass {
+            std::string name;
+            Execute execute;
+            std::vector<FrameResource> reads;
+            std::vector<FrameResource> writes;
+            int references = 0;
+            bool side_effect = false;
+            bool culled = false;
+        };
+
+        struct PooledTexture {
+            FrameTextureDesc desc;
+            GLuint texture = 0;
+            int last_frame = 0;
+            bool busy = false;
+        };
+
+        FrameResource addVersion(int resource, int producer);
+        void cullPasses();
+        void orderPasses();
+        void assignTextures();
+        int acquireTexture(const FrameTextureDesc& desc);
+        void evictTextures();
+        GLuint getPassFramebuffer(const Pass& pass) const;
+
+        std::vector<Resource> resources_;
+        std::vector<Version> versions_;
+        std::vector<Pass> passes_;
+        std::vector<int> order_;
+
+        std::vector<PooledTexture> pool_;
+        mutable std::map<std::vector<GLuint>, GLuint> framebuffers_;   // By attachments, depth last
+        int frame_ = 0;
+        size_t transient_bytes_ = 0;
+        size_t allocated_bytes_ = 0;
+    };
+}
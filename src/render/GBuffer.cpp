@@ -0,0 +1,27 @@
+#include "GBuffer.h"
+
+namespace gl {
+
+    // Declares the targets as written by the geometry pass
+    GBuffer GBuffer::create(FrameGraph::Builder& builder, const int width, const int height) {
+        GBuffer g_buffer;
+        g_buffer.albedo = builder.create("G-buffer albedo", {width, height, GL_RGBA8});
+        g_buffer.normal = builder.create("G-buffer normal", {width, height, GL_RGBA16F});
+        g_buffer.depth = builder.create("G-buffer depth", {width, height, GL_DEPTH24_STENCIL8});
+        return g_buffer;
+    }
+
+    void GBuffer::read(FrameGraph::Builder& builder) const {
+        builder.read(albedo);
+        builder.read(normal);
+        builder.read(depth);
+    }
+
+    // Clears the bound G-buffer; its textures may hold another transient's contents
+    void GBuffer::clear() {
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "FrameGraph.h"
+
+namespace gl {
+
+    /**
+     * Render targets of the deferred path, frame graph transients, two color targets plus depth:
+     *  0  RGBA8    albedo rgb, specular intensity
+     *  1  RGBA16F  octahedral normal xy, shininess, unused
+     *  depth       DEPTH24_STENCIL8 texture, world positions are reconstructed from it
+     * Geometry is drawn into it with the G-buffer shader and lit in one fullscreen pass into the scene framebuffer,
+     * which also writes its depth there so forward passes (skinned meshes, blended surfaces) test against it.
+     */
+    struct GBuffer {
+        FrameResource albedo = NULL_RESOURCE;
+        FrameResource normal = NULL_RESOURCE;
+        FrameResource depth = NULL_RESOURCE;
+
+        static GBuffer create(FrameGraph::Builder& builder, int width, int height);
+        void read(FrameGraph::Builder& builder) const;
+        static void clear();
+    };
+}
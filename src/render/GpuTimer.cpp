@@ -0,0 +1,40 @@
+#include "GpuTimer.h"
+
+namespace gl {
+
+    void GpuTimer::begin() {
+        if (queries_[0][0] == 0) {
+            glGenQueries(2 * QUERY_COUNT, &queries_[0][0]);
+        }
+
+        // Collect every finished query, oldest first, then reuse the current slot
+        for (int i = 0; i < QUERY_COUNT; i++) {
+            const int slot = (current_ + i) % QUERY_COUNT;
+            if (!pending_[slot]) continue;
+
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(queries_[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available && slot != current_) continue;
+
+            GLuint64 begin = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64v(queries_[slot][0], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries_[slot][1], GL_QUERY_RESULT, &end); // Only blocks when the ring is full
+            milliseconds_ = static_cast<double>(end - begin) * 1e-6;
+            pending_[slot] = false;
+        }
+
+        glQueryCounter(queries_[current_][0], GL_TIMESTAMP);
+    }
+
+    void GpuTimer::end() {
+        glQueryCounter(queries_[current_][1], GL_TIMESTAMP);
+        pending_[current_] = true;
+        current_ = (current_ + 1) % QUERY_COUNT;
+    }
+
+    // Latest available result
+    double GpuTimer::getMilliseconds() const {
+        return milliseconds_;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "GL/glew.h"
+
+namespace gl {
+
+    /**
+     * Measures GPU time between begin() and end() with a pair of GL_TIMESTAMP queries. Results are read a few
+     * frames late from a small ring of query pairs so that reading them does not stall the pipeline.
+     * Unlike GL_TIME_ELAPSED queries, timers can be nested, e.g. per pass inside a whole frame.
+     */
+    class GpuTimer {
+    public:
+        GpuTimer() = default;
+        GpuTimer(const GpuTimer&) = delete;
+        GpuTimer& operator=(const GpuTimer&) = delete;
+
+        void begin();
+        void end();
+        double getMilliseconds() const;
+
+    private:
+        static constexpr int QUERY_COUNT = 4;
+
+        GLuint queries_[QUERY_COUNT][2] = {};   // Begin and end timestamps
+        bool pending_[QUERY_COUNT] = {};
+        int current_ = 0;
+        double milliseconds_ = 0.0;
+    };
+}
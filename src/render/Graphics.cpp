@@ -1,60 +1,148 @@
 #include "Graphics.h"
 
 #include <iostream>
+#include <iterator>
 
+#include "CascadedShadows.h"
 #include "Camera.h"
+#include "FrameGraph.h"
+#include "GBuffer.h"
+#include "LightClusters.h"
 #include "Mesh.h"
-#include "Shaders.h"
+#include "ShaderVariants.h"
 #include "SkeletalMesh.h"
+#include "SkinnedCrowd.h"
 #include "stb_image.h"
+#include "../Profiler.h"
 #include "../Debug.h"
 
 namespace gl {
 
-    ShaderProgram* Graphics::active_shader_;
-    ShaderProgram Graphics::phong_;
-    ShaderProgram Graphics::skinned_;
+    ShaderVariants* Graphics::active_shader_;
+    ShaderVariants Graphics::phong_;
+    ShaderVariants Graphics::skinned_;
+    ShaderVariants Graphics::skinned_dq_;
+    SkinningMode Graphics::skinning_mode_ = LINEAR_BLEND;
+    ShaderVariants Graphics::skinned_instanced_;
+    ShaderVariants Graphics::skinned_baked_;
+    ShaderVariants Graphics::skinning_feedback_;
+    ShaderVariants Graphics::bounds_;
+    ShaderVariants Graphics::depth_;
+    ShaderVariants Graphics::gbuffer_;
+    ShaderVariants Graphics::skinned_depth_;
+    ShaderVariants Graphics::deferred_lighting_;
+    GLuint Graphics::fullscreen_vao_ = 0;
+    GLuint Graphics::bounds_vao_ = 0;
+    GLuint Graphics::bounds_vbo_ = 0;
+    GLuint Graphics::bounds_ebo_ = 0;
+    GLuint Graphics::bone_buffer_ = 0;
+    GLuint Graphics::bone_texture_ = 0;
+    std::vector<glm::vec4> Graphics::bone_staging_;
     std::unordered_map<std::string, DrawShape> Graphics::shapes_;
 
+    // Set for every draw, so interned once instead of on each call
+    static const UniformName MODEL("model");
+    static const UniformName NORMAL("normal");
+    static const UniformName BONE_BUFFER("bone_buffer");
+    static const UniformName BONE_DQ("gBoneDQ");
+    static const UniformName BONES("gBones");
+    static const UniformName INSTANCE_STRIDE("instance_stride");
+    static const UniformName INSTANCE_DATA("instance_data");
+    static const UniformName ANIMATION_TEXTURE("animation_texture");
+    static const UniformName BAKED_CLIPS("baked_clips");
+    static const UniformName AMBIENT("ambient");
+    static const UniformName DIFFUSE("diffuse");
+    static const UniformName SPECULAR("specular");
+    static const UniformName SHININESS("shininess");
+    static const UniformName OPACITY("opacity");
+    static const UniformName TEXTURE_AMBIENT("texture_ambient");
+    static const UniformName TEXTURE_DIFFUSE("texture_diffuse");
+    static const UniformName TEXTURE_SPECULAR("texture_specular");
+
+    // Set for every pass and shader
+    static const UniformName VIEW("view");
+    static const UniformName PROJECTION("projection");
+    static const UniformName CAMERA_POS("camera_pos");
+    static const UniformName LIGHT_POSITION("light_position");
+    static const UniformName LIGHT_COLOR("light_color");
+    static const UniformName SHADOW_MATRICES[] = {"shadow_matrices[0]", "shadow_matrices[1]", "shadow_matrices[2]",
+        "shadow_matrices[3]"};
+    static_assert(std::size(SHADOW_MATRICES) == CascadedShadows::CASCADE_COUNT);
+    static const UniformName CASCADE_SPLITS("cascade_splits");
+    static const UniformName SHADOW_TEXEL_SIZES("shadow_texel_sizes");
+    static const UniformName CLUSTER_TILE_SIZE("cluster_tile_size");
+    static const UniformName CLUSTER_SLICES("cluster_slices");
+
     void Graphics::initialize() {
         initializePhongShader();
+        initializeBoundsBox();
         setAmbientLight(glm::vec3(0.5));
     }
 
     void Graphics::tearDown() {
-        phong_.deleteProgram();
+        ShaderVariants::deletePrograms();
     }
 
     void Graphics::usePhongShader() {
         phong_.use();
         active_shader_ = &phong_;
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);    // Off after a depth prepass
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         glEnable(GL_POLYGON_OFFSET_FILL);
         glEnable(GL_CULL_FACE);
         glEnable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
+        glDisable(GL_BLEND);    // Blended materials turn it on with setBlending
         // glEnable(GL_POLYGON_SMOOTH);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glPolygonOffset(1.0, 1.0);
     }
 
     void Graphics::useSkinnedShader() {
-        skinned_.use();
-        active_shader_ = &skinned_;
+        active_shader_ = skinning_mode_ == DUAL_QUATERNION ? &skinned_dq_ : &skinned_;
+        active_shader_->use();
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         glEnable(GL_POLYGON_OFFSET_FILL);
         glEnable(GL_CULL_FACE);
         glEnable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
+        glDisable(GL_BLEND);    // Blended materials turn it on with setBlending
         // glEnable(GL_POLYGON_SMOOTH);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glPolygonOffset(1.0, 1.0);
     }
 
+    void Graphics::useSkinnedInstancedShader() {
+        skinned_instanced_.use();
+        active_shader_ = &skinned_instanced_;
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glPolygonOffset(1.0, 1.0);
+    }
+
+    void Graphics::useSkinnedBakedShader() {
+        skinned_baked_.use();
+        active_shader_ = &skinned_baked_;
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glPolygonOffset(1.0, 1.0);
+    }
+
     void Graphics::drawObject(const DrawShape* drawShape, const Transform& transform, const DrawMaterial& material) {
-        const auto model_matrix = transform.getModelMatrix();
-        phong_.setMat4("model", model_matrix);
-        phong_.setMat3("normal", glm::transpose(glm::inverse(glm::mat3(model_matrix))));
+        drawObject(drawShape, transform.getModelMatrix(), transform.getNormalMatrix(), material);
+    }
+
+    // For objects placed by a SceneGraph, which keeps its own world and normal matrices
+    void Graphics::drawObject(const DrawShape* drawShape, const glm::mat4& model_matrix, const glm::mat3& normal_matrix,
+        const DrawMaterial& material) {
+        active_shader_->setMat4(MODEL, model_matrix);
+        active_shader_->setMat3(NORMAL, normal_matrix);
 
         setMaterialUniforms(material);
 
@@ -65,37 +153,261 @@ namespace gl {
     }
 
     void Graphics::drawMesh(const DrawMesh* draw_mesh, const Transform& transform) {
-        const auto model_matrix = transform.getModelMatrix();
-        phong_.setMat4("model", model_matrix);
-        phong_.setMat3("normal", glm::transpose(glm::inverse(glm::mat3(model_matrix))));
+        active_shader_->setMat4(MODEL, transform.getModelMatrix());
+        active_shader_->setMat3(NORMAL, transform.getNormalMatrix());
+
+        drawMeshObjects(*draw_mesh);
+    }
+
+    void Graphics::drawSkinned(SkinnedMesh* skinned_mesh, const Transform& transform) {
+        active_shader_->setMat4(MODEL, transform.getModelMatrix());
+        active_shader_->setMat3(NORMAL, transform.getNormalMatrix());
+
 
-        for (const auto& obj : draw_mesh->objects) {
+        const auto& draw_mesh = skinned_mesh->draw_mesh;
+        setBonePalette(skinned_mesh->skeleton, skinning_mode_);
+
+        drawMeshObjects(draw_mesh);
+    }
+
+    /**
+     * Draws a mesh's objects with the active shader and model uniforms, blended objects last. Within a single
+     * mesh they are not sorted; meshes with overlapping translucent parts should go through a RenderQueue.
+     */
+    void Graphics::drawMeshObjects(const DrawMesh& draw_mesh) {
+        bool has_blended = false;
+        for (const auto& obj : draw_mesh.objects) {
+            if (obj.material.alpha_mode == ALPHA_BLEND) {
+                has_blended = true;
+                continue;
+            }
             setMaterialUniforms(obj.material);
             glBindVertexArray(obj.shape.vao);
             glDrawElements(GL_TRIANGLES, 3 * obj.shape.numTriangles, GL_UNSIGNED_INT, 0);
+        }
+        if (has_blended) {
+            setBlending(true);
+            for (const auto& obj : draw_mesh.objects) {
+                if (obj.material.alpha_mode != ALPHA_BLEND) continue;
+                setMaterialUniforms(obj.material);
+                glBindVertexArray(obj.shape.vao);
+                glDrawElements(GL_TRIANGLES, 3 * obj.shape.numTriangles, GL_UNSIGNED_INT, 0);
+            }
+            setBlending(false);
+        }
+        glBindVertexArray(0);
+    }
+
+    // Draws a skinned mesh's depth. Expects the skinned shadow caster shader to be active
+    void Graphics::drawSkinnedDepth(SkinnedMesh* skinned_mesh, const Transform& transform) {
+        active_shader_->setMat4(MODEL, transform.getModelMatrix());
+        setBonePalette(skinned_mesh->skeleton, LINEAR_BLEND);
+        for (const auto& obj : skinned_mesh->draw_mesh.objects) {
+            glBindVertexArray(obj.shape.vao);
+            glDrawElements(GL_TRIANGLES, 3 * obj.shape.numTriangles, GL_UNSIGNED_INT, 0);
+        }
+        glBindVertexArray(0);
+    }
+
+    // Draws a shape's position-only stream. Expects the depth shader to be active
+    void Graphics::drawDepth(const DrawShape* drawShape, const glm::mat4& model_matrix) {
+        if (drawShape->depth_vao == 0) return;
+        active_shader_->setMat4(MODEL, model_matrix);
+        glBindVertexArray(drawShape->depth_vao);
+        glDrawElements(GL_TRIANGLES, 3 * drawShape->numTriangles, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    // Draws a box given in the model space of model_matrix. Expects the bounds shader to be active
+    void Graphics::drawBounds(const glm::vec3& min, const glm::vec3& max, const glm::mat4& model_matrix) {
+        const glm::mat4 box = glm::scale(glm::translate(model_matrix, min), max - min);
+        active_shader_->setMat4(MODEL, box);
+        glBindVertexArray(bounds_vao_);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    /**
+     * Creates the target buffers for preSkin: one static-layout vertex buffer per object of a skinned mesh,
+     * sharing its index buffers and materials. The result draws with drawMesh and the phong shader.
+     * @param skinned_draw_mesh - Draw mesh of a SkinnedMesh
+     */
+    DrawMesh Graphics::createPreSkinnedMesh(const DrawMesh& skinned_draw_mesh) {
+        DrawMesh result;
+        result.min = skinned_draw_mesh.min;
+        result.max = skinned_draw_mesh.max;
+
+        for (const auto& obj : skinned_draw_mesh.objects) {
+            DrawObject pre_skinned = obj;
+            auto& shape = pre_skinned.shape;
+            constexpr GLsizei stride = 8 * sizeof(float);
+
+            glGenVertexArrays(1, &shape.vao);
+            glBindVertexArray(shape.vao);
+
+            glGenBuffers(1, &shape.vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);
+            glBufferData(GL_ARRAY_BUFFER, obj.shape.numVertices * stride, nullptr, GL_DYNAMIC_COPY);
+
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(0));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(3 * sizeof(float)));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(6 * sizeof(float)));
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj.shape.ebo);
             glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            shape.depth_vao = shape.vao;    // The depth shader reads only the position at location 0
+
+            result.objects.push_back(pre_skinned);
         }
+        return result;
+    }
+
+    /**
+     * Skins a mesh's vertices in its current pose into a pre-skinned mesh with transform feedback.
+     * Every later pass can draw the pre-skinned mesh any number of times without skinning again.
+     * Always linear blend skinning, regardless of the skinning mode.
+     * @param skinned_mesh - Posed skinned mesh to read from
+     * @param pre_skinned_mesh - Target created by createPreSkinnedMesh for this mesh
+     */
+    void Graphics::preSkin(SkinnedMesh* skinned_mesh, const DrawMesh& pre_skinned_mesh) {
+        auto* previous_shader = active_shader_;
+        skinning_feedback_.use();
+        active_shader_ = &skinning_feedback_;
+        setBonePalette(skinned_mesh->skeleton, LINEAR_BLEND);
+
+        const auto& objects = skinned_mesh->draw_mesh.objects;
+        glEnable(GL_RASTERIZER_DISCARD);
+        for (size_t i = 0; i < objects.size() && i < pre_skinned_mesh.objects.size(); i++) {
+            glBindVertexArray(objects[i].shape.vao);
+            glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, pre_skinned_mesh.objects[i].shape.vbo);
+            glBeginTransformFeedback(GL_POINTS);
+            glDrawArrays(GL_POINTS, 0, objects[i].shape.numVertices);
+            glEndTransformFeedback();
+        }
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glBindVertexArray(0);
+        glDisable(GL_RASTERIZER_DISCARD);
 
+        Profiler::count("Pre-skinned meshes", 1);
+        previous_shader->use();
+        active_shader_ = previous_shader;
     }
 
-    void Graphics::drawSkinned(SkinnedMesh* skinned_mesh, const Transform& transform) {
-        const auto model_matrix = transform.getModelMatrix();
-        active_shader_->setMat4("model", model_matrix);
-        active_shader_->setMat3("normal", glm::transpose(glm::inverse(glm::mat3(model_matrix))));
+    /**
+     * Deletes the buffers created by createPreSkinnedMesh. The shared index buffers are left alone.
+     */
+    void Graphics::deletePreSkinnedMesh(DrawMesh& pre_skinned_mesh) {
+        for (auto& obj : pre_skinned_mesh.objects) {
+            glDeleteVertexArrays(1, &obj.shape.vao);
+            glDeleteBuffers(1, &obj.shape.vbo);
+        }
+        pre_skinned_mesh.objects.clear();
+    }
 
+    /**
+     * Uploads a skeleton's current palette to the active skinned shader, as uniforms or through the
+     * bone texture buffer when it exceeds MAX_UNIFORM_BONES, binding the variant that reads it from there.
+     * @param skeleton - Skeleton whose pose to upload
+     * @param mode - Whether the shader expects matrices or dual quaternions
+     */
+    void Graphics::setBonePalette(Skeleton& skeleton, const SkinningMode mode) {
+        const bool use_bone_buffer = skeleton.palette_size_ > MAX_UNIFORM_BONES;
+        active_shader_->setSkinningFlag(VARIANT_BONE_BUFFER, use_bone_buffer);
+        if (use_bone_buffer) active_shader_->setInt(BONE_BUFFER, TEXTURE_UNIT_INSTANCE_DATA);
+        size_t uploaded_bytes = 0;
+
+        if (mode == DUAL_QUATERNION) {
+            const auto& dual_quaternions = skeleton.getDualQuaternions();
+            if (use_bone_buffer) {
+                uploadBoneBuffer(dual_quaternions);
+            } else if (!dual_quaternions.empty()) {
+                active_shader_->setVec4Vec(BONE_DQ, dual_quaternions.size(), dual_quaternions);
+            }
+            uploaded_bytes = dual_quaternions.size() * sizeof(glm::vec4);
+        } else {
+            skeleton.updateBoneMatrices();
+            if (use_bone_buffer) {
+                bone_staging_.resize(3 * skeleton.bone_matrices_.size());
+                for (size_t i = 0; i < skeleton.bone_matrices_.size(); i++) {
+                    const auto& m = skeleton.bone_matrices_[i];
+                    for (int row = 0; row < 3; row++) {
+                        bone_staging_[3 * i + row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+                    }
+                }
+                uploadBoneBuffer(bone_staging_);
+                uploaded_bytes = bone_staging_.size() * sizeof(glm::vec4);
+            } else if (skeleton.palette_size_ > 0) {
+                active_shader_->setMat4Vec(BONES, skeleton.palette_size_, skeleton.bone_matrices_);
+                uploaded_bytes = skeleton.palette_size_ * sizeof(glm::mat4);
+            }
+        }
+        Profiler::count("Palette bytes uploaded", uploaded_bytes);
 
-        const auto& draw_mesh = skinned_mesh->draw_mesh;
-        auto& skeleton = skinned_mesh->skeleton;
+        if (use_bone_buffer) {
+            glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_INSTANCE_DATA);
+            glBindTexture(GL_TEXTURE_BUFFER, bone_texture_);
+        }
+    }
+
+    /**
+     * Draws the crowd instances animated on the CPU with one instanced call per submesh and texture
+     * buffer batch. Expects the skinned instanced shader to be active and the crowd to be uploaded.
+     */
+    void Graphics::drawCrowd(const SkinnedCrowd* crowd) {
+        active_shader_->setInt(INSTANCE_STRIDE, crowd->getInstanceStride());
+        active_shader_->setInt(INSTANCE_DATA, TEXTURE_UNIT_INSTANCE_DATA);
+        drawInstanceBatches(crowd->getAsset().draw_mesh, crowd->getBatches());
+    }
+
+    /**
+     * Draws the crowd instances beyond the baked distance, posed from the crowd's animation texture.
+     * Expects the skinned baked shader to be active and the crowd to be uploaded.
+     */
+    void Graphics::drawCrowdBaked(const SkinnedCrowd* crowd) {
+        const auto* animation_texture = crowd->getAnimationTexture();
+        if (!animation_texture || animation_texture->texture == 0) return;
+
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_ANIMATION);
+        glBindTexture(GL_TEXTURE_2D, animation_texture->texture);
+        active_shader_->setInt(ANIMATION_TEXTURE, TEXTURE_UNIT_ANIMATION);
+        active_shader_->setVec4Vec(BAKED_CLIPS, animation_texture->clips.size(), animation_texture->clips);
+        active_shader_->setInt(INSTANCE_DATA, TEXTURE_UNIT_INSTANCE_DATA);
+        drawInstanceBatches(crowd->getAsset().draw_mesh, crowd->getBakedBatches());
+    }
 
-        skeleton.updateBoneMatrices();
-        active_shader_->setMat4Vec("gBones", skeleton.num_bones_, skeleton.bone_matrices_);
+    void Graphics::drawInstanceBatches(const DrawMesh& draw_mesh, const std::vector<InstanceBatch>& batches) {
         for (const auto& obj : draw_mesh.objects) {
             setMaterialUniforms(obj.material);
             glBindVertexArray(obj.shape.vao);
-            glDrawElements(GL_TRIANGLES, 3 * obj.shape.numTriangles, GL_UNSIGNED_INT, 0);
+            for (const auto& batch : batches) {
+                if (batch.num_instances == 0) continue;
+                glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_INSTANCE_DATA);
+                glBindTexture(GL_TEXTURE_BUFFER, batch.texture);
+                glDrawElementsInstanced(GL_TRIANGLES, 3 * obj.shape.numTriangles, GL_UNSIGNED_INT, 0, batch.num_instances);
+            }
             glBindVertexArray(0);
         }
+    }
+
+    // Copies a palette, already laid out as texels, into the shared bone texture buffer
+    void Graphics::uploadBoneBuffer(const std::vector<glm::vec4>& texels) {
+        if (bone_buffer_ == 0) {
+            glGenBuffers(1, &bone_buffer_);
+            glGenTextures(1, &bone_texture_);
+            glBindBuffer(GL_TEXTURE_BUFFER, bone_buffer_);
+            glBindTexture(GL_TEXTURE_BUFFER, bone_texture_);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bone_buffer_);
+        }
 
+        const GLsizeiptr bytes = texels.size() * sizeof(glm::vec4);
+        glBindBuffer(GL_TEXTURE_BUFFER, bone_buffer_);
+        glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, texels.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
     }
 
     void Graphics::addShape(const char* name, const DrawShape& shape) {
@@ -109,60 +421,277 @@ namespace gl {
     }
 
 
+    /**
+     * Depth-tested but invisible: color and depth writes and face culling are off, so boxes cut by the near
+     * plane still rasterize their back faces. Those may lie behind the object itself, so callers should not
+     * query boxes around the camera. Callers restore the color and depth masks when done.
+     */
+    void Graphics::useBoundsShader() {
+        bounds_.use();
+        active_shader_ = &bounds_;
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+    }
+
+    /**
+     * Writes depth only, with the same rasterization state as usePhongShader so that a following
+     * shading pass can use setDepthEqual(true).
+     */
+    void Graphics::useDepthShader() {
+        depth_.use();
+        active_shader_ = &depth_;
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.0, 1.0);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+
+    // Deferred geometry pass: same vertex stage and material uniforms as usePhongShader, writes a GBuffer
+    void Graphics::useGBufferShader() {
+        gbuffer_.use();
+        active_shader_ = &gbuffer_;
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.0, 1.0);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+
+    // Depth only into a shadow map; more slope bias than the camera passes, since texels are much larger
+    void Graphics::useShadowCasterShader() {
+        depth_.use();
+        active_shader_ = &depth_;
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0, 4.0);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+
+    // Linear blend skinning only, like preSkin, whatever the skinning mode
+    void Graphics::useSkinnedShadowCasterShader() {
+        useShadowCasterShader();
+        skinned_depth_.use();
+        active_shader_ = &skinned_depth_;
+    }
+
+    // Takes setCameraUniforms, setLight and setLightClusters like the phong shader
+    void Graphics::useDeferredLightingShader() {
+        deferred_lighting_.use();
+        active_shader_ = &deferred_lighting_;
+        glDisable(GL_BLEND);
+    }
+
+    /**
+     * Lights the G-buffer into the bound framebuffer with one fullscreen triangle, writing its depth too.
+     * Background pixels are left as they are. Expects the deferred lighting shader to be active.
+     */
+    void Graphics::drawDeferredLighting(const FrameGraph& graph, const GBuffer& g_buffer, const Camera* camera) {
+        active_shader_->setMat4("inverse_view_projection",
+            glm::inverse(camera->getProjection() * camera->getViewMatrix()));
+        bindTexture(graph.getTexture(g_buffer.albedo), 0, "gbuffer_albedo");
+        bindTexture(graph.getTexture(g_buffer.normal), 1, "gbuffer_normal");
+        bindTexture(graph.getTexture(g_buffer.depth), 2, "gbuffer_depth");
+
+        // Writes the G-buffer's depth through gl_FragDepth, so no copy is needed for the forward passes
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_ALWAYS);
+        glDepthMask(GL_TRUE);
+        glBindVertexArray(fullscreen_vao_);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glDepthFunc(GL_LESS);
+    }
+
+    // Blended surfaces are drawn last, back to front, and do not write depth so those behind them still draw
+    void Graphics::setBlending(const bool enabled) {
+        if (enabled) glEnable(GL_BLEND);
+        else glDisable(GL_BLEND);
+        glDepthMask(enabled ? GL_FALSE : GL_TRUE);
+    }
+
+    // Makes the phong shader's variants write weighted OIT targets instead of a color. Expects it to be active
+    void Graphics::setWeightedOit(const bool enabled) {
+        phong_.setPass(enabled ? PASS_WEIGHTED_OIT : PASS_FORWARD);
+    }
+
+    // Shades only the surfaces a depth prepass left visible, without writing depth again
+    void Graphics::setDepthEqual(const bool equal) {
+        glDepthFunc(equal ? GL_EQUAL : GL_LESS);
+        glDepthMask(equal ? GL_FALSE : GL_TRUE);
+    }
+
     void Graphics::setCameraUniforms(const Camera* camera) {
-        active_shader_->setMat4("view", camera->getViewMatrix());
-        active_shader_->setMat4("projection", camera->getProjection());
-        active_shader_->setVec3("camera_pos", camera->getPosition());
+        active_shader_->setMat4(VIEW, camera->getViewMatrix());
+        active_shader_->setMat4(PROJECTION, camera->getProjection());
+        active_shader_->setVec3(CAMERA_POS, camera->getPosition());
     }
 
     void Graphics::setLight(const Light& light) {
-        active_shader_->setVec3("light_position", light.position);
-        active_shader_->setVec3("light_color", light.color);
+        active_shader_->setVec3(LIGHT_POSITION, light.position);
+        active_shader_->setVec3(LIGHT_COLOR, light.color);
+        active_shader_->setLightingFlag(VARIANT_DIRECTIONAL_LIGHT, light.directional);
+    }
+
+    // For passes not seen from the camera, like shadow maps
+    void Graphics::setViewProjection(const glm::mat4& view, const glm::mat4& projection) {
+        active_shader_->setMat4(VIEW, view);
+        active_shader_->setMat4(PROJECTION, projection);
+    }
+
+    /**
+     * Shadows of the main light, which should be directional, for the active shader.
+     * @param shadows - nullptr turns shadows off
+     */
+    void Graphics::setShadows(const CascadedShadows* shadows) {
+        active_shader_->setLightingFlag(VARIANT_SHADOWS, shadows != nullptr);
+        if (!shadows) return;
+
+        glm::vec4 splits;
+        glm::vec4 texel_sizes;
+        for (int i = 0; i < CascadedShadows::CASCADE_COUNT; i++) {
+            active_shader_->setMat4(SHADOW_MATRICES[i], shadows->getShadowMatrix(i));
+            splits[i] = shadows->getSplit(i);
+            texel_sizes[i] = shadows->getTexelSize(i);
+        }
+        active_shader_->setVec4(CASCADE_SPLITS, splits);
+        active_shader_->setVec4(SHADOW_TEXEL_SIZES, texel_sizes);
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_SHADOW);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadows->getShadowTexture());
+    }
+
+    // Point lights of the active shader's clusters, see LightClusters
+    void Graphics::setLightClusters(const LightClusters& clusters) {
+        active_shader_->setLightingFlag(VARIANT_CLUSTERED_LIGHTS, clusters.getLightCount() > 0);
+        active_shader_->setVec2(CLUSTER_TILE_SIZE, clusters.getTileSize());
+        active_shader_->setVec2(CLUSTER_SLICES, clusters.getSliceParameters());
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_LIGHTS);
+        glBindTexture(GL_TEXTURE_BUFFER, clusters.getLightTexture());
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_LIGHT_CLUSTERS);
+        glBindTexture(GL_TEXTURE_BUFFER, clusters.getClusterTexture());
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_LIGHT_INDICES);
+        glBindTexture(GL_TEXTURE_BUFFER, clusters.getIndexTexture());
     }
 
     void Graphics::setAmbientLight(const glm::vec3& ambient) {
-        usePhongShader();
-        active_shader_->setVec3("ambient_light", ambient);
-        useSkinnedShader();
-        active_shader_->setVec3("ambient_light", ambient);
+        for (auto* shader : {&deferred_lighting_, &skinned_, &skinned_dq_, &skinned_instanced_, &skinned_baked_,
+            &phong_}) {
+            shader->use();
+            shader->setVec3("ambient_light", ambient);
+        }
+        active_shader_ = &phong_;
     }
 
-    void Graphics::initializePhongShader() {
-        const auto frag = "Resources/Shaders/phong_frag.glsl";
-        const auto phong_vert = "Resources/Shaders/phong_vert.glsl";
-        phong_ = Shaders::createShaderProgram(phong_vert,frag);//ShaderProgram(vert, frag);
+    void Graphics::setSkinningMode(const SkinningMode mode) {
+        skinning_mode_ = mode;
+    }
 
-        const auto skinned_vert = "Resources/Shaders/skinned_vert.glsl";
-        skinned_ = Shaders::createShaderProgram(skinned_vert,phong_.getFragmentID());
+    SkinningMode Graphics::getSkinningMode() {
+        return skinning_mode_;
+    }
+
+    void Graphics::initializePhongShader() {
+        // Material shaders are specialized per material, lighting and pass, and compiled as variants are needed
+        phong_ = ShaderVariants(VERTEX_STATIC, PASS_FORWARD);
+        skinned_ = ShaderVariants(VERTEX_SKINNED, PASS_FORWARD);
+        skinned_dq_ = ShaderVariants(VERTEX_SKINNED_DQ, PASS_FORWARD);
+        skinned_instanced_ = ShaderVariants(VERTEX_SKINNED_INSTANCED, PASS_FORWARD);
+        skinned_baked_ = ShaderVariants(VERTEX_SKINNED_BAKED, PASS_FORWARD);
+        gbuffer_ = ShaderVariants(VERTEX_STATIC, PASS_GBUFFER);
+        deferred_lighting_ = ShaderVariants(VERTEX_FULLSCREEN, PASS_DEFERRED_LIGHTING);
+
+        skinning_feedback_ = ShaderVariants(VERTEX_SKINNING_FEEDBACK, PASS_SKINNING_FEEDBACK);
+        skinned_depth_ = ShaderVariants(VERTEX_SKINNED, PASS_DEPTH);
+
+        glGenVertexArrays(1, &fullscreen_vao_);   // Core profile needs a VAO bound even for attribute-less draws
+
+        // Every shader lighting with phong_frag or the deferred pass gives the light buffers their own units,
+        // even with no lights, since samplers of different types may not share one. Variants compiled later
+        // get these when first bound
+        for (auto* program : {&phong_, &skinned_, &skinned_dq_, &skinned_instanced_, &skinned_baked_,
+            &deferred_lighting_}) {
+            program->use();
+            program->setInt("light_data", TEXTURE_UNIT_LIGHTS);
+            program->setInt("light_clusters", TEXTURE_UNIT_LIGHT_CLUSTERS);
+            program->setInt("light_indices", TEXTURE_UNIT_LIGHT_INDICES);
+            program->setInt("shadow_map", TEXTURE_UNIT_SHADOW);
+        }
 
         active_shader_= &phong_;
     }
 
+    void Graphics::initializeBoundsBox() {
+        const auto bounds = Shaders::createShaderProgram("Resources/Shaders/bounds_vert.glsl", "Resources/Shaders/bounds_frag.glsl");
+        bounds_ = ShaderVariants(bounds);
+        depth_ = ShaderVariants(Shaders::createShaderProgram("Resources/Shaders/depth_vert.glsl", bounds.getFragmentID()));
+        active_shader_ = &phong_;
+
+        constexpr float corners[] = {
+            0, 0, 0,  1, 0, 0,  1, 1, 0,  0, 1, 0,
+            0, 0, 1,  1, 0, 1,  1, 1, 1,  0, 1, 1
+        };
+        constexpr unsigned int indices[] = {
+            0, 2, 1,  0, 3, 2,  // -z
+            4, 5, 6,  4, 6, 7,  // +z
+            0, 1, 5,  0, 5, 4,  // -y
+            3, 6, 2,  3, 7, 6,  // +y
+            0, 4, 7,  0, 7, 3,  // -x
+            1, 2, 6,  1, 6, 5   // +x
+        };
+
+        glGenVertexArrays(1, &bounds_vao_);
+        glBindVertexArray(bounds_vao_);
+        glGenBuffers(1, &bounds_vbo_);
+        glBindBuffer(GL_ARRAY_BUFFER, bounds_vbo_);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), reinterpret_cast<void*>(0));
+        glGenBuffers(1, &bounds_ebo_);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bounds_ebo_);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Binds the variant the material picked at load first, so the uniforms below go to it
     void Graphics::setMaterialUniforms(const DrawMaterial& material) {
-        active_shader_->setVec3("ambient", material.ambient);
-        active_shader_->setVec3("diffuse", material.diffuse);
-        active_shader_->setVec3("specular", material.specular);
-        active_shader_->setFloat("shininess", material.shininess);
-        active_shader_->setFloat("opacity", material.opacity);
+        active_shader_->setMaterialKey(material.variant);
+        active_shader_->setVec3(AMBIENT, material.ambient);
+        active_shader_->setVec3(DIFFUSE, material.diffuse);
+        active_shader_->setVec3(SPECULAR, material.specular);
+        active_shader_->setFloat(SHININESS, material.shininess);
+        active_shader_->setFloat(OPACITY, material.opacity);
         bindMaterialTextures(material.textures);
     }
 
     void Graphics::bindMaterialTextures(const Textures& textures) {
-        active_shader_->setInt("texture_flags", textures.flags);
-
         if (textures.ambient != 0) {
-            bindTexture(textures.ambient, 0, "texture_ambient");
+            bindTexture(textures.ambient, 0, TEXTURE_AMBIENT);
         }
         if (textures.diffuse != 0) {
-            bindTexture(textures.diffuse, 1, "texture_diffuse");
+            bindTexture(textures.diffuse, 1, TEXTURE_DIFFUSE);
         }
         if (textures.specular != 0) {
-            bindTexture(textures.specular, 2, "texture_specular");
+            bindTexture(textures.specular, 2, TEXTURE_SPECULAR);
         }
 
     }
 
-    void Graphics::bindTexture(const GLuint texture, const int unit, const char* uniform_name) {
+    void Graphics::bindTexture(const GLuint texture, const int unit, const UniformName& uniform_name) {
         glActiveTexture(GL_TEXTURE0 + unit);
         glBindTexture(GL_TEXTURE_2D, texture);
         active_shader_->setInt(uniform_name, unit); // sampler2D bound by binding the texture unit to the uniform
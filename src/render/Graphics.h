@@ -5,14 +5,21 @@
 
 namespace gl {
     struct SkinnedMesh;
+    struct Skeleton;
+    class SkinnedCrowd;
+    struct InstanceBatch;
     class Camera;
-    class ShaderProgram;
+    class ShaderVariants;
+    class UniformName;
 
     struct DrawShape {
         GLuint vao = 0;
         GLuint vbo = 0; // vertex buffer id
         GLuint ebo = 0; // element buffer id (for indexed rendering)
+        GLuint depth_vao = 0;    // position-only stream for the depth prepass, sharing ebo
+        GLuint position_vbo = 0;
         size_t numTriangles = 0;
+        size_t numVertices = 0;
         glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
         glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
     };
@@ -25,12 +32,24 @@ namespace gl {
 
     struct DrawMesh {
         std::vector<DrawObject> objects;
-        glm::vec3 min, max;
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
     };
 
+    enum SkinningMode {
+        LINEAR_BLEND,       // Blends four bone matrices per vertex, 64 bytes per bone uploaded
+        DUAL_QUATERNION     // Blends four dual quaternions per vertex, 32 bytes per bone uploaded, no bone scale
+    };
+
+    class LightClusters;
+    struct GBuffer;
+    class FrameGraph;
+    class CascadedShadows;
+
     struct Light {
         glm::vec3 position = glm::vec3(0,0,0);
         glm::vec3 color = glm::vec3(1.f,1.f,1.f);
+        bool directional = false;   // If set, position is the direction towards the light
     };
 
 
@@ -41,30 +60,83 @@ namespace gl {
 
         static void usePhongShader();
         static void useSkinnedShader();
+        static void useSkinnedInstancedShader();
+        static void useSkinnedBakedShader();
+        static void useBoundsShader();
+        static void useDepthShader();
+        static void useGBufferShader();
+        static void useShadowCasterShader();
+        static void useSkinnedShadowCasterShader();
+        static void useDeferredLightingShader();
+        static void setDepthEqual(bool equal);
+        static void setBlending(bool enabled);
+        static void setWeightedOit(bool enabled);
         static void setCameraUniforms(const Camera* camera);
         static void setLight(const Light& light);
+        static void setLightClusters(const LightClusters& clusters);
+        static void setShadows(const CascadedShadows* shadows);
+        static void setViewProjection(const glm::mat4& view, const glm::mat4& projection);
         static void setAmbientLight(const glm::vec3& ambient);
+        static void setSkinningMode(SkinningMode mode);
+        static SkinningMode getSkinningMode();
 
 
         static void drawObject(const DrawShape* drawShape, const Transform& transform, const DrawMaterial& material = defaultMaterial);
+        static void drawObject(const DrawShape* drawShape, const glm::mat4& model_matrix, const glm::mat3& normal_matrix,
+            const DrawMaterial& material = defaultMaterial);
         static void drawMesh(const DrawMesh* draw_mesh, const Transform& transform);
         static void drawSkinned(SkinnedMesh* skinned_mesh, const Transform& transform);
+        static void drawCrowd(const SkinnedCrowd* crowd);
+        static void drawDeferredLighting(const FrameGraph& graph, const GBuffer& g_buffer, const Camera* camera);
+        static void drawSkinnedDepth(SkinnedMesh* skinned_mesh, const Transform& transform);
+        static void drawDepth(const DrawShape* drawShape, const glm::mat4& model_matrix);
+        static void drawBounds(const glm::vec3& min, const glm::vec3& max, const glm::mat4& model_matrix);
+        static DrawMesh createPreSkinnedMesh(const DrawMesh& skinned_draw_mesh);
+        static void preSkin(SkinnedMesh* skinned_mesh, const DrawMesh& pre_skinned_mesh);
+        static void deletePreSkinnedMesh(DrawMesh& pre_skinned_mesh);
+        static void drawCrowdBaked(const SkinnedCrowd* crowd);
 
         static void addShape(const char* name, const DrawShape& shape);
         static const DrawShape* getShape(const std::string& shape_name);
 
     private:
         static void initializePhongShader();
+        static void initializeBoundsBox();
         static void setMaterialUniforms(const DrawMaterial& material);
         static void bindMaterialTextures(const Textures& textures);
-        static void bindTexture(GLuint texture, int unit, const char* uniform_name);
+        static void bindTexture(GLuint texture, int unit, const UniformName& uniform_name);
+        static void drawInstanceBatches(const DrawMesh& draw_mesh, const std::vector<InstanceBatch>& batches);
+        static void uploadBoneBuffer(const std::vector<glm::vec4>& texels);
+        static void setBonePalette(Skeleton& skeleton, SkinningMode mode);
+        static void drawMeshObjects(const DrawMesh& draw_mesh);
 
 
         static std::unordered_map<std::string, DrawShape> shapes_;
 
-        static ShaderProgram* active_shader_;
-        static ShaderProgram phong_;
-        static ShaderProgram skinned_;
+        static ShaderVariants* active_shader_;
+        static ShaderVariants phong_;
+        static ShaderVariants skinned_;
+        static ShaderVariants skinned_dq_;
+        static SkinningMode skinning_mode_;
+        static ShaderVariants skinned_instanced_;
+        static ShaderVariants skinned_baked_;
+        static ShaderVariants skinning_feedback_;
+        static ShaderVariants bounds_;
+        static ShaderVariants depth_;
+        static ShaderVariants gbuffer_;
+        static ShaderVariants skinned_depth_;
+        static ShaderVariants deferred_lighting_;
+        static GLuint fullscreen_vao_;
+
+        // Unit cube from (0,0,0) to (1,1,1) for drawBounds
+        static GLuint bounds_vao_;
+        static GLuint bounds_vbo_;
+        static GLuint bounds_ebo_;
+
+        // Texture buffer palette for skeletons over MAX_UNIFORM_BONES
+        static GLuint bone_buffer_;
+        static GLuint bone_texture_;
+        static std::vector<glm::vec4> bone_staging_;
 
     };
 }
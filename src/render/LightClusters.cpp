@@ -0,0 +1,176 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "Camera.h"
+#include "../Debug.h"
+#include "../JobSystem.h"
+#include "../Simd.h"
+
+namespace gl {
+
+    /**
+     * Rebuilds the cluster light lists for this frame's camera and uploads them.
+     * @param lights - World-space lights; those past MAX_LIGHTS are ignored
+     * @param viewport_width, viewport_height - Size in pixels of the framebuffer the lights are shaded into
+     */
+    void LightClusters::update(const std::vector<PointLight>& lights, const Camera& camera, const int viewport_width,
+        const int viewport_height) {
+        if (lights.size() > MAX_LIGHTS) {
+            debug::error("LightClusters: " + std::to_string(lights.size()) + " lights, only the first "
+                + std::to_string(MAX_LIGHTS) + " are used");
+        }
+        light_count_ = static_cast<int>(std::min(lights.size(), MAX_LIGHTS));
+
+        const glm::mat4 view = camera.getViewMatrix();
+        const glm::mat4 projection = camera.getProjection();
+        const float near = camera.getNear();
+        const float far = camera.getFar();
+        tile_size_ = glm::vec2(static_cast<float>(viewport_width) / GRID_X, static_cast<float>(viewport_height) / GRID_Y);
+        const float log_range = std::log(far / near);
+        slice_parameters_ = glm::vec2(GRID_Z / log_range, -GRID_Z * std::log(near) / log_range);
+
+        // Padding lanes get radius 0, which no squared distance is below
+        const size_t padded = simd::padToWidth(light_count_);
+        view_x_.assign(padded, 0.0f);
+        view_y_.assign(padded, 0.0f);
+        view_z_.assign(padded, 0.0f);
+        radius_.assign(padded, 0.0f);
+        light_data_.resize(2 * light_count_);
+        for (int i = 0; i < light_count_; i++) {
+            const auto& light = lights[i];
+            const glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            view_x_[i] = position.x;
+            view_y_[i] = position.y;
+            view_z_[i] = position.z;
+            radius_[i] = light.radius;
+            light_data_[2 * i] = glm::vec4(light.position, light.radius);
+            light_data_[2 * i + 1] = glm::vec4(light.color, 0.0f);
+        }
+
+        clusters_.resize(2 * CLUSTER_COUNT);
+        if (light_count_ > 0) {
+            const auto counter = JobSystem::dispatch(GRID_Z, 1, [&](const size_t begin, const size_t end) {
+                for (size_t slice = begin; slice < end; slice++) {
+                    binSlice(static_cast<int>(slice), projection, near, far);
+                }
+            });
+            JobSystem::wait(counter);
+        } else {
+            std::fill(clusters_.begin(), clusters_.end(), 0u);
+            for (auto& slice : slice_indices_) slice.clear();
+        }
+
+        // Concatenate the slices' lists and make their offsets absolute
+        indices_.clear();
+        for (int slice = 0; slice < GRID_Z; slice++) {
+            const auto base = static_cast<uint32_t>(indices_.size());
+            for (int cluster = slice * GRID_X * GRID_Y; cluster < (slice + 1) * GRID_X * GRID_Y; cluster++) {
+                clusters_[2 * cluster] += base;
+            }
+            indices_.insert(indices_.end(), slice_indices_[slice].begin(), slice_indices_[slice].end());
+        }
+
+        if (buffers_[0] == 0) {
+            glGenBuffers(3, buffers_);
+            glGenTextures(3, textures_);
+        }
+        upload(0, light_data_.data(), light_data_.size() * sizeof(glm::vec4));
+        upload(1, clusters_.data(), clusters_.size() * sizeof(uint32_t));
+        upload(2, indices_.data(), indices_.size() * sizeof(uint16_t));
+        constexpr GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+        for (int i = 0; i < 3; i++) {
+            glBindTexture(GL_TEXTURE_BUFFER, textures_[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers_[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Orphans the buffer's previous storage so the upload never waits on draws still reading it
+    void LightClusters::upload(const int buffer, const void* data, const size_t bytes) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers_[buffer]);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(bytes, 16), nullptr, GL_STREAM_DRAW);
+        if (bytes > 0) {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    /**
+     * Fills the light lists of one depth slice. Lights are first narrowed to those overlapping the slice's depth
+     * range, then each cluster tests its view-space box against the remaining spheres.
+     */
+    void LightClusters::binSlice(const int slice, const glm::mat4& projection, const float near, const float far) {
+        const float depth_near = near * std::pow(far / near, static_cast<float>(slice) / GRID_Z);
+        const float depth_far = near * std::pow(far / near, static_cast<float>(slice + 1) / GRID_Z);
+
+        thread_local std::vector<float> xs, ys, zs, radii;
+        thread_local std::vector<uint16_t> ids;
+        xs.clear();
+        ys.clear();
+        zs.clear();
+        radii.clear();
+        ids.clear();
+        for (int i = 0; i < light_count_; i++) {
+            const float depth = -view_z_[i];
+            if (depth + radius_[i] > depth_near && depth - radius_[i] < depth_far) {
+                xs.push_back(view_x_[i]);
+                ys.push_back(view_y_[i]);
+                zs.push_back(view_z_[i]);
+                radii.push_back(radius_[i] * radius_[i]);
+                ids.push_back(static_cast<uint16_t>(i));
+            }
+        }
+        const size_t candidates = ids.size();
+        const size_t padded = simd::padToWidth(static_cast<unsigned int>(candidates));
+        xs.resize(padded, 0.0f);
+        ys.resize(padded, 0.0f);
+        zs.resize(padded, 0.0f);
+        radii.resize(padded, 0.0f);
+
+        auto& slice_indices = slice_indices_[slice];
+        slice_indices.clear();
+        using simd::f32xN;
+        const f32xN zero = f32xN::set1(0.0f);
+        const f32xN min_z = f32xN::set1(-depth_far);
+        const f32xN max_z = f32xN::set1(-depth_near);
+
+        for (int y = 0; y < GRID_Y; y++) {
+            // View-space extent of the tile is the NDC extent scaled by depth over the projection's focal length
+            const float ndc_y0 = 2.0f * y / GRID_Y - 1.0f;
+            const float ndc_y1 = 2.0f * (y + 1) / GRID_Y - 1.0f;
+            const float cluster_min_y = std::min(ndc_y0 * depth_near, ndc_y0 * depth_far) / projection[1][1];
+            const float cluster_max_y = std::max(ndc_y1 * depth_near, ndc_y1 * depth_far) / projection[1][1];
+            const f32xN min_y = f32xN::set1(cluster_min_y);
+            const f32xN max_y = f32xN::set1(cluster_max_y);
+
+            for (int x = 0; x < GRID_X; x++) {
+                const float ndc_x0 = 2.0f * x / GRID_X - 1.0f;
+                const float ndc_x1 = 2.0f * (x + 1) / GRID_X - 1.0f;
+                const f32xN min_x = f32xN::set1(std::min(ndc_x0 * depth_near, ndc_x0 * depth_far) / projection[0][0]);
+                const f32xN max_x = f32xN::set1(std::max(ndc_x1 * depth_near, ndc_x1 * depth_far) / projection[0][0]);
+
+                const auto offset = static_cast<uint32_t>(slice_indices.size());
+                for (size_t i = 0; i < candidates; i += simd::WIDTH) {
+                    const f32xN lx = f32xN::load(&xs[i]);
+                    const f32xN ly = f32xN::load(&ys[i]);
+                    const f32xN lz = f32xN::load(&zs[i]);
+                    const f32xN dx = max(max(min_x - lx, lx - max_x), zero);
+                    const f32xN dy = max(max(min_y - ly, ly - max_y), zero);
+                    const f32xN dz = max(max(min_z - lz, lz - max_z), zero);
+                    int hits = bits(dx * dx + dy * dy + dz * dz < f32xN::load(&radii[i]));
+                    while (hits) {
+                        const int lane = std::countr_zero(static_cast<unsigned int>(hits));
+                        slice_indices.push_back(ids[i + lane]);
+                        hits &= hits - 1;
+                    }
+                }
+                const int cluster = (slice * GRID_Y + y) * GRID_X + x;
+                clusters_[2 * cluster] = offset;
+                clusters_[2 * cluster + 1] = static_cast<uint32_t>(slice_indices.size()) - offset;
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "GL/glew.h"
+
+namespace gl {
+    class Camera;
+
+    struct PointLight {
+        glm::vec3 position = glm::vec3(0.0f);
+        float radius = 1.0f;    // Contribution falls smoothly to zero here
+        glm::vec3 color = glm::vec3(1.0f);
+    };
+
+    /**
+     * Clustered forward lighting. The view frustum is split into a GRID_X x GRID_Y x GRID_Z froxel grid, screen
+     * tiles by exponentially spaced depth slices, and every frame each cluster gets the list of point lights whose
+     * sphere touches its view-space bounds. Slices are binned in parallel, testing lights against clusters a SIMD
+     * register at a time. The fragment shader finds its cluster from gl_FragCoord and view depth, and only loops
+     * over that cluster's lights.
+     * GPU data is three texture buffers: two RGBA32F texels per light (position and radius, color), an RG32UI
+     * (offset, count) texel per cluster, and the R16UI light index list they point into.
+     */
+    class LightClusters {
+    public:
+        static constexpr int GRID_X = 16;
+        static constexpr int GRID_Y = 9;
+        static constexpr int GRID_Z = 24;
+        static constexpr int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+        static constexpr size_t MAX_LIGHTS = 65535;    // Indices are 16 bit
+
+        LightClusters() = default;
+        LightClusters(const LightClusters&) = delete;
+        LightClusters& operator=(const LightClusters&) = delete;
+
+        void update(const std::vector<PointLight>& lights, const Camera& camera, int viewport_width, int viewport_height);
+
+        int getLightCount() const { return light_count_; }
+        glm::vec2 getTileSize() const { return tile_size_; }
+        glm::vec2 getSliceParameters() const { return slice_parameters_; }
+        GLuint getLightTexture() const { return textures_[0]; }
+        GLuint getClusterTexture() const { return textures_[1]; }
+        GLuint getIndexTexture() const { return textures_[2]; }
+
+    private:
+        void binSlice(int slice, const glm::mat4& projection, float near, float far);
+        void upload(int buffer, const void* data, size_t bytes);
+
+        // View-space light spheres, structure of arrays padded to the SIMD width
+        std::vector<float> view_x_, view_y_, view_z_, radius_;
+        std::vector<uint16_t> slice_indices_[GRID_Z];
+        std::vector<uint32_t> clusters_;    // (offset, count) per cluster; offsets relative to the slice until merged
+        std::vector<uint16_t> indices_;
+        std::vector<glm::vec4> light_data_;
+
+        int light_count_ = 0;
+        glm::vec2 tile_size_ = glm::vec2(1.0f);
+        glm::vec2 slice_parameters_ = glm::vec2(0.0f);  // slice = log(view depth) * x + y
+        GLuint buffers_[3] = {};
+        GLuint textures_[3] = {};
+    };
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-// Material constants - keep in sync with material_constants.glsl
+// Material constants - the shaders get these as #defines generated by ShaderVariants::getDefines
 
 namespace material {
     // Texture flags (bitwise)
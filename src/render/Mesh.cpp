@@ -60,10 +60,28 @@ namespace gl {
             bmax = glm::max(bmax, v);
         }
 
+        // Position-only copy for the depth prepass, so it fetches 12 bytes per vertex instead of 32
+        std::vector<float> positions;
+        positions.reserve(3 * (buffer_data.size() / attribute_size));
+        for (size_t i = 0; i < buffer_data.size(); i += attribute_size) {
+            positions.insert(positions.end(), buffer_data.begin() + i, buffer_data.begin() + i + 3);
+        }
+        glGenVertexArrays(1, &shape.depth_vao);
+        glBindVertexArray(shape.depth_vao);
+        glGenBuffers(1, &shape.position_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, shape.position_vbo);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
         shape.vao = vao;
         shape.vbo = vbo;
         shape.ebo = ebo;
         shape.numTriangles = indices.size() / 3;
+        shape.numVertices = buffer_data.size() / attribute_size;
         shape.min = bmin;
         shape.max = bmax;
 
@@ -0,0 +1,213 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../JobSystem.h"
+#include "../Simd.h"
+
+namespace gl {
+
+    /**
+     * @param width - Depth buffer width in pixels, rounded up to a multiple of TILE_WIDTH
+     * @param height - Depth buffer height in pixels, rounded up to a multiple of TILE_HEIGHT
+     */
+    OcclusionCuller::OcclusionCuller(const int width, const int height) {
+        tiles_x_ = std::max(1, (width + TILE_WIDTH - 1) / TILE_WIDTH);
+        tiles_y_ = std::max(1, (height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+        width_ = tiles_x_ * TILE_WIDTH;
+        height_ = tiles_y_ * TILE_HEIGHT;
+        tile_bins_.resize(tiles_x_ * tiles_y_);
+        depth_.assign(width_ * height_, 1.0f);
+    }
+
+    /**
+     * Adds an occluder from indexed triangles, copied and kept on the CPU.
+     * @return Occluder id for setOccluderTransform
+     */
+    int OcclusionCuller::addOccluder(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+        const glm::mat4& model_matrix) {
+        occluders_.push_back({vertices, indices, model_matrix});
+        return static_cast<int>(occluders_.size()) - 1;
+    }
+
+    void OcclusionCuller::setOccluderTransform(const int occluder, const glm::mat4& model_matrix) {
+        occluders_[occluder].model_matrix = model_matrix;
+    }
+
+    /**
+     * Rebuilds the depth buffer for a camera. Runs the tiles on the job system and returns once all are done.
+     */
+    void OcclusionCuller::render(const glm::mat4& view_projection) {
+        view_projection_ = view_projection;
+        setupTriangles();
+
+        const auto counter = JobSystem::dispatch(tile_bins_.size(), 1, [this](const size_t begin, const size_t end) {
+            for (size_t tile = begin; tile < end; tile++) {
+                rasterizeTile(tile);
+            }
+        });
+        JobSystem::wait(counter);
+    }
+
+    // Projects the occluders, builds edge and depth planes and bins each triangle into the tiles it overlaps
+    void OcclusionCuller::setupTriangles() {
+        triangles_.clear();
+        for (auto& bin : tile_bins_) {
+            bin.clear();
+        }
+
+        const float half_width = 0.5f * width_;
+        const float half_height = 0.5f * height_;
+        for (const auto& occluder : occluders_) {
+            const glm::mat4 mvp = view_projection_ * occluder.model_matrix;
+            clip_positions_.resize(occluder.vertices.size());
+            for (size_t v = 0; v < occluder.vertices.size(); v++) {
+                clip_positions_[v] = mvp * glm::vec4(occluder.vertices[v], 1.0f);
+            }
+
+            for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+                float x[3], y[3], z[3];
+                bool clipped = false;
+                for (int k = 0; k < 3; k++) {
+                    const glm::vec4& clip = clip_positions_[occluder.indices[i + k]];
+                    // The GPU clips geometry in front of the near plane, so it must not occlude here either
+                    if (clip.w <= 0.0f || clip.z < -clip.w) {
+                        clipped = true;
+                        break;
+                    }
+                    x[k] = (clip.x / clip.w + 1.0f) * half_width;
+                    y[k] = (clip.y / clip.w + 1.0f) * half_height;
+                    z[k] = clip.z / clip.w;
+                }
+                if (clipped) continue;
+
+                float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+                if (std::abs(area) < 1e-6f) continue;
+                if (area < 0.0f) {
+                    // Occluders are two-sided; flip clockwise triangles so inside is always positive
+                    std::swap(x[1], x[2]);
+                    std::swap(y[1], y[2]);
+                    std::swap(z[1], z[2]);
+                    area = -area;
+                }
+
+                ScreenTriangle triangle;
+                triangle.min_x = std::max(0, static_cast<int>(std::floor(std::min({x[0], x[1], x[2]}))));
+                triangle.max_x = std::min(width_ - 1, static_cast<int>(std::ceil(std::max({x[0], x[1], x[2]}))));
+                triangle.min_y = std::max(0, static_cast<int>(std::floor(std::min({y[0], y[1], y[2]}))));
+                triangle.max_y = std::min(height_ - 1, static_cast<int>(std::ceil(std::max({y[0], y[1], y[2]}))));
+                if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) continue;
+
+                // Edge k runs from vertex k to vertex k + 1 and is positive on the triangle's side
+                for (int k = 0; k < 3; k++) {
+                    const int next = (k + 1) % 3;
+                    triangle.edge_a[k] = y[k] - y[next];
+                    triangle.edge_b[k] = x[next] - x[k];
+                    triangle.edge_c[k] = x[k] * y[next] - x[next] * y[k];
+                }
+                // Each vertex's barycentric weight is the edge opposite it over the area
+                const float inverse_area = 1.0f / area;
+                const float w0 = z[0] * inverse_area, w1 = z[1] * inverse_area, w2 = z[2] * inverse_area;
+                triangle.depth_a = triangle.edge_a[1] * w0 + triangle.edge_a[2] * w1 + triangle.edge_a[0] * w2;
+                triangle.depth_b = triangle.edge_b[1] * w0 + triangle.edge_b[2] * w1 + triangle.edge_b[0] * w2;
+                triangle.depth_c = triangle.edge_c[1] * w0 + triangle.edge_c[2] * w1 + triangle.edge_c[0] * w2;
+
+                const auto index = static_cast<unsigned int>(triangles_.size());
+                triangles_.push_back(triangle);
+                for (int ty = triangle.min_y / TILE_HEIGHT; ty <= triangle.max_y / TILE_HEIGHT; ty++) {
+                    for (int tx = triangle.min_x / TILE_WIDTH; tx <= triangle.max_x / TILE_WIDTH; tx++) {
+                        tile_bins_[ty * tiles_x_ + tx].push_back(index);
+                    }
+                }
+            }
+        }
+    }
+
+    // Clears one tile and rasterizes its triangles, simd::WIDTH pixel centers at a time
+    void OcclusionCuller::rasterizeTile(const size_t tile) {
+        using V = simd::f32xN;
+        const int tile_x = static_cast<int>(tile % tiles_x_) * TILE_WIDTH;
+        const int tile_y = static_cast<int>(tile / tiles_x_) * TILE_HEIGHT;
+
+        for (int row = tile_y; row < tile_y + TILE_HEIGHT; row++) {
+            std::fill_n(depth_.begin() + row * width_ + tile_x, TILE_WIDTH, 1.0f);
+        }
+
+        float lane_offsets[V::width];
+        for (int lane = 0; lane < V::width; lane++) {
+            lane_offsets[lane] = lane + 0.5f;
+        }
+        const V lanes = V::load(lane_offsets);
+        const V zero = V::set1(0.0f);
+
+        for (const auto index : tile_bins_[tile]) {
+            const ScreenTriangle& t = triangles_[index];
+            const int min_y = std::max(tile_y, t.min_y);
+            const int max_y = std::min(tile_y + TILE_HEIGHT - 1, t.max_y);
+            const int min_x = std::max(tile_x, t.min_x - t.min_x % V::width);
+            const int max_x = std::min(tile_x + TILE_WIDTH - 1, t.max_x);
+
+            const V a0 = V::set1(t.edge_a[0]), a1 = V::set1(t.edge_a[1]), a2 = V::set1(t.edge_a[2]);
+            const V depth_a = V::set1(t.depth_a);
+
+            for (int y = min_y; y <= max_y; y++) {
+                const float center_y = y + 0.5f;
+                const V row0 = V::set1(t.edge_b[0] * center_y + t.edge_c[0]);
+                const V row1 = V::set1(t.edge_b[1] * center_y + t.edge_c[1]);
+                const V row2 = V::set1(t.edge_b[2] * center_y + t.edge_c[2]);
+                const V row_depth = V::set1(t.depth_b * center_y + t.depth_c);
+                float* depth_row = depth_.data() + y * width_;
+
+                for (int x = min_x; x <= max_x; x += V::width) {
+                    const V center_x = V::set1(static_cast<float>(x)) + lanes;
+                    const V e0 = a0 * center_x + row0;
+                    const V e1 = a1 * center_x + row1;
+                    const V e2 = a2 * center_x + row2;
+                    const V depth = depth_a * center_x + row_depth;
+
+                    const V current = V::load(depth_row + x);
+                    const V outside = min(e0, min(e1, e2));
+                    select(outside < zero, current, min(current, depth)).store(depth_row + x);
+                }
+            }
+        }
+    }
+
+    /**
+     * Tests a world-space box against the depth buffer from the last render().
+     * Boxes crossing the near plane are always visible.
+     */
+    bool OcclusionCuller::isVisible(const AABB& world_bounds) const {
+        float min_x = std::numeric_limits<float>::max(), max_x = std::numeric_limits<float>::lowest();
+        float min_y = min_x, max_y = max_x;
+        float nearest = 1.0f;
+        for (int corner = 0; corner < 8; corner++) {
+            const glm::vec3 p((corner & 1) ? world_bounds.max.x : world_bounds.min.x,
+                              (corner & 2) ? world_bounds.max.y : world_bounds.min.y,
+                              (corner & 4) ? world_bounds.max.z : world_bounds.min.z);
+            const glm::vec4 clip = view_projection_ * glm::vec4(p, 1.0f);
+            if (clip.w <= 0.0f || clip.z < -clip.w) return true;
+
+            const float x = (clip.x / clip.w + 1.0f) * 0.5f * width_;
+            const float y = (clip.y / clip.w + 1.0f) * 0.5f * height_;
+            min_x = std::min(min_x, x); max_x = std::max(max_x, x);
+            min_y = std::min(min_y, y); max_y = std::max(max_y, y);
+            nearest = std::min(nearest, clip.z / clip.w);
+        }
+
+        const int x0 = std::max(0, static_cast<int>(std::floor(min_x)));
+        const int x1 = std::min(width_ - 1, static_cast<int>(std::floor(max_x)));
+        const int y0 = std::max(0, static_cast<int>(std::floor(min_y)));
+        const int y1 = std::min(height_ - 1, static_cast<int>(std::floor(max_y)));
+        if (x0 > x1 || y0 > y1) return false;   // Off screen
+
+        for (int y = y0; y <= y1; y++) {
+            const float* depth_row = depth_.data() + y * width_;
+            for (int x = x0; x <= x1; x++) {
+                if (depth_row[x] >= nearest) return true;
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+
+#include "Bounds.h"
+#include "glm/glm.hpp"
+
+namespace gl {
+
+    /**
+     * CPU occlusion culling against a small set of occluder meshes.
+     * render() rasterizes the occluders into a low-resolution depth buffer (NDC depth, nearest kept), one job
+     * per screen tile with simd::WIDTH pixels per step. isVisible() then rejects boxes whose screen rectangle
+     * lies entirely behind that depth. Occluders should be simple, closed and inside what they stand for.
+     */
+    class OcclusionCuller {
+    public:
+        static constexpr int TILE_WIDTH = 32;   // Multiple of simd::WIDTH
+        static constexpr int TILE_HEIGHT = 16;
+
+        explicit OcclusionCuller(int width = 256, int height = 128);
+
+        int addOccluder(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+            const glm::mat4& model_matrix = glm::mat4(1.0f));
+        void setOccluderTransform(int occluder, const glm::mat4& model_matrix);
+
+        void render(const glm::mat4& view_projection);
+        bool isVisible(const AABB& world_bounds) const;
+
+        int getWidth() const { return width_; }
+        int getHeight() const { return height_; }
+        const std::vector<float>& getDepth() const { return depth_; }
+        size_t getTriangleCount() const { return triangles_.size(); }
+
+    private:
+        struct OccluderMesh {
+            std::vector<glm::vec3> vertices;
+            std::vector<unsigned int> indices;
+            glm::mat4 model_matrix;
+        };
+
+        // Edge functions and depth as planes over pixel centers: value = a * x + b * y + c
+        struct ScreenTriangle {
+            float edge_a[3], edge_b[3], edge_c[3];
+            float depth_a, depth_b, depth_c;
+            int min_x, max_x, min_y, max_y;
+        };
+
+        void setupTriangles();
+        void rasterizeTile(size_t tile);
+
+        int width_;
+        int height_;
+        int tiles_x_;
+        int tiles_y_;
+        glm::mat4 view_projection_ = glm::mat4(1.0f);
+
+        std::vector<OccluderMesh> occluders_;
+        std::vector<ScreenTriangle> triangles_;
+        std::vector<std::vector<unsigned int>> tile_bins_;  // Triangles overlapping each tile
+        std::vector<glm::vec4> clip_positions_;
+        std::vector<float> depth_;                          // Row-major, row 0 at the bottom of the screen
+    };
+}
@@ -0,0 +1,121 @@
+#include "OcclusionQueries.h"
+
+#include "Camera.h"
+#include "../Profiler.h"
+
+namespace gl {
+
+    /**
+     * @param min_triangles - Submeshes with fewer triangles are cheaper to draw than to query and are left alone
+     */
+    OcclusionQueries::OcclusionQueries(const size_t min_triangles) : min_triangles_(min_triangles) {
+    }
+
+    // @param camera - The camera the frame is drawn from
+    void OcclusionQueries::beginFrame(const Camera* camera) {
+        frame_++;
+        queued_.clear();
+        camera_position_ = camera->getPosition();
+        camera_near_ = camera->getNear();
+    }
+
+    // Reads a query's result if the GPU has finished it, and updates the visibility history
+    void OcclusionQueries::collectResult(QueryState& state, const int slot) {
+        if (!state.pending[slot]) return;
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(state.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return;
+
+        GLuint samples_passed = GL_FALSE;
+        glGetQueryObjectuiv(state.queries[slot], GL_QUERY_RESULT, &samples_passed);
+        state.pending[slot] = false;
+        if (samples_passed) {
+            state.visible_streak++;
+        } else {
+            state.visible_streak = 0;
+            hidden_count_++;
+        }
+    }
+
+    /**
+     * Whether the camera is inside an object's box, grown by twice the near distance to cover the near plane's
+     * corners. The box's front faces are then clipped away and its back faces lie behind the object's own far
+     * surfaces, so a query would wrongly find it hidden.
+     */
+    bool OcclusionQueries::containsCamera(const DrawShape* shape, const glm::mat4& model_matrix) const {
+        const glm::vec3 local = glm::vec3(glm::inverse(model_matrix) * glm::vec4(camera_position_, 1.0f));
+        const glm::vec3 scale(glm::length(glm::vec3(model_matrix[0])), glm::length(glm::vec3(model_matrix[1])),
+            glm::length(glm::vec3(model_matrix[2])));
+        const glm::vec3 margin = 2.0f * camera_near_ / glm::max(scale, glm::vec3(1e-6f))
+            + 0.01f * (shape->max - shape->min);
+        return glm::all(glm::greaterThanEqual(local, shape->min - margin))
+            && glm::all(glm::lessThanEqual(local, shape->max + margin));
+    }
+
+    /**
+     * Draws a heavy object with the phong shader, conditionally on last frame's query, and queues this frame's query.
+     * @param key - Identifies the object across frames, unique per drawn instance
+     */
+    void OcclusionQueries::drawObject(const uint64_t key, const DrawShape* shape, const glm::mat4& model_matrix,
+        const glm::mat3& normal_matrix, const DrawMaterial& material) {
+        auto& state = states_[key];
+        if (state.queries[0] == 0) {
+            glGenQueries(2, state.queries);
+        }
+        const int current = static_cast<int>(frame_ & 1);
+        const int previous = current ^ 1;
+        collectResult(state, previous);
+        collectResult(state, current);
+
+        if (state.visible_streak >= STAY_VISIBLE_FRAMES) {
+            state.skip_until_frame = frame_ + SKIP_FRAMES;
+            state.visible_streak = 0;
+        }
+        if (static_cast<uint64_t>(frame_) < state.skip_until_frame || containsCamera(shape, model_matrix)) {
+            Graphics::drawObject(shape, model_matrix, normal_matrix, material);
+            query_free_count_++;
+            return;
+        }
+
+        if (state.last_query_frame == frame_ - 1) {
+            glBeginConditionalRender(state.queries[previous], GL_QUERY_NO_WAIT);
+            Graphics::drawObject(shape, model_matrix, normal_matrix, material);
+            glEndConditionalRender();
+            conditional_count_++;
+        } else {
+            Graphics::drawObject(shape, model_matrix, normal_matrix, material);
+        }
+        queued_.push_back({&state, shape, model_matrix});
+    }
+
+    /**
+     * Draws the bounding box of every object queued this frame inside a query. Call once the opaque geometry
+     * is drawn so the boxes test against a complete depth buffer. Leaves the bounds shader active.
+     */
+    void OcclusionQueries::issueQueries(const Camera* camera) {
+        Profiler::count("Occlusion queries hidden", hidden_count_);
+        Profiler::count("Query-free draws", query_free_count_);
+        Profiler::count("Conditional draws", conditional_count_);
+        hidden_count_ = query_free_count_ = conditional_count_ = 0;
+        if (queued_.empty()) return;
+
+        Graphics::useBoundsShader();
+        Graphics::setCameraUniforms(camera);
+        const int current = static_cast<int>(frame_ & 1);
+        for (const auto& box : queued_) {
+            // Grown slightly so the object's own surface never hides its box
+            const glm::vec3 margin = 0.01f * (box.shape->max - box.shape->min);
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, box.state->queries[current]);
+            Graphics::drawBounds(box.shape->min - margin, box.shape->max + margin, box.model_matrix);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            box.state->pending[current] = true;
+            box.state->last_query_frame = frame_;
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+
+        Profiler::count("Occlusion queries issued", queued_.size());
+        queued_.clear();
+    }
+}
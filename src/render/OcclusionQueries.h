@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Graphics.h"
+
+namespace gl {
+
+    /**
+     * GPU occlusion culling for submeshes with many triangles.
+     * Each frame a heavy object is drawn inside a conditional render on the query its bounding box issued the
+     * previous frame (GL_QUERY_NO_WAIT, so the GPU never waits and draws when unsure), then issueQueries() draws
+     * the boxes against the finished depth buffer. Results are only read once available, so the CPU never stalls;
+     * they track how long each object has stayed visible, and objects visible for a while skip the query.
+     */
+    class OcclusionQueries {
+    public:
+        explicit OcclusionQueries(size_t min_triangles = 2000);
+        OcclusionQueries(const OcclusionQueries&) = delete;
+        OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+
+        bool isHeavy(const DrawShape& shape) const { return shape.numTriangles >= min_triangles_; }
+
+        void beginFrame(const Camera* camera);
+        void drawObject(uint64_t key, const DrawShape* shape, const glm::mat4& model_matrix, const glm::mat3& normal_matrix,
+            const DrawMaterial& material);
+        void issueQueries(const Camera* camera);
+
+    private:
+        static constexpr unsigned int STAY_VISIBLE_FRAMES = 8;  // Consecutive visible results before skipping queries
+        static constexpr unsigned int SKIP_FRAMES = 30;         // Frames drawn without a query after that
+
+        struct QueryState {
+            GLuint queries[2] = {};     // Ping-pong: one issued this frame, one from the previous frame
+            bool pending[2] = {};       // Issued and not read back yet
+            int64_t last_query_frame = -2;
+            uint64_t skip_until_frame = 0;
+            unsigned int visible_streak = 0;
+        };
+
+        struct QueuedBox {
+            QueryState* state;
+            const DrawShape* shape;
+            glm::mat4 model_matrix;
+        };
+
+        void collectResult(QueryState& state, int slot);
+        bool containsCamera(const DrawShape* shape, const glm::mat4& model_matrix) const;
+
+        size_t min_triangles_;
+        int64_t frame_ = 0;
+        std::unordered_map<uint64_t, QueryState> states_;
+        std::vector<QueuedBox> queued_;
+        glm::vec3 camera_position_ = glm::vec3(0.0f);
+        float camera_near_ = 0.0f;
+
+        // Summed over the frame and reported once by issueQueries
+        size_t hidden_count_ = 0;
+        size_t query_free_count_ = 0;
+        size_t conditional_count_ = 0;
+    };
+}
@@ -0,0 +1,63 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+#include "Camera.h"
+
+namespace gl {
+
+    void RenderQueue::clear() {
+        opaque_.clear();
+        alpha_tested_.clear();
+        blended_.clear();
+    }
+
+    void RenderQueue::submit(const DrawShape* shape, const Transform& transform, const DrawMaterial& material,
+        const uint64_t key) {
+        submit(shape, transform.getModelMatrix(), transform.getNormalMatrix(), material, key);
+    }
+
+    void RenderQueue::submit(const DrawShape* shape, const glm::mat4& model_matrix, const glm::mat3& normal_matrix,
+        const DrawMaterial& material, const uint64_t key) {
+        auto& items = material.alpha_mode == ALPHA_BLEND ? blended_
+            : material.alpha_mode == ALPHA_MASK ? alpha_tested_ : opaque_;
+        items.push_back({shape, &model_matrix, &normal_matrix, &material, key, 0.0f});
+    }
+
+    /**
+     * Orders opaque and alpha-tested items front to back and blended items back to front by the view depth of
+     * their bounds center.
+     * @param depth_sort_blended - False groups blended items by shader variant, material and shape instead, for
+     * order-independent transparency
+     */
+    void RenderQueue::sort(const Camera& camera, const bool depth_sort_blended) {
+        const glm::vec3 position = camera.getPosition();
+        const glm::vec3 look = camera.getLook();
+        for (auto* items : {&opaque_, &alpha_tested_, &blended_}) {
+            for (auto& item : *items) {
+                const glm::vec3 center = 0.5f * (item.shape->min + item.shape->max);
+                item.depth = glm::dot(glm::vec3(*item.model_matrix * glm::vec4(center, 1.0f)) - position, look);
+            }
+        }
+        const auto front_to_back = [](const RenderItem& a, const RenderItem& b) { return a.depth < b.depth; };
+        std::sort(opaque_.begin(), opaque_.end(), front_to_back);
+        std::sort(alpha_tested_.begin(), alpha_tested_.end(), front_to_back);
+        if (depth_sort_blended) {
+            std::sort(blended_.begin(), blended_.end(), [](const RenderItem& a, const RenderItem& b) {
+                return a.depth > b.depth;
+            });
+        } else {
+            std::sort(blended_.begin(), blended_.end(), [](const RenderItem& a, const RenderItem& b) {
+                if (a.material->variant != b.material->variant) return a.material->variant < b.material->variant;
+                return a.material != b.material ? a.material < b.material : a.shape < b.shape;
+            });
+        }
+    }
+
+    // Lays down the depth of every opaque item. Expects the depth shader to be active
+    void RenderQueue::drawDepthPrepass() const {
+        for (const auto& item : opaque_) {
+            Graphics::drawDepth(item.shape, *item.model_matrix);
+        }
+    }
+}
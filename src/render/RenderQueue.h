@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Graphics.h"
+
+namespace gl {
+
+    struct RenderItem {
+        const DrawShape* shape;
+        const glm::mat4* model_matrix;      // Owned by the caller, must outlive the frame
+        const glm::mat3* normal_matrix;
+        const DrawMaterial* material;
+        uint64_t key;                       // Caller's id, e.g. for occlusion queries
+        float depth;                        // View depth of the bounds center, set by sort()
+    };
+
+    /**
+     * Collects a frame's static draws by their material's alpha mode so they can be ordered before drawing.
+     * Opaque and alpha-tested items are sorted front to back so early depth testing rejects hidden fragments,
+     * and drawn first without blending. Only opaque items go into a depth prepass, since the depth shader cannot
+     * discard. Blended items are drawn last, sorted back to front unless an order-independent method
+     * (WeightedOit) resolves them, in which case they are only grouped by state.
+     */
+    class RenderQueue {
+    public:
+        void clear();
+        void submit(const DrawShape* shape, const Transform& transform, const DrawMaterial& material, uint64_t key = 0);
+        void submit(const DrawShape* shape, const glm::mat4& model_matrix, const glm::mat3& normal_matrix,
+            const DrawMaterial& material, uint64_t key = 0);
+        void sort(const Camera& camera, bool depth_sort_blended = true);
+        void drawDepthPrepass() const;
+
+        const std::vector<RenderItem>& getOpaque() const { return opaque_; }
+        const std::vector<RenderItem>& getAlphaTested() const { return alpha_tested_; }
+        const std::vector<RenderItem>& getBlended() const { return blended_; }
+
+    private:
+        std::vector<RenderItem> opaque_;
+        std::vector<RenderItem> alpha_tested_;
+        std::vector<RenderItem> blended_;
+    };
+}
@@ -0,0 +1,116 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+
+#include "../Debug.h"
+#include "../Simd.h"
+
+namespace gl {
+
+    SceneGraph::SceneGraph() {
+        local_.addBone(glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+        parent_indices_.push_back(SCENE_ROOT);
+        local_matrices_.emplace_back(1.0f);
+        world_matrices_.emplace_back(1.0f);
+        normal_matrices_.emplace_back(1.0f);
+        local_dirty_.push_back(0);
+        world_changed_.push_back(0);
+    }
+
+    /**
+     * Adds a node below an existing one.
+     * @param parent - Parent node, SCENE_ROOT for a top-level node
+     * @return The new node, valid until the graph is destroyed
+     */
+    SceneNode SceneGraph::addNode(SceneNode parent, const glm::vec3& translation, const glm::quat& rotation,
+        const glm::vec3& scale) {
+        if (parent >= size()) {
+            debug::error("Scene graph parent " + std::to_string(parent) + " does not exist, attaching to the root");
+            parent = SCENE_ROOT;
+        }
+        const SceneNode node = local_.addBone(translation, rotation, scale);
+        parent_indices_.push_back(parent);
+        local_matrices_.emplace_back(1.0f);
+        world_matrices_.emplace_back(1.0f);
+        normal_matrices_.emplace_back(1.0f);
+        local_dirty_.push_back(0);
+        world_changed_.push_back(0);
+        markDirty(node);
+        return node;
+    }
+
+    void SceneGraph::setLocal(const SceneNode node, const glm::vec3& translation, const glm::quat& rotation,
+        const glm::vec3& scale) {
+        local_.setBone(node, translation, rotation, scale);
+        markDirty(node);
+    }
+
+    // For local transforms that come as matrices, such as a bone's model-space transform
+    void SceneGraph::setLocalMatrix(const SceneNode node, const glm::mat4& local_matrix) {
+        glm::vec3 translation, scale;
+        glm::quat rotation;
+        AnimationClip::decompose(local_matrix, translation, rotation, scale);
+        setLocal(node, translation, rotation, scale);
+    }
+
+    void SceneGraph::setTranslation(const SceneNode node, const glm::vec3& translation) {
+        local_.tx[node] = translation.x; local_.ty[node] = translation.y; local_.tz[node] = translation.z;
+        markDirty(node);
+    }
+
+    void SceneGraph::setRotation(const SceneNode node, const glm::quat& rotation) {
+        local_.qx[node] = rotation.x; local_.qy[node] = rotation.y; local_.qz[node] = rotation.z; local_.qw[node] = rotation.w;
+        markDirty(node);
+    }
+
+    void SceneGraph::setScale(const SceneNode node, const glm::vec3& scale) {
+        local_.sx[node] = scale.x; local_.sy[node] = scale.y; local_.sz[node] = scale.z;
+        markDirty(node);
+    }
+
+    void SceneGraph::markDirty(const SceneNode node) {
+        local_dirty_[node] = 1;
+        first_dirty_ = std::min(first_dirty_, node);
+    }
+
+    /**
+     * Rebuilds the world and normal matrices of every edited node and its descendants.
+     * Local matrices are converted a SIMD block at a time, for blocks holding an edited node; nodes before
+     * the first edit are not visited and clean nodes after it cost one flag test.
+     * @return Number of world matrices rebuilt
+     */
+    unsigned int SceneGraph::updateWorldTransforms() {
+        const auto num_nodes = static_cast<SceneNode>(size());
+
+        // Clear the flags of the previous update that this one will not overwrite
+        if (changed_begin_ < first_dirty_) {
+            std::fill(world_changed_.begin() + changed_begin_, world_changed_.begin() + std::min(first_dirty_, num_nodes), 0);
+        }
+        changed_begin_ = first_dirty_;
+        if (first_dirty_ >= num_nodes) return 0;
+
+        constexpr SceneNode width = simd::WIDTH;
+        for (SceneNode block = first_dirty_ - first_dirty_ % width; block < num_nodes; block += width) {
+            const SceneNode end = std::min(block + width, num_nodes);
+            if (std::any_of(local_dirty_.begin() + block, local_dirty_.begin() + end, [](const uint8_t d) { return d != 0; })) {
+                local_.toMatrices(block, end - block, local_matrices_.data());
+            }
+        }
+
+        unsigned int updated = 0;
+        for (SceneNode i = first_dirty_; i < num_nodes; i++) {
+            const SceneNode parent = parent_indices_[i];
+            const uint8_t changed = local_dirty_[i] | world_changed_[parent];
+            world_changed_[i] = changed;
+            if (!changed) continue;
+
+            simd::mulAffine(glm::value_ptr(world_matrices_[parent]), glm::value_ptr(local_matrices_[i]),
+                glm::value_ptr(world_matrices_[i]));
+            normal_matrices_[i] = glm::transpose(glm::inverse(glm::mat3(world_matrices_[i])));
+            local_dirty_[i] = 0;
+            updated++;
+        }
+        first_dirty_ = num_nodes;
+        return updated;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "AnimationClip.h"
+#include "glm/glm.hpp"
+
+namespace gl {
+
+    using SceneNode = unsigned int;
+    constexpr SceneNode SCENE_ROOT = 0;  // Implicit identity node every top-level node hangs off
+
+    /**
+     * A hierarchy of transforms stored structure-of-arrays in topological order.
+     * A node's parent must exist before it is added, so the insertion order already has every parent before
+     * its children and world matrices propagate in one linear pass. Edits only mark a node dirty; the pass
+     * starts at the first dirty node and rebuilds a node only if it or an ancestor changed.
+     */
+    class SceneGraph {
+    public:
+        SceneGraph();
+        SceneGraph(const SceneGraph&) = delete;
+        SceneGraph& operator=(const SceneGraph&) = delete;
+
+        SceneNode addNode(SceneNode parent = SCENE_ROOT, const glm::vec3& translation = glm::vec3(0.0f),
+            const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+        void setLocal(SceneNode node, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+        void setLocalMatrix(SceneNode node, const glm::mat4& local_matrix);
+        void setTranslation(SceneNode node, const glm::vec3& translation);
+        void setRotation(SceneNode node, const glm::quat& rotation);
+        void setScale(SceneNode node, const glm::vec3& scale);
+
+        unsigned int updateWorldTransforms();
+
+        SceneNode getParent(SceneNode node) const { return parent_indices_[node]; }
+        const glm::mat4& getWorldMatrix(SceneNode node) const { return world_matrices_[node]; }
+        const glm::mat3& getNormalMatrix(SceneNode node) const { return normal_matrices_[node]; }
+        bool worldChanged(SceneNode node) const { return world_changed_[node] != 0; }
+        size_t size() const { return parent_indices_.size(); }
+
+    private:
+        void markDirty(SceneNode node);
+
+        LocalPose local_;                       // Local TRS, indexed by node
+        std::vector<SceneNode> parent_indices_;
+        std::vector<glm::mat4> local_matrices_;
+        std::vector<glm::mat4> world_matrices_;
+        std::vector<glm::mat3> normal_matrices_;
+        std::vector<uint8_t> local_dirty_;      // Local TRS edited since the last update
+        std::vector<uint8_t> world_changed_;    // World matrix rebuilt by the last update
+
+        SceneNode first_dirty_ = 1;             // Lowest dirty node, size() when clean
+        SceneNode changed_begin_ = 1;           // world_changed_ is only set from here on
+    };
+}
@@ -0,0 +1,323 @@
+#include "ShaderVariants.h"
+
+#include <algorithm>
+
+#include "CascadedShadows.h"
+#include "LightClusters.h"
+#include "MaterialConstants.h"
+#include "../Debug.h"
+
+namespace gl {
+
+    std::unordered_map<VariantKey, ShaderVariants::Program> ShaderVariants::programs_;
+    std::unordered_map<VariantKey, GLuint> ShaderVariants::vertex_stages_;
+    std::unordered_map<VariantKey, GLuint> ShaderVariants::fragment_stages_;
+
+    // By VariantVertex
+    static const char* VERTEX_PATHS[] = {
+        "Resources/Shaders/phong_vert.glsl",
+        "Resources/Shaders/skinned_vert.glsl",
+        "Resources/Shaders/skinned_dq_vert.glsl",
+        "Resources/Shaders/skinned_instanced_vert.glsl",
+        "Resources/Shaders/skinned_baked_vert.glsl",
+        "Resources/Shaders/fullscreen_vert.glsl",
+        "Resources/Shaders/skinning_feedback_vert.glsl"
+    };
+
+    // Captured interleaved in the static vertex layout, see Graphics::createPreSkinnedMesh
+    static const std::vector<const char*> SKINNING_FEEDBACK_VARYINGS = {"SkinnedPosition", "SkinnedNormal",
+        "SkinnedTexCoord"};
+
+    // Bits read by the vertex stage; the others only by the fragment stage
+    static constexpr VariantKey VERTEX_STAGE_MASK = VARIANT_VERTEX_MASK | VARIANT_SKINNING_MASK;
+
+    // Names are interned once per static UniformName, and on every call for strings passed directly
+    UniformName::UniformName(const char* name) {
+        static std::unordered_map<std::string, int> ids;
+        const auto [found, added] = ids.try_emplace(name, (int) ids.size());
+        if (added) names().emplace_back(name);
+        id_ = found->second;
+    }
+
+    // A function local, so statics in other files can intern their names during initialization
+    std::vector<std::string>& UniformName::names() {
+        static std::vector<std::string> names;
+        return names;
+    }
+
+    const char* UniformName::getName(const int id) {
+        return names()[id].c_str();
+    }
+
+    size_t UniformName::getCount() {
+        return names().size();
+    }
+
+    ShaderVariants::ShaderVariants(const VariantVertex vertex, const VariantPass pass) : variable_(true),
+        key_(VariantKey(vertex) << VARIANT_VERTEX_SHIFT | VariantKey(pass) << VARIANT_PASS_SHIFT) {}
+
+    ShaderVariants::ShaderVariants(const ShaderProgram& program) : fixed_{program, {}} {}
+
+    // Picked once when a material is loaded; alpha blended materials need no test, they fade instead
+    VariantKey ShaderVariants::getMaterialKey(const DrawMaterial& material) {
+        VariantKey key = material.textures.flags & VARIANT_TEXTURE_MASK;
+        if (material.alpha_mode == ALPHA_MASK) key |= VARIANT_ALPHA_TEST;
+        return key;
+    }
+
+    /**
+     * The lines inserted after a variant's #version. The material, cluster and cascade constants are generated from
+     * the headers that own them, so the shaders cannot drift from them; then one define per feature the key turns on.
+     */
+    std::string ShaderVariants::getDefines(const VariantKey key) {
+        std::string defines;
+        defines += "#define TEXTURE_FLAG_AMBIENT " + std::to_string(material::TEXTURE_FLAG_AMBIENT) + "\n";
+        defines += "#define TEXTURE_FLAG_DIFFUSE " + std::to_string(material::TEXTURE_FLAG_DIFFUSE) + "\n";
+        defines += "#define TEXTURE_FLAG_SPECULAR " + std::to_string(material::TEXTURE_FLAG_SPECULAR) + "\n";
+        defines += "#define TEXTURE_FLAGS " + std::to_string(key & VARIANT_TEXTURE_MASK) + "\n";
+        defines += "#define ALPHA_CUTOFF " + std::to_string(ALPHA_CUTOFF) + "\n";
+        defines += "#define CLUSTER_GRID_X " + std::to_string(LightClusters::GRID_X) + "\n";
+        defines += "#define CLUSTER_GRID_Y " + std::to_string(LightClusters::GRID_Y) + "\n";
+        defines += "#define CLUSTER_GRID_Z " + std::to_string(LightClusters::GRID_Z) + "\n";
+        defines += "#define CASCADE_COUNT " + std::to_string(CascadedShadows::CASCADE_COUNT) + "\n";
+
+        if (key & material::TEXTURE_FLAG_AMBIENT) defines += "#define HAS_AMBIENT_TEXTURE\n";
+        if (key & material::TEXTURE_FLAG_DIFFUSE) defines += "#define HAS_DIFFUSE_TEXTURE\n";
+        if (key & material::TEXTURE_FLAG_SPECULAR) defines += "#define HAS_SPECULAR_TEXTURE\n";
+        if (key & VARIANT_ALPHA_TEST) defines += "#define ALPHA_TEST\n";
+
+        if (key & VARIANT_SHADOWS) defines += "#define SHADOWS\n";
+        if (key & VARIANT_CLUSTERED_LIGHTS) defines += "#define CLUSTERED_LIGHTS\n";
+        if (key & VARIANT_DIRECTIONAL_LIGHT) defines += "#define DIRECTIONAL_LIGHT\n";
+        if (key & VARIANT_BONE_BUFFER) defines += "#define BONE_BUFFER\n";
+
+        switch ((key & VARIANT_PASS_MASK) >> VARIANT_PASS_SHIFT) {
+            case PASS_WEIGHTED_OIT: defines += "#define WEIGHTED_OIT\n"; break;
+            case PASS_GBUFFER: defines += "#define GBUFFER\n"; break;
+            default: break;
+        }
+        return defines;
+    }
+
+    size_t ShaderVariants::getProgramCount() {
+        return programs_.size();
+    }
+
+    void ShaderVariants::deletePrograms() {
+        for (const auto& [key, program] : programs_) {
+            program.program.deleteProgram();
+        }
+        for (const auto* stages : {&vertex_stages_, &fragment_stages_}) {
+            for (const auto& [key, shader] : *stages) {
+                glDeleteShader(shader);
+            }
+        }
+        programs_.clear();
+        vertex_stages_.clear();
+        fragment_stages_.clear();
+    }
+
+    // Binds the current variant, compiling it on first use. Arrays set before are forgotten, see setMat4Vec
+    void ShaderVariants::use() {
+        for (auto& uniform : uniforms_) {
+            if (uniform.array) uniform = {};
+        }
+        if (!variable_) {
+            fixed_.program.use();
+            return;
+        }
+        if (program_) applied_[normalize(key_)] = serial_;
+        program_ = nullptr;
+        select(key_);
+    }
+
+    // Material bits of the next draws, from DrawMaterial::variant. Ignored by a fixed program
+    void ShaderVariants::setMaterialKey(const VariantKey material_key) {
+        select((key_ & ~VARIANT_MATERIAL_MASK) | (material_key & VARIANT_MATERIAL_MASK));
+    }
+
+    void ShaderVariants::setLightingFlag(const VariantKey flag, const bool enabled) {
+        select(enabled ? key_ | flag : key_ & ~flag);
+    }
+
+    // Chosen per skeleton by Graphics::setBonePalette, before its palette is uploaded
+    void ShaderVariants::setSkinningFlag(const VariantKey flag, const bool enabled) {
+        select(enabled ? key_ | flag : key_ & ~flag);
+    }
+
+    void ShaderVariants::setPass(const VariantPass pass) {
+        select((key_ & ~VARIANT_PASS_MASK) | VariantKey(pass) << VARIANT_PASS_SHIFT);
+    }
+
+    /**
+     * Binds the variant for a key if it is not bound already, and brings it up to date with the uniforms set
+     * since it was last bound.
+     */
+    void ShaderVariants::select(const VariantKey key) {
+        if (!variable_ || (program_ && key == key_)) return;
+        auto& program = getProgram(key);
+        if (program_ == &program) {
+            key_ = key;     // Normalized to the same program
+            return;
+        }
+        if (program_) applied_[normalize(key_)] = serial_;
+
+        program.program.use();
+        const auto applied = applied_.find(normalize(key));
+        replay(program, applied == applied_.end() ? 0 : applied->second);
+        key_ = key;
+        program_ = &program;
+    }
+
+    // Passes ignore the key bits that make no difference to them, so those share a program
+    VariantKey ShaderVariants::normalize(VariantKey key) {
+        switch ((key & VARIANT_PASS_MASK) >> VARIANT_PASS_SHIFT) {
+            case PASS_GBUFFER: key &= ~(VARIANT_LIGHTING_MASK | VariantKey(material::TEXTURE_FLAG_AMBIENT)); break;
+            case PASS_DEFERRED_LIGHTING: key &= ~VARIANT_MATERIAL_MASK; break;
+            case PASS_DEPTH:
+            case PASS_SKINNING_FEEDBACK: key &= VERTEX_STAGE_MASK | VARIANT_PASS_MASK; break;
+            default: break;
+        }
+        return key;
+    }
+
+    ShaderVariants::Program& ShaderVariants::getProgram(VariantKey key) {
+        key = normalize(key);
+        if (const auto found = programs_.find(key); found != programs_.end()) {
+            return found->second;
+        }
+
+        const GLuint vertex_shader = getStage(vertex_stages_, GL_VERTEX_SHADER, key & VERTEX_STAGE_MASK);
+        debug::print("Compiling shader variant " + std::to_string(key));
+        if ((key & VARIANT_PASS_MASK) >> VARIANT_PASS_SHIFT == PASS_SKINNING_FEEDBACK) {
+            return programs_[key] = {Shaders::createFeedbackProgram(vertex_shader, SKINNING_FEEDBACK_VARYINGS), {}};
+        }
+        const GLuint fragment_shader = getStage(fragment_stages_, GL_FRAGMENT_SHADER, key & ~VERTEX_STAGE_MASK);
+        return programs_[key] = {Shaders::createShaderProgram(vertex_shader, fragment_shader), {}};
+    }
+
+    GLuint ShaderVariants::getStage(std::unordered_map<VariantKey, GLuint>& stages, const GLenum type,
+        const VariantKey key) {
+        if (const auto found = stages.find(key); found != stages.end()) {
+            return found->second;
+        }
+
+        const char* path;
+        if (type == GL_VERTEX_SHADER) {
+            path = VERTEX_PATHS[(key & VARIANT_VERTEX_MASK) >> VARIANT_VERTEX_SHIFT];
+        } else {
+            switch ((key & VARIANT_PASS_MASK) >> VARIANT_PASS_SHIFT) {
+                case PASS_GBUFFER: path = "Resources/Shaders/gbuffer_frag.glsl"; break;
+                case PASS_DEFERRED_LIGHTING: path = "Resources/Shaders/deferred_light_frag.glsl"; break;
+                case PASS_DEPTH: path = "Resources/Shaders/bounds_frag.glsl"; break;
+                default: path = "Resources/Shaders/phong_frag.glsl"; break;
+            }
+        }
+        return stages[key] = Shaders::createShader(type, path, getDefines(key));
+    }
+
+    // Looked up once per program and uniform, then kept with the program
+    GLint ShaderVariants::getLocation(Program& program, const int id) {
+        if (id >= (int) program.locations.size()) {
+            program.locations.resize(UniformName::getCount(), LOCATION_UNKNOWN);
+        }
+        GLint& location = program.locations[id];
+        if (location == LOCATION_UNKNOWN) {
+            location = glGetUniformLocation(program.program.getProgramID(), UniformName::getName(id));
+        }
+        return location;
+    }
+
+    void ShaderVariants::upload(const GLint location, const Uniform& uniform) {
+        if (location < 0) return;
+        const float* values = uniform.array ? uniform.array : uniform.values;
+        switch (uniform.type) {
+            case UNIFORM_NONE: break;
+            case UNIFORM_INT: glUniform1i(location, uniform.int_value); break;
+            case UNIFORM_FLOAT: glUniform1fv(location, uniform.count, values); break;
+            case UNIFORM_VEC2: glUniform2fv(location, uniform.count, values); break;
+            case UNIFORM_VEC3: glUniform3fv(location, uniform.count, values); break;
+            case UNIFORM_VEC4: glUniform4fv(location, uniform.count, values); break;
+            case UNIFORM_MAT3: glUniformMatrix3fv(location, uniform.count, GL_FALSE, values); break;
+            case UNIFORM_MAT4: glUniformMatrix4fv(location, uniform.count, GL_FALSE, values); break;
+        }
+    }
+
+    ShaderVariants::Uniform& ShaderVariants::record(const UniformName& name, const UniformType type,
+        const GLsizei count) {
+        if (name.getId() >= (int) uniforms_.size()) uniforms_.resize(UniformName::getCount());
+        auto& uniform = uniforms_[name.getId()];
+        uniform.type = type;
+        uniform.count = count;
+        uniform.serial = ++serial_;
+        return uniform;
+    }
+
+    void ShaderVariants::set(const UniformName& name, const UniformType type, const float* values, const size_t size) {
+        auto& uniform = record(name, type, 1);
+        std::copy_n(values, size, uniform.values);
+        uniform.array = nullptr;
+        upload(getLocation(current(), name.getId()), uniform);
+    }
+
+    void ShaderVariants::setArray(const UniformName& name, const UniformType type, const GLsizei count,
+        const float* values) {
+        auto& uniform = record(name, type, count);
+        uniform.array = values;
+        upload(getLocation(current(), name.getId()), uniform);
+    }
+
+    // Uploads the uniforms set after since to a bound variant
+    void ShaderVariants::replay(Program& program, const uint64_t since) {
+        for (int id = 0; id < (int) uniforms_.size(); id++) {
+            const auto& uniform = uniforms_[id];
+            if (uniform.serial <= since || uniform.type == UNIFORM_NONE) continue;
+            upload(getLocation(program, id), uniform);
+        }
+    }
+
+    /**
+     * Arrays, bone palettes mostly, are too large to copy on every draw. The caller's data is kept instead and only
+     * uploaded again if another variant is bound, so it has to stay as it is until the next use().
+     */
+    void ShaderVariants::setMat4Vec(const UniformName& name, const size_t size,
+        const std::vector<glm::mat4>& matrices) {
+        setArray(name, UNIFORM_MAT4, (GLsizei) size, glm::value_ptr(matrices[0]));
+    }
+
+    void ShaderVariants::setVec4Vec(const UniformName& name, const size_t size,
+        const std::vector<glm::vec4>& vectors) {
+        setArray(name, UNIFORM_VEC4, (GLsizei) size, glm::value_ptr(vectors[0]));
+    }
+
+    void ShaderVariants::setMat4(const UniformName& name, const glm::mat4& matrix) {
+        set(name, UNIFORM_MAT4, glm::value_ptr(matrix), 16);
+    }
+
+    void ShaderVariants::setMat3(const UniformName& name, const glm::mat3& matrix) {
+        set(name, UNIFORM_MAT3, glm::value_ptr(matrix), 9);
+    }
+
+    void ShaderVariants::setVec4(const UniformName& name, const glm::vec4& vector) {
+        set(name, UNIFORM_VEC4, glm::value_ptr(vector), 4);
+    }
+
+    void ShaderVariants::setVec3(const UniformName& name, const glm::vec3& vector) {
+        set(name, UNIFORM_VEC3, glm::value_ptr(vector), 3);
+    }
+
+    void ShaderVariants::setVec2(const UniformName& name, const glm::vec2& vector) {
+        set(name, UNIFORM_VEC2, glm::value_ptr(vector), 2);
+    }
+
+    void ShaderVariants::setFloat(const UniformName& name, const float& value) {
+        set(name, UNIFORM_FLOAT, &value, 1);
+    }
+
+    void ShaderVariants::setInt(const UniformName& name, const int value) {
+        auto& uniform = record(name, UNIFORM_INT, 1);
+        uniform.int_value = value;
+        uniform.array = nullptr;
+        upload(getLocation(current(), name.getId()), uniform);
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Shaders.h"
+#include "Texture.h"
+
+namespace gl {
+
+    /**
+     * Identifies one specialized program. The low byte comes from the material and is fixed at load, the next from
+     * the lighting of the frame; the vertex stage and pass pick the source files, and the skinning byte how the
+     * palette of the skeleton being drawn is uploaded. Every set bit becomes a #define, see ShaderVariants::getDefines.
+     */
+    using VariantKey = uint64_t;
+
+    constexpr VariantKey VARIANT_TEXTURE_MASK = 0x7;    // TEXTURE_FLAG_* as they are
+    constexpr VariantKey VARIANT_ALPHA_TEST = 0x8;
+    constexpr VariantKey VARIANT_MATERIAL_MASK = 0xff;
+
+    constexpr VariantKey VARIANT_SHADOWS = 0x100;
+    constexpr VariantKey VARIANT_CLUSTERED_LIGHTS = 0x200;
+    constexpr VariantKey VARIANT_DIRECTIONAL_LIGHT = 0x400;
+    constexpr VariantKey VARIANT_LIGHTING_MASK = 0xff00;
+
+    constexpr int VARIANT_PASS_SHIFT = 16;
+    constexpr int VARIANT_VERTEX_SHIFT = 24;
+    constexpr VariantKey VARIANT_PASS_MASK = VariantKey(0xff) << VARIANT_PASS_SHIFT;
+    constexpr VariantKey VARIANT_VERTEX_MASK = VariantKey(0xff) << VARIANT_VERTEX_SHIFT;
+
+    constexpr VariantKey VARIANT_BONE_BUFFER = VariantKey(0x1) << 32;     // Palette in the bone texture buffer
+    constexpr VariantKey VARIANT_SKINNING_MASK = VariantKey(0xff) << 32;
+
+    enum VariantVertex {
+        VERTEX_STATIC,
+        VERTEX_SKINNED,             // Linear blend skinning
+        VERTEX_SKINNED_DQ,          // Dual quaternion skinning
+        VERTEX_SKINNED_INSTANCED,
+        VERTEX_SKINNED_BAKED,
+        VERTEX_FULLSCREEN,          // No attributes, one triangle from gl_VertexID
+        VERTEX_SKINNING_FEEDBACK    // Linear blend skinning into a buffer, see Graphics::preSkin
+    };
+
+    enum VariantPass {
+        PASS_FORWARD,
+        PASS_WEIGHTED_OIT,          // Accumulation and revealage, see WeightedOit.h
+        PASS_GBUFFER,               // Needs no lighting and no ambient texture
+        PASS_DEFERRED_LIGHTING,     // Lights the G-buffer, so has no material
+        PASS_DEPTH,                 // Shadow casters, no material or lighting
+        PASS_SKINNING_FEEDBACK      // Transform feedback with no fragment stage
+    };
+
+    /**
+     * A uniform name interned to a small id, under which ShaderVariants keeps values and cached locations in flat
+     * arrays. Per-draw uniforms keep theirs in a static; a string converts implicitly, at the cost of a lookup.
+     */
+    class UniformName {
+    public:
+        UniformName(const char* name);
+        UniformName(const std::string& name) : UniformName(name.c_str()) {}
+
+        int getId() const { return id_; }
+        static const char* getName(int id);
+        static size_t getCount();
+
+    private:
+        static std::vector<std::string>& names();
+
+        int id_;
+    };
+
+    /**
+     * A shader whose programs are specialized with #defines for the material, lighting and pass being drawn,
+     * instead of branching on uniforms for every fragment. Variants are compiled the first time they are bound
+     * and cached for the whole run; stages are shared between variants that only differ in the other stage.
+     * Uniforms set through it are kept, and replayed onto a variant when it is bound after they changed, so callers
+     * set camera, light and per-draw uniforms once whichever variant the next material picks. Arrays are not copied,
+     * see setMat4Vec.
+     * A single prebuilt program can be wrapped too, so that Graphics holds all its shaders the same way.
+     */
+    class ShaderVariants {
+    public:
+        ShaderVariants() = default;
+        ShaderVariants(VariantVertex vertex, VariantPass pass);
+        explicit ShaderVariants(const ShaderProgram& program);
+
+        static VariantKey getMaterialKey(const DrawMaterial& material);
+        static std::string getDefines(VariantKey key);
+        static size_t getProgramCount();
+        static void deletePrograms();
+
+        void use();
+        void setMaterialKey(VariantKey material_key);
+        void setLightingFlag(VariantKey flag, bool enabled);
+        void setSkinningFlag(VariantKey flag, bool enabled);
+        void setPass(VariantPass pass);
+
+        void setMat4Vec(const UniformName& name, size_t size, const std::vector<glm::mat4>& matrices);
+        void setVec4Vec(const UniformName& name, size_t size, const std::vector<glm::vec4>& vectors);
+        void setMat4(const UniformName& name, const glm::mat4& matrix);
+        void setMat3(const UniformName& name, const glm::mat3& matrix);
+        void setVec4(const UniformName& name, const glm::vec4& vector);
+        void setVec3(const UniformName& name, const glm::vec3& vector);
+        void setVec2(const UniformName& name, const glm::vec2& vector);
+        void setFloat(const UniformName& name, const float& value);
+        void setInt(const UniformName& name, int value);
+
+    private:
+        enum UniformType { UNIFORM_NONE, UNIFORM_INT, UNIFORM_FLOAT, UNIFORM_VEC2, UNIFORM_VEC3, UNIFORM_VEC4,
+            UNIFORM_MAT3, UNIFORM_MAT4 };
+
+        static constexpr GLint LOCATION_UNKNOWN = -2;
+
+        struct Program {
+            ShaderProgram program;
+            std::vector<GLint> locations;   // By UniformName id, LOCATION_UNKNOWN until first asked for
+        };
+
+        struct Uniform {
+            UniformType type = UNIFORM_NONE;
+            GLsizei count = 1;
+            float values[16] = {};          // Up to one mat4
+            const float* array = nullptr;   // Caller's data for arrays, only valid until the next use()
+            int int_value = 0;
+            uint64_t serial = 0;
+        };
+
+        static Program& getProgram(VariantKey key);
+        static GLuint getStage(std::unordered_map<VariantKey, GLuint>& stages, GLenum type, VariantKey key);
+        static VariantKey normalize(VariantKey key);
+        static GLint getLocation(Program& program, int id);
+        static void upload(GLint location, const Uniform& uniform);
+
+        Program& current() { return program_ ? *program_ : fixed_; }
+        void select(VariantKey key);
+        Uniform& record(const UniformName& name, UniformType type, GLsizei count);
+        void set(const UniformName& name, UniformType type, const float* values, size_t size);
+        void setArray(const UniformName& name, UniformType type, GLsizei count, const float* values);
+        void replay(Program& program, uint64_t since);
+
+        Program fixed_;
+        Program* program_ = nullptr;        // Bound variant, in programs_; nullptr for a fixed program
+        bool variable_ = false;
+        VariantKey key_ = 0;
+        std::vector<Uniform> uniforms_;     // By UniformName id
+        std::unordered_map<VariantKey, uint64_t> applied_;  // Newest uniform serial each variant has seen
+        uint64_t serial_ = 0;
+
+        static std::unordered_map<VariantKey, Program> programs_;
+        static std::unordered_map<VariantKey, GLuint> vertex_stages_;     // By vertex bits
+        static std::unordered_map<VariantKey, GLuint> fragment_stages_;   // By all other bits
+    };
+}
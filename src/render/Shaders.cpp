@@ -19,6 +19,10 @@ namespace gl {
         glUniformMatrix4fv(getLocation(name), (GLsizei) size, GL_FALSE, glm::value_ptr(matrices[0]));
     }
 
+    void ShaderProgram::setVec4Vec(const char* name, const size_t size, const std::vector<glm::vec4>& vectors) {
+        glUniform4fv(getLocation(name), (GLsizei) size, glm::value_ptr(vectors[0]));
+    }
+
     void ShaderProgram::setMat4(const char* name, const glm::mat4& matrix) {
         glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
     }
@@ -28,7 +32,7 @@ namespace gl {
     }
 
     void ShaderProgram::setVec4(const char* name, const glm::vec4& vector) {
-        glUniform3fv(getLocation(name), 1, glm::value_ptr(vector));
+        glUniform4fv(getLocation(name), 1, glm::value_ptr(vector));
     }
 
     void ShaderProgram::setVec3(const char* name, const glm::vec3& vector) {
@@ -47,6 +51,10 @@ namespace gl {
         glUniform1i(getLocation(name), value);
     }
 
+    GLuint ShaderProgram::getProgramID() const {
+        return program_id;
+    }
+
     GLuint ShaderProgram::getVertexID() const {
         return vertex_id;
     }
@@ -88,13 +96,62 @@ namespace gl {
         return {program_id, vertex_shader, fragment_program_id};
     }
 
+    // Links already compiled stages, which may be shared with other programs
+    ShaderProgram Shaders::createShaderProgram(const GLuint vertex_shader_id, const GLuint fragment_shader_id) {
+        const auto program_id = initializeProgram(vertex_shader_id, fragment_shader_id);
+
+        return {program_id, vertex_shader_id, fragment_shader_id};
+    }
+
+    /**
+     * Compiles one stage with extra lines right after its #version directive, see ShaderVariants.
+     * @param type GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
+     * @param path The file path to the shader from project root
+     * @param defines Preprocessor lines, each ending in a newline
+     * @return The compiled shader ID
+     */
+    GLuint Shaders::createShader(const GLenum type, const char* path, const std::string& defines) {
+        const auto full_path = util::getPath(path);
+        return initializeShader(type, full_path.c_str(), defines);
+    }
+
+
+    /**
+     * Creates a vertex-only program whose outputs are captured with transform feedback.
+     * Draw with GL_RASTERIZER_DISCARD enabled, since there is no fragment stage.
+     * @param vertex_path The file path to the vertex shader from project root
+     * @param varyings Vertex shader outputs to capture, interleaved in this order into buffer binding 0
+     * @return ShaderProgram struct with no fragment shader
+     */
+    ShaderProgram Shaders::createFeedbackProgram(const char* vertex_path, const std::vector<const char*>& varyings) {
+        const auto full_vert_path = util::getPath(vertex_path);
+
+        const auto vertex_shader = initializeShader(GL_VERTEX_SHADER, full_vert_path.c_str());
+
+        return createFeedbackProgram(vertex_shader, varyings);
+    }
+
+    // Links an already compiled vertex stage, which may be shared with other programs, capturing varyings
+    ShaderProgram Shaders::createFeedbackProgram(const GLuint vertex_shader_id,
+        const std::vector<const char*>& varyings) {
+        const GLuint program = glCreateProgram();
+        glAttachShader(program, vertex_shader_id);
+        glTransformFeedbackVaryings(program, (GLsizei) varyings.size(), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+
+        return {linkProgram(program), vertex_shader_id, 0};
+    }
+
 
     GLuint Shaders::initializeProgram(GLuint vertex_shader, GLuint fragment_shader){
-        GLint linked;
         GLuint program = glCreateProgram();
 
         glAttachShader(program, vertex_shader);
         glAttachShader(program, fragment_shader);
+        return linkProgram(program);
+    }
+
+    GLuint Shaders::linkProgram(const GLuint program) {
+        GLint linked;
         glLinkProgram(program);
         glGetProgramiv(program, GL_LINK_STATUS, &linked);
 
@@ -106,11 +163,16 @@ namespace gl {
         return program;
     }
 
-    GLuint Shaders::initializeShader(GLenum type, const char* filename) {
+    GLuint Shaders::initializeShader(GLenum type, const char* filename, const std::string& defines) {
         GLuint shader = glCreateShader(type);
         GLint compiled;
 
         std::string str = readTextFile(filename);
+        if (!defines.empty()) {
+            // #version must stay the first line
+            const size_t body = str.rfind("#version", 0) == 0 ? str.find('\n') + 1 : 0;
+            str.insert(body, defines);
+        }
         const char* cstr = str.c_str();
 
         glShaderSource(shader, 1, &cstr, nullptr);
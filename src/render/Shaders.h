@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "GL/glew.h"
 
@@ -18,6 +19,7 @@ namespace gl {
         void deleteProgram() const;
 
         void setMat4Vec(const char* name, size_t size, const std::vector<glm::mat4>& matrices);
+        void setVec4Vec(const char* name, size_t size, const std::vector<glm::vec4>& vectors);
         void setMat4(const char* name, const glm::mat4& matrix);
         void setMat3(const char* name, const glm::mat3& matrix);
         void setVec4(const char* name, const glm::vec4& vector);
@@ -26,6 +28,7 @@ namespace gl {
         void setFloat(const char* name, const float& value);
         void setInt(const char* name, int value);
 
+        GLuint getProgramID() const;
         GLuint getVertexID() const;
         GLuint getFragmentID() const;
 
@@ -43,10 +46,15 @@ namespace gl {
     public:
         static ShaderProgram createShaderProgram(const char* vertex_path, const char* fragment_path);
         static ShaderProgram createShaderProgram(const char* vertex_path, GLuint fragment_program_id);
+        static ShaderProgram createShaderProgram(GLuint vertex_shader_id, GLuint fragment_shader_id);
+        static GLuint createShader(GLenum type, const char* path, const std::string& defines);
+        static ShaderProgram createFeedbackProgram(const char* vertex_path, const std::vector<const char*>& varyings);
+        static ShaderProgram createFeedbackProgram(GLuint vertex_shader_id, const std::vector<const char*>& varyings);
 
     private:
         static GLuint initializeProgram(GLuint vertex_shader, GLuint fragment_shader);
-        static GLuint initializeShader(GLenum type, const char* source);
+        static GLuint linkProgram(GLuint program);
+        static GLuint initializeShader(GLenum type, const char* filename, const std::string& defines = "");
         static void getShaderErrors(GLuint shader);
         static void getProgramErrors(GLuint program);
         static GLuint getUniformLocation(GLuint shader_program, const char* uniformName);
@@ -4,6 +4,7 @@
 
 #include "Mesh.h"
 #include "../Debug.h"
+#include "../Simd.h"
 #include "../Util.h"
 #include "assimp/cimport.h"
 #include "assimp/Exporter.hpp"
@@ -107,15 +108,22 @@ namespace gl {
     }
 
     glm::mat4 AnimationChannel::calculateTransform(double animation_time) const {
-        const glm::vec3 position = interpolatePosition(position_keys, animation_time);
-        const glm::quat rotation = interpolateRotation(rotation_keys, animation_time);
-        const glm::vec3 scale = interpolateScale(scale_keys, animation_time);
+        glm::vec3 position, scale;
+        glm::quat rotation;
+        sample(animation_time, position, rotation, scale);
 
         return glm::translate(glm::mat4(1.0f), position)
              * glm::mat4_cast(rotation)
              * glm::scale(glm::mat4(1.0f), scale);
     }
 
+    // Samples the channel's local translation, rotation and scale at the given time in ticks
+    void AnimationChannel::sample(double animation_time, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const {
+        position = interpolatePosition(position_keys, animation_time);
+        rotation = interpolateRotation(rotation_keys, animation_time);
+        scale = interpolateScale(scale_keys, animation_time);
+    }
+
     std::string findRootBone(aiNode* curr_node, const std::unordered_set<std::string>& bone_map) {
         if (bone_map.contains(curr_node->mName.C_Str())) {
             if (auto parent = curr_node->mParent) {
@@ -251,48 +259,104 @@ namespace gl {
     void Skeleton::addBone(const std::string& bone_name, const unsigned int current_id, const int parent_id,
         const glm::mat4& offset_matrix, const glm::mat4& local_transform, const bool is_virtual) {
 
+        // The flat update relies on every parent being stored before its children
+        if (parent_id >= static_cast<int>(current_id)) {
+            debug::error("Bone " + bone_name + " was added before its parent");
+        }
+
         const auto to_add = Bone(bone_name, current_id, parent_id, offset_matrix, local_transform, is_virtual);
         bones_.push_back(to_add);
-        bone_matrices_.push_back(offset_matrix);
+        offset_matrices_.push_back(offset_matrix);
+        bind_local_transforms_.push_back(local_transform);
+        palette_slots_.push_back(-1);
+        parent_indices_.push_back(parent_id + 1);
+        bone_heights_.push_back(0);
+        for (int ancestor = parent_id, height = 1; ancestor >= 0 && bone_heights_[ancestor] < height;
+             ancestor = bones_[ancestor].parent_id, height++) {
+            bone_heights_[ancestor] = height;
+        }
         bone_map_[to_add.name] = current_id;
         num_bones_ = (unsigned int) bones_.size();
         if (parent_id != -1) bones_[parent_id].addChild(to_add);
+        pose_dirty_ = true;
     }
 
+    /**
+     * Gives a bone a slot in the compact skinning palette, which holds only bones with vertex weights.
+     * @param bone_id - Bone referenced by vertex weights
+     * @return Palette slot to store in the vertex bone IDs
+     */
+    unsigned int Skeleton::addSkinningBone(const unsigned int bone_id) {
+        if (palette_slots_[bone_id] < 0) {
+            palette_slots_[bone_id] = static_cast<int>(palette_size_++);
+            pose_dirty_ = true;
+        }
+        return static_cast<unsigned int>(palette_slots_[bone_id]);
+    }
 
-    void Skeleton::traverseBoneHierarchy(const unsigned int bone_id, const glm::mat4& parent_transform) {
-        auto& bone = bones_[bone_id];
-
-        // Accumulate transforms: parent's global transform × this bone's local transform
-        const glm::mat4 global_transform = parent_transform * bone.local_transform;
-
-        // Calculate final bone matrix for shader
-        bone_matrices_[bone_id] = global_transform * bone.offset_matrix;
-
-        // Recursively update all children with this bone's global transform as their parent
-        for (const auto& child_id : bone.children) {
-            traverseBoneHierarchy(child_id, global_transform);
+    /**
+     * Computes the skinning palette for a pose with one linear pass over the parent-ordered bones.
+     * Only bones with a palette slot pay for the offset multiply.
+     * @param pose - Local TRS of every bone
+     * @param global_transforms - Scratch space, holds bone i's model-space transform at i + 1 afterwards
+     * @param palette - Output array of palette_size_ skinning matrices (global * offset)
+     * @param min_bone_height - LOD cutoff: bones whose subtree is shorter than this are not animated
+     * and stay in their bind pose relative to their parent
+     * @return Number of bones evaluated
+     */
+    unsigned int Skeleton::computeBoneMatrices(const LocalPose& pose, std::vector<glm::mat4>& global_transforms,
+        glm::mat4* palette, const unsigned int min_bone_height) const {
+        global_transforms.resize(num_bones_ + 1);
+        global_transforms[0] = glm::mat4(1.0f);
+        pose.toMatrices(global_transforms.data() + 1);
+
+        unsigned int evaluated = 0;
+        for (unsigned int i = 0; i < num_bones_; i++) {
+            const unsigned int parent = parent_indices_[i];
+            float* global = glm::value_ptr(global_transforms[i + 1]);
+
+            const bool skipped = bone_heights_[i] < min_bone_height;
+            // A skipped bone takes its bind pose local transform instead of the sampled one. Its parent's
+            // offset matrix cannot stand in for it, since helper bones keep an identity offset
+            const float* local = skipped ? glm::value_ptr(bind_local_transforms_[i]) : global;
+            simd::mulAffine(glm::value_ptr(global_transforms[parent]), local, global);
+            if (palette_slots_[i] >= 0) {
+                simd::mulAffine(global, glm::value_ptr(offset_matrices_[i]), glm::value_ptr(palette[palette_slots_[i]]));
+            }
+            if (!skipped) evaluated++;
         }
+        return evaluated;
     }
 
+    // Recomputes bone_matrices_ from the current pose, once per pose change
     void Skeleton::updateBoneMatrices() {
-        // Ensure bone_matrices_ is sized correctly
-        if (bone_matrices_.size() != num_bones_) {
-            bone_matrices_.resize(num_bones_, glm::mat4(1.0f));
+        if (!pose_dirty_) return;
+
+        if (pose_.num_bones != num_bones_) {
+            AnimationClip::bindPose(*this, pose_);
         }
+        bone_matrices_.resize(palette_size_, glm::mat4(1.0f));
+        computeBoneMatrices(pose_, global_transforms_, bone_matrices_.data());
+        pose_dirty_ = false;
+        dual_quaternions_dirty_ = true;
+    }
 
-        // Find and traverse from all root bones (those with no parent)
-        for (unsigned int i = 0; i < bones_.size(); i++) {
-            if (bones_[i].parent_id == -1) {
-                // Start traversal from root with identity parent transform
-                traverseBoneHierarchy(i, glm::mat4(1.0f));
-                break;
+    // The current palette as dual quaternions, half the size of bone_matrices_
+    const std::vector<glm::vec4>& Skeleton::getDualQuaternions() {
+        updateBoneMatrices();
+        if (dual_quaternions_dirty_) {
+            dual_quaternions_.resize(2 * bone_matrices_.size());
+            for (size_t i = 0; i < bone_matrices_.size(); i++) {
+                AnimationClip::toDualQuaternion(bone_matrices_[i], &dual_quaternions_[2 * i]);
             }
+            dual_quaternions_dirty_ = false;
         }
+        return dual_quaternions_;
     }
 
     void Skeleton::setCurrentAnimation(size_t index) {
-        current_animation_ = &animations_[index];
+        animation_state_.clip = static_cast<int>(index);
+        animation_state_.time_in_seconds = 0.0;
     }
 
     void Skeleton::setCurrentAnimation(const std::string& animation_name) {
@@ -300,27 +364,100 @@ namespace gl {
             debug::error("Animation " + animation_name + " not found in skeleton.");
             return;
         }
-        current_animation_ = &animations_[animations_name_to_index.at(animation_name)];
+        setCurrentAnimation(animations_name_to_index.at(animation_name));
     }
 
     void Skeleton::playCurrentAnimation(double time_since_previous) {
-        if (current_animation_) {
-            current_animation_->time_in_seconds += time_since_previous;
-            const double time_in_ticks = current_animation_->time_in_seconds * current_animation_->ticks_per_second;
-            const double animation_time = fmod(time_in_ticks, current_animation_->duration);
-            // Update each bone's local transform based on animation channels
-            for (auto& [bone_id, channel] : current_animation_->channels) {
-                bones_[bone_id].local_transform = channel.calculateTransform(animation_time);
-            }
+        if (animation_state_.clip >= 0) {
+            advanceAnimation(animation_state_, time_since_previous);
+            sampleAnimation(animation_state_.clip, static_cast<float>(animation_state_.time_in_seconds), pose_);
+            pose_dirty_ = true;
         }
 
         updateBoneMatrices();
     }
 
     void Skeleton::resetToBindPose() {
-        for (auto& bone : bones_) {
-            bone.local_transform = bone.bind_pose_transform;
+        AnimationClip::bindPose(*this, pose_);
+        pose_dirty_ = true;
+    }
+
+    /**
+     * Bakes every loaded animation into the bone-ordered layout used during playback.
+     * @param sample_rate - Frames per second, or 0 to keep each clip's authored key rate
+     */
+    void Skeleton::bakeAnimations(const float sample_rate) {
+        baked_animations_.resize(animations_.size());
+        compressed_animations_.resize(animations_.size());
+        for (size_t i = 0; i < animations_.size(); i++) {
+            // Compressed clips may have discarded their source keys, so they are never rebaked
+            if (compressed_animations_[i].num_frames == 0) {
+                baked_animations_[i] = AnimationClip::bake(animations_[i], *this, sample_rate);
+            }
         }
+        AnimationClip::bindPose(*this, pose_);
+        pose_dirty_ = true;
+    }
+
+    /**
+     * Compresses every baked animation that is not compressed yet and prints the compression ratio and
+     * the largest error per clip. Playback samples the compressed clips from then on.
+     * @param settings - Error tolerances, and whether to free the uncompressed data afterwards
+     */
+    void Skeleton::compressAnimations(const CompressionSettings& settings) {
+        compressed_animations_.resize(animations_.size());
+        std::vector<std::string> names(animations_.size());
+        for (const auto& [name, index] : animations_name_to_index) {
+            names[index] = name;
+        }
+
+        for (size_t i = 0; i < animations_.size(); i++) {
+            if (compressed_animations_[i].num_frames != 0 || baked_animations_[i].num_frames == 0) continue;
+
+            compressed_animations_[i] = ClipCompression::compress(baked_animations_[i], animations_[i], settings);
+            if (compressed_animations_[i].num_frames == 0) continue;    // Keeps playing the baked clip
+
+            const auto& stats = compressed_animations_[i].stats;
+            debug::print("Compressed animation " + names[i] + ": " + std::to_string(stats.ratio()) + "x ("
+                + std::to_string(stats.source_bytes) + " -> " + std::to_string(stats.compressed_bytes) + " bytes, "
+                + std::to_string(stats.source_keys) + " -> " + std::to_string(stats.compressed_keys) + " keys), max error "
+                + std::to_string(stats.max_position_error) + " units, "
+                + std::to_string(glm::degrees(stats.max_angular_error)) + " degrees, "
+                + std::to_string(stats.max_scale_error) + " scale");
+
+            if (settings.discard_source_keys) {
+                baked_animations_[i] = {};
+                animations_[i].channels.clear();
+            }
+        }
+    }
+
+    // Samples an animation into a pose from its compressed clip if it has one, otherwise its baked clip
+    void Skeleton::sampleAnimation(const size_t index, const float time_in_seconds, LocalPose& pose) const {
+        if (index < compressed_animations_.size() && compressed_animations_[index].num_frames != 0) {
+            ClipCompression::sample(compressed_animations_[index], time_in_seconds, pose, slerp_fixup_);
+        } else {
+            AnimationClip::sample(baked_animations_[index], time_in_seconds, pose, slerp_fixup_);
+        }
+    }
+
+    /**
+     * Advances a playback state by its speed, wrapping looping clips so the time never grows large
+     * enough to lose precision when sampled as a float.
+     */
+    void Skeleton::advanceAnimation(AnimationState& state, const double time_since_previous) const {
+        if (state.clip < 0) return;
+        state.time_in_seconds += time_since_previous * state.playback_speed;
+        const float duration = getAnimationDuration(state.clip);
+        if (animations_[state.clip].looping && duration > 0.0f) {
+            state.time_in_seconds = fmod(state.time_in_seconds, duration);
+            if (state.time_in_seconds < 0.0) state.time_in_seconds += duration;
+        }
+    }
+
+    // Duration in seconds
+    float Skeleton::getAnimationDuration(const size_t index) const {
+        return static_cast<float>(animations_[index].duration / animations_[index].ticks_per_second);
     }
 
 
@@ -408,12 +545,18 @@ namespace gl {
             skeleton.animations_name_to_index[n] = skeleton.animations_.size();
             skeleton.animations_.push_back(anim);
         }
+        skeleton.bakeAnimations();
     }
 
 
 
 
-    SkinnedMesh SkeletalMesh::loadFbx(const char* filename) {
+    /**
+     * Loads a skinned mesh and its animations from an FBX file.
+     * @param filename - Path from project root
+     * @param build_sidecar - Also keep CPU copies of the geometry and weights in SkinnedMesh::sidecar
+     */
+    SkinnedMesh SkeletalMesh::loadFbx(const char* filename, const bool build_sidecar) {
         auto directory = util::getDirectory(filename);
 
         Assimp::Importer importer;
@@ -435,21 +578,29 @@ namespace gl {
 
         auto materials = Texture::loadSceneMaterials(scene, directory);
         DrawMesh mesh;
+        std::unique_ptr<SkinningSidecar> sidecar;
+        if (build_sidecar) {
+            sidecar = std::make_unique<SkinningSidecar>();
+            sidecar->vertex_weights.resize(skeleton.num_bones_);
+        }
         for (size_t i=0; i<scene->mNumMeshes; i++) {
             const aiMesh* aimesh = scene->mMeshes[i];
             if (!aimesh->HasBones()) { continue; }
 
-            for (auto vi =0; vi < aimesh->mNumVertices; vi++) {
-                const aiVector3D& pos = aimesh->mVertices[vi];
-                skeleton.vertices_.emplace_back(pos.x, pos.y, pos.z);
-            }
-
-            for (auto fi = 0; fi < aimesh->mNumFaces; fi++) {
-                const aiFace& face = aimesh->mFaces[fi];
-                skeleton.faces_.emplace_back(face.mIndices[0], face.mIndices[1], face.mIndices[2]);
+            // Submeshes are concatenated in the sidecar, so their vertex ids start after the previous ones
+            const unsigned int base_vertex = sidecar ? sidecar->vertices.size() : 0;
+            if (sidecar) {
+                for (auto vi =0; vi < aimesh->mNumVertices; vi++) {
+                    const aiVector3D& pos = aimesh->mVertices[vi];
+                    sidecar->vertices.emplace_back(pos.x, pos.y, pos.z);
+                }
+                for (auto fi = 0; fi < aimesh->mNumFaces; fi++) {
+                    const aiFace& face = aimesh->mFaces[fi];
+                    sidecar->faces.emplace_back(base_vertex + face.mIndices[0], base_vertex + face.mIndices[1],
+                        base_vertex + face.mIndices[2]);
+                }
             }
 
-            std::vector<glm::vec3> vertices(aimesh->mNumVertices);
             std::vector<BoneIDs> bone_ids(aimesh->mNumVertices, BoneIDs{});
             std::vector<BoneWeights> bone_weights(aimesh->mNumVertices, BoneWeights{});
 
@@ -458,21 +609,23 @@ namespace gl {
             for (size_t b = 0; b < aimesh->mNumBones; b++) { // populate bone data
                 const aiBone* bone = aimesh->mBones[b];
                 auto bone_id = skeleton.bone_map_[bone->mName.C_Str()];
-
+                if (bone->mNumWeights == 0) continue;
+                const auto palette_slot = skeleton.addSkinningBone(bone_id);
 
 
                 for (size_t w = 0; w < bone->mNumWeights; w++) {
                     const aiVertexWeight& weight = bone->mWeights[w];
                     const size_t vertex_id = weight.mVertexId;
 
-                    auto& s_bone = skeleton.bones_[bone_id];
-                    s_bone.vertex_weights[vertex_id] = weight.mWeight;
-                    skeleton.vertex_to_boneID_map_[vertex_id].push_back(bone_id);
+                    if (sidecar) {
+                        sidecar->vertex_weights[bone_id][base_vertex + vertex_id] = weight.mWeight;
+                        sidecar->vertex_to_bone_ids[base_vertex + vertex_id].push_back(bone_id);
+                    }
 
 
                     for (size_t j = 0; j < MAX_BONES_PER_VERTEX; j++) {
                         if (bone_weights[vertex_id][j] == 0.0f) {
-                            bone_ids[vertex_id][j] = bone_id;
+                            bone_ids[vertex_id][j] = palette_slot;
                             bone_weights[vertex_id][j] = weight.mWeight;
                             break;
                         }
@@ -481,8 +634,10 @@ namespace gl {
             }
 
             // Normalize bone weights, default to 1.0 for root bone if no weights
-            for (auto& b_w : bone_weights) {
+            for (size_t v = 0; v < bone_weights.size(); v++) {
+                auto& b_w = bone_weights[v];
                 if (b_w == BoneWeights{}) {
+                    bone_ids[v][0] = skeleton.addSkinningBone(0);
                     b_w[0] = 1.0f;
                 } else {
                     float sum = 0;
@@ -511,7 +666,6 @@ namespace gl {
                 const aiVector3D& texcoord = aimesh->HasTextureCoords(0) ?
                     aimesh->mTextureCoords[0][v] : aiVector3D(0.0f, 0.0f, 0.0f);
 
-                vertices[v] = glm::vec3(pos.x, pos.y, pos.z);
                 positions.push_back(glm::vec3(pos.x, pos.y, pos.z));
                 normals.push_back(glm::vec3(normal.x, normal.y, normal.z));
                 texcoords.push_back(glm::vec2(texcoord.x, texcoord.y));
@@ -544,8 +698,102 @@ namespace gl {
 
 
 
+        if (skeleton.palette_size_ > MAX_UNIFORM_BONES) {
+            debug::print("Skinning palette of " + std::to_string(skeleton.palette_size_) + " bones exceeds "
+                + std::to_string(MAX_UNIFORM_BONES) + ", drawing from a texture buffer instead");
+        }
         skeleton.updateBoneMatrices();
-        return {mesh, skeleton};
+        return {std::move(mesh), std::move(skeleton), std::move(sidecar)};
+    }
+
+    template<typename T>
+    static size_t vectorBytes(const std::vector<T>& v) {
+        return v.capacity() * sizeof(T);
+    }
+
+    // Node-based containers: the value plus a next pointer and cached hash per node, one pointer per bucket
+    template<typename K, typename V>
+    static size_t mapBytes(const std::unordered_map<K, V>& m) {
+        return m.size() * (sizeof(typename std::unordered_map<K, V>::value_type) + 2 * sizeof(void*))
+            + m.bucket_count() * sizeof(void*);
+    }
+
+    /**
+     * Estimates the memory held by a skinned mesh on the CPU and GPU.
+     * Counts container capacity, so results are reproducible but not allocator exact.
+     */
+    SkinnedMeshMemory SkeletalMesh::measureMemory(const SkinnedMesh& skinned_mesh) {
+        SkinnedMeshMemory memory;
+        const auto& skeleton = skinned_mesh.skeleton;
+
+        memory.hierarchy += sizeof(Skeleton) + vectorBytes(skeleton.bones_) + mapBytes(skeleton.bone_map_);
+        for (const auto& bone : skeleton.bones_) {
+            memory.hierarchy += bone.name.capacity() + vectorBytes(bone.children);
+        }
+        for (const auto& [name, id] : skeleton.bone_map_) {
+            memory.hierarchy += name.capacity();
+        }
+        memory.hierarchy += vectorBytes(skeleton.bone_matrices_) + vectorBytes(skeleton.palette_slots_)
+            + vectorBytes(skeleton.parent_indices_) + vectorBytes(skeleton.bone_heights_)
+            + vectorBytes(skeleton.offset_matrices_) + vectorBytes(skeleton.bind_local_transforms_)
+            + vectorBytes(skeleton.global_transforms_)
+            + vectorBytes(skeleton.dual_quaternions_);
+        const auto& pose = skeleton.pose_;
+        for (const auto* stream : {&pose.tx, &pose.ty, &pose.tz, &pose.qx, &pose.qy, &pose.qz, &pose.qw,
+                                   &pose.sx, &pose.sy, &pose.sz}) {
+            memory.hierarchy += vectorBytes(*stream);
+        }
+
+        memory.animations += vectorBytes(skeleton.animations_) + mapBytes(skeleton.animations_name_to_index);
+        for (const auto& animation : skeleton.animations_) {
+            memory.animations += mapBytes(animation.channels);
+            for (const auto& [id, channel] : animation.channels) {
+                memory.animations += channel.bone_name.capacity() + vectorBytes(channel.position_keys)
+                    + vectorBytes(channel.rotation_keys) + vectorBytes(channel.scale_keys);
+            }
+        }
+        memory.animations += vectorBytes(skeleton.baked_animations_);
+        for (const auto& clip : skeleton.baked_animations_) {
+            for (const auto* stream : {&clip.tx, &clip.ty, &clip.tz, &clip.qx, &clip.qy, &clip.qz, &clip.qw,
+                                       &clip.sx, &clip.sy, &clip.sz}) {
+                memory.animations += vectorBytes(*stream);
+            }
+        }
+        memory.animations += vectorBytes(skeleton.compressed_animations_);
+        for (const auto& clip : skeleton.compressed_animations_) {
+            memory.animations += vectorBytes(clip.translation_tracks) + vectorBytes(clip.rotation_tracks)
+                + vectorBytes(clip.scale_tracks) + vectorBytes(clip.translation_frames)
+                + vectorBytes(clip.rotation_frames) + vectorBytes(clip.scale_frames)
+                + vectorBytes(clip.translation_values) + vectorBytes(clip.rotation_values)
+                + vectorBytes(clip.scale_values);
+        }
+
+        if (const auto* sidecar = skinned_mesh.sidecar.get()) {
+            memory.sidecar += sizeof(SkinningSidecar) + vectorBytes(sidecar->vertices) + vectorBytes(sidecar->faces)
+                + vectorBytes(sidecar->vertex_weights) + mapBytes(sidecar->vertex_to_bone_ids);
+            for (const auto& weights : sidecar->vertex_weights) {
+                memory.sidecar += mapBytes(weights);
+            }
+            for (const auto& [vertex, bone_ids] : sidecar->vertex_to_bone_ids) {
+                memory.sidecar += vectorBytes(bone_ids);
+            }
+        }
+
+        // Matches the layout of loadSkinnedShapeIndexed: 12 floats and 4 bone ids per vertex
+        for (const auto& obj : skinned_mesh.draw_mesh.objects) {
+            memory.gpu += obj.shape.numVertices * (12 * sizeof(float) + MAX_BONES_PER_VERTEX * sizeof(unsigned int))
+                + 3 * obj.shape.numTriangles * sizeof(unsigned int);
+        }
+        return memory;
+    }
+
+    void SkeletalMesh::printMemoryReport(const SkinnedMesh& skinned_mesh, const std::string& name) {
+        const auto memory = measureMemory(skinned_mesh);
+        debug::print("Memory of " + name + ": " + std::to_string(memory.cpu() / 1024) + " KB CPU ("
+            + std::to_string(memory.hierarchy / 1024) + " KB hierarchy, "
+            + std::to_string(memory.animations / 1024) + " KB animations, "
+            + std::to_string(memory.sidecar / 1024) + " KB sidecar), "
+            + std::to_string(memory.gpu / 1024) + " KB GPU");
     }
 
     DrawShape SkeletalMesh::loadSkinnedShapeIndexed(
@@ -658,6 +906,7 @@ namespace gl {
         shape.vbo = vbo_float;
         shape.ebo = ebo;
         shape.numTriangles = indices.size() / 3;
+        shape.numVertices = num_vertices;
         shape.min = bmin;
         shape.max = bmax;
 
@@ -1,7 +1,10 @@
 #pragma once
+#include <memory>
 #include <vector>
 #include <string>
 
+#include "AnimationClip.h"
+#include "ClipCompression.h"
 #include "Graphics.h"
 #include "glm/glm.hpp"
 
@@ -10,6 +13,7 @@ struct aiScene;
 namespace gl {
 
 #define MAX_BONES_PER_VERTEX 4
+    constexpr unsigned int MAX_UNIFORM_BONES = 200; // Keep in sync with MAX_BONES in skinned_vert.glsl
     using BoneIDs = std::array<unsigned int, MAX_BONES_PER_VERTEX>;
     using BoneWeights = std::array<float, MAX_BONES_PER_VERTEX>;
 
@@ -24,20 +28,16 @@ namespace gl {
         unsigned int id;                        // Unique bone index
         int parent_id;                 // Parent bone index (-1 for root)
         glm::mat4 offset_matrix = glm::mat4(1.0);       // Inverse bind pose - transforms from mesh space to bone space
-        glm::mat4 local_transform = glm::mat4(1.0);   // Local transform relative to parent bone
         glm::mat4 bind_pose_transform = glm::mat4(1.0);; // Bind pose local transform (immutable after construction)
         std::vector<unsigned int> children;     // Indices of child bones
         bool is_virtual = false;        // For bones without weights
 
-        std::unordered_map<unsigned int, float> vertex_weights; // vertex_id -> weight
-
         Bone(const std::string& bone_name, const unsigned int bone_id, const int parent,
             const glm::mat4& offset, const glm::mat4& bind_pose_transform, bool virtual_bone = false) :
         name(bone_name),
         id(bone_id),
         parent_id(parent),
         offset_matrix(offset),
-        local_transform(bind_pose_transform),
         bind_pose_transform(bind_pose_transform),
         is_virtual(virtual_bone) {}
 
@@ -66,57 +66,115 @@ namespace gl {
         std::vector<ScaleKey> scale_keys;        // Scale keyframes
 
         glm::mat4 calculateTransform(double animation_time) const;
+        void sample(double animation_time, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const;
     };
 
+    // Immutable clip data, shared by every character playing it
     struct Animation {
         double duration; // in ticks
         double ticks_per_second;
-        double time_in_seconds = 0.0;
 
         // Map from bone_id to its animation channel
         std::unordered_map<unsigned int, AnimationChannel> channels;
 
-        // Optional: playback control
         bool looping = true;
-        double playback_speed = 1.0; // scalar
-
+    };
 
+    // Per-character playback state, kept outside the shared clip
+    struct AnimationState {
+        int clip = -1;                  // Index into Skeleton::animations_, -1 for none
+        double time_in_seconds = 0.0;
+        double playback_speed = 1.0;    // scalar
     };
 
     struct Skeleton {
         public:
         Skeleton() = default;
+        Skeleton(const Skeleton&) = delete;             // Hundreds are loaded; copies are always accidental
+        Skeleton& operator=(const Skeleton&) = delete;
+        Skeleton(Skeleton&&) = default;
+        Skeleton& operator=(Skeleton&&) = default;
+
         void addBone(const std::string& bone_name, const unsigned int current_id, const int parent_id,
             const glm::mat4& offset_matrix, const glm::mat4& local_transform, bool is_virtual = false);
         void updateBoneMatrices();
+        const std::vector<glm::vec4>& getDualQuaternions();
+        unsigned int computeBoneMatrices(const LocalPose& pose, std::vector<glm::mat4>& global_transforms,
+            glm::mat4* palette, unsigned int min_bone_height = 0) const;
+        void markPoseDirty() { pose_dirty_ = true; }
+        unsigned int addSkinningBone(unsigned int bone_id);
 
 
         void setCurrentAnimation(size_t index);
         void setCurrentAnimation(const std::string& animation_name);
         void playCurrentAnimation(double time_since_previous);
         void resetToBindPose();
+        void bakeAnimations(float sample_rate = 0.0f);
+        void compressAnimations(const CompressionSettings& settings = {});
+        void sampleAnimation(size_t index, float time_in_seconds, LocalPose& pose) const;
+        void advanceAnimation(AnimationState& state, double time_since_previous) const;
+        float getAnimationDuration(size_t index) const;
 
-        void traverseBoneHierarchy(unsigned int bone_id, const glm::mat4& parent_transform);
         unsigned int num_bones_ = 0;
-        std::vector<Bone> bones_;
+        std::vector<Bone> bones_;              // Parent-before-child order
         std::unordered_map<std::string, unsigned int> bone_map_;
-        std::vector<glm::mat4> bone_matrices_;
+        std::vector<glm::mat4> bone_matrices_;  // Skinning palette, palette_size_ entries
+
+        // Slot of each bone in the skinning palette, -1 for bones without vertex weights (helper nodes)
+        std::vector<int> palette_slots_;
+        unsigned int palette_size_ = 0;
 
-        std::vector<glm::vec3> vertices_;
-        std::vector<glm::ivec3> faces_;
-        std::unordered_map<unsigned int, std::vector<unsigned int>> vertex_to_boneID_map_;
+        // Flat copies of the hierarchy for the per-frame update. Indices are offset by one so that
+        // roots (parent_id -1) address the identity matrix kept at global_transforms_[0]
+        std::vector<unsigned int> parent_indices_;
+        std::vector<unsigned int> bone_heights_;   // Longest path to a leaf below each bone, 0 for leaves
+        std::vector<glm::mat4> offset_matrices_;
+        std::vector<glm::mat4> bind_local_transforms_; // For bones frozen by LOD
+        std::vector<glm::mat4> global_transforms_;
+        bool pose_dirty_ = true;
+
+        // bone_matrices_ as dual quaternions (two vec4 per bone), converted on demand for dual quaternion skinning
+        std::vector<glm::vec4> dual_quaternions_;
+        bool dual_quaternions_dirty_ = true;
 
         std::unordered_map<std::string, size_t> animations_name_to_index;
         std::vector<Animation> animations_;
-        Animation* current_animation_ = nullptr;
+        AnimationState animation_state_;   // Playback state of this skeleton's own pose
+
+        std::vector<BakedClip> baked_animations_; // Parallel to animations_, sampled during playback
+        std::vector<CompressedClip> compressed_animations_; // Parallel to animations_, empty clips are uncompressed
+        LocalPose pose_;
+        bool slerp_fixup_ = true;
 
         glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
         glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
     };
 
+    /**
+     * CPU copies of the skinned geometry that rendering never reads, for debug views and physics.
+     * Only built when requested at load time.
+     */
+    struct SkinningSidecar {
+        std::vector<glm::vec3> vertices;    // Bind pose positions of all skinned submeshes, concatenated
+        std::vector<glm::ivec3> faces;      // Indices into vertices
+        std::vector<std::unordered_map<unsigned int, float>> vertex_weights; // Per bone: vertex -> weight
+        std::unordered_map<unsigned int, std::vector<unsigned int>> vertex_to_bone_ids;
+    };
+
     struct SkinnedMesh {
         DrawMesh draw_mesh;
         Skeleton skeleton;
+        std::unique_ptr<SkinningSidecar> sidecar;   // Null unless loaded with build_sidecar
+    };
+
+    // Approximate bytes held by one SkinnedMesh, including container capacity
+    struct SkinnedMeshMemory {
+        size_t hierarchy = 0;       // Bones, names and the flat per-frame arrays
+        size_t animations = 0;      // Source keys, baked and compressed clips
+        size_t sidecar = 0;
+        size_t gpu = 0;             // Vertex and index buffers
+
+        size_t cpu() const { return hierarchy + animations + sidecar; }
     };
 
 
@@ -124,7 +182,9 @@ namespace gl {
     public:
         static void loadAnimations(const char* filename, Skeleton& skeleton);
         static void loadAnimations(const aiScene* scene, Skeleton& skeleton);
-        static SkinnedMesh loadFbx(const char* filename);
+        static SkinnedMesh loadFbx(const char* filename, bool build_sidecar = false);
+        static SkinnedMeshMemory measureMemory(const SkinnedMesh& skinned_mesh);
+        static void printMemoryReport(const SkinnedMesh& skinned_mesh, const std::string& name);
 
 
 
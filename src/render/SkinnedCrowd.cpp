@@ -0,0 +1,260 @@
+#include "SkinnedCrowd.h"
+
+#include <algorithm>
+
+#include "../Debug.h"
+
+namespace gl {
+
+    namespace {
+        constexpr int TEXELS_PER_MATRIX = 3;
+        constexpr int BAKED_INSTANCE_STRIDE = 4;   // Model matrix rows, then (clip, time, unused, unused)
+
+        // Writes the affine rows of a column-major matrix as three texels
+        void writeAffineRows(const glm::mat4& m, glm::vec4* out) {
+            for (int row = 0; row < TEXELS_PER_MATRIX; row++) {
+                out[row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+            }
+        }
+    }
+
+    SkinnedCrowd::SkinnedCrowd(std::shared_ptr<const SkinnedMesh> asset) :
+    asset_(std::move(asset)) {
+        AnimationClip::bindPose(asset_->skeleton, bind_pose_);
+        const auto& draw_mesh = asset_->draw_mesh;
+        if (!draw_mesh.objects.empty()) {
+            mesh_radius_ = 0.5f * glm::length(draw_mesh.max - draw_mesh.min);
+        }
+    }
+
+    /**
+     * Adds a character to the crowd.
+     * @param transform - Placement of the instance
+     * @param clip - Animation index on the shared skeleton, -1 to hold the bind pose
+     * @param playback_speed - Speed multiplier for this instance only
+     * @param start_time - Initial time into the clip in seconds, used to desynchronize instances
+     * @return Index of the new instance
+     */
+    size_t SkinnedCrowd::addInstance(const Transform& transform, const int clip, const double playback_speed,
+        const double start_time) {
+        SkinnedInstance instance;
+        instance.transform = transform;
+        instance.animation.clip = clip;
+        instance.animation.playback_speed = playback_speed;
+        instance.animation.time_in_seconds = start_time;
+        asset_->skeleton.advanceAnimation(instance.animation, 0.0); // Wrap the start time into the clip
+        instances_.push_back(instance);
+        palette_frames_.push_back(0);
+        held_palettes_.resize(instances_.size() * (getInstanceStride() - TEXELS_PER_MATRIX));
+        return instances_.size() - 1;
+    }
+
+    SkinnedInstance& SkinnedCrowd::getInstance(const size_t index) {
+        return instances_[index];
+    }
+
+    size_t SkinnedCrowd::size() const {
+        return instances_.size();
+    }
+
+    /**
+     * Switches instances beyond a distance to the baked animation path.
+     * @param animation_texture - Baked from the crowd's skeleton, or nullptr to animate every instance on the CPU
+     * @param baked_distance - Distance from the camera past which instances read their pose from the texture
+     */
+    void SkinnedCrowd::setAnimationTexture(std::shared_ptr<const AnimationTexture> animation_texture,
+        const float baked_distance) {
+        animation_texture_ = std::move(animation_texture);
+        baked_distance_ = baked_distance;
+    }
+
+    /**
+     * Replaces the animation LOD levels.
+     * @param lods - Levels sorted by decreasing min_screen_size; the last one should start at 0
+     */
+    void SkinnedCrowd::setLods(const std::vector<AnimationLod>& lods) {
+        lods_ = lods;
+    }
+
+    /**
+     * Advances every instance and packs it into the staging buffer of its path: near instances get their
+     * model matrix and sampled bone palette, far instances only their model matrix and playback time.
+     * Call upload() afterwards from the thread owning the GL context.
+     */
+    void SkinnedCrowd::update(const double time_since_previous, const glm::vec3& camera_position,
+        const float projection_scale) {
+        prepare(time_since_previous, camera_position, projection_scale);
+        writePalettes(0, num_near_, scratch_);
+    }
+
+    /**
+     * First half of update(): advances playback, assigns each instance to the near or far path and an
+     * animation LOD, and writes everything except the near palettes. Cheap enough to run serially before
+     * the palettes are split into jobs.
+     * @param projection_scale - projection[1][1], converts size over distance to a fraction of the screen height
+     */
+    void SkinnedCrowd::prepare(const double time_since_previous, const glm::vec3& camera_position,
+        const float projection_scale) {
+        const auto& skeleton = asset_->skeleton;
+        const size_t stride = getInstanceStride();
+        const bool baked = animation_texture_ && !animation_texture_->clips.empty();
+        const float baked_distance_sq = baked_distance_ * baked_distance_;
+
+        staging_.resize(instances_.size() * stride);
+        baked_staging_.resize(baked ? instances_.size() * BAKED_INSTANCE_STRIDE : 0);
+        near_instances_.resize(instances_.size());
+        near_lods_.resize(instances_.size());
+        num_near_ = 0;
+        num_far_ = 0;
+        frame_++;
+
+        for (size_t i = 0; i < instances_.size(); i++) {
+            auto& instance = instances_[i];
+            skeleton.advanceAnimation(instance.animation, time_since_previous);
+
+            const glm::mat4& model_matrix = instance.transform.getModelMatrix();
+            const glm::vec3 offset = glm::vec3(model_matrix[3]) - camera_position;
+            const int clip = instance.animation.clip;
+            if (baked && clip >= 0 && clip < (int) animation_texture_->clips.size()
+                && glm::dot(offset, offset) > baked_distance_sq) {
+                glm::vec4* out = baked_staging_.data() + num_far_++ * BAKED_INSTANCE_STRIDE;
+                writeAffineRows(model_matrix, out);
+                out[3] = glm::vec4((float) clip, (float) instance.animation.time_in_seconds, 0.0f, 0.0f);
+            } else {
+                writeAffineRows(model_matrix, staging_.data() + num_near_ * stride);
+                near_instances_[num_near_] = i;
+                near_lods_[num_near_] = selectLod(i, model_matrix, std::sqrt(glm::dot(offset, offset)), projection_scale);
+                num_near_++;
+            }
+        }
+    }
+
+    // Picks the LOD of a near instance, or returns HOLD_PALETTE if its palette is not due for an update
+    unsigned int SkinnedCrowd::selectLod(const size_t index, const glm::mat4& model_matrix, const float distance,
+        const float projection_scale) const {
+        const float scale = std::max({glm::length(glm::vec3(model_matrix[0])), glm::length(glm::vec3(model_matrix[1])),
+                                      glm::length(glm::vec3(model_matrix[2]))});
+        const float screen_size = distance > 0.0f ? mesh_radius_ * scale * projection_scale / distance : 1.0f;
+
+        unsigned int lod = 0;
+        while (lod + 1 < lods_.size() && screen_size < lods_[lod].min_screen_size) {
+            lod++;
+        }
+
+        // Stagger updates by instance index so each frame refreshes a similar share of the crowd
+        const uint64_t interval = std::max(lods_[lod].update_interval, 1u);
+        const bool stale = palette_frames_[index] == 0 || frame_ - palette_frames_[index] >= interval;
+        if (!stale && (frame_ + index) % interval != 0) {
+            return HOLD_PALETTE;
+        }
+        return lod;
+    }
+
+    /**
+     * Second half of update(): samples the near instances in slots [begin, end) that are due for an update
+     * and writes every slot's bone palette. Disjoint ranges may run on different threads, each with its
+     * own scratch.
+     * @return Number of bones evaluated
+     */
+    unsigned int SkinnedCrowd::writePalettes(const size_t begin, const size_t end, PoseScratch& scratch) {
+        const auto& skeleton = asset_->skeleton;
+        const size_t stride = getInstanceStride();
+        const size_t palette_texels = stride - TEXELS_PER_MATRIX;
+        scratch.palette.resize(skeleton.palette_size_);
+
+        unsigned int evaluated = 0;
+        for (size_t slot = begin; slot < end; slot++) {
+            const size_t index = near_instances_[slot];
+            glm::vec4* held = held_palettes_.data() + index * palette_texels;
+
+            if (near_lods_[slot] != HOLD_PALETTE) {
+                const auto& animation = instances_[index].animation;
+                const LocalPose* pose = &bind_pose_;
+                if (animation.clip >= 0) {
+                    skeleton.sampleAnimation(animation.clip, static_cast<float>(animation.time_in_seconds), scratch.pose);
+                    pose = &scratch.pose;
+                }
+                evaluated += skeleton.computeBoneMatrices(*pose, scratch.global_transforms, scratch.palette.data(),
+                    lods_[near_lods_[slot]].min_bone_height);
+
+                for (unsigned int slot_bone = 0; slot_bone < skeleton.palette_size_; slot_bone++) {
+                    writeAffineRows(scratch.palette[slot_bone], held + TEXELS_PER_MATRIX * slot_bone);
+                }
+                palette_frames_[index] = frame_;
+            }
+
+            std::copy_n(held, palette_texels, staging_.data() + slot * stride + TEXELS_PER_MATRIX);
+        }
+        return evaluated;
+    }
+
+    void SkinnedCrowd::upload() {
+        uploadBatches(batches_, staging_, num_near_, getInstanceStride());
+        uploadBatches(baked_batches_, baked_staging_, num_far_, BAKED_INSTANCE_STRIDE);
+    }
+
+    /**
+     * Copies staged instances to texture buffers, splitting them into as many batches as
+     * GL_MAX_TEXTURE_BUFFER_SIZE requires. Each buffer is orphaned before being refilled so the upload
+     * never waits on draws still reading last frame's data.
+     */
+    void SkinnedCrowd::uploadBatches(std::vector<InstanceBatch>& batches, const std::vector<glm::vec4>& staging,
+        const size_t num_instances, const size_t stride) {
+        GLint max_texels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+        const size_t per_batch = static_cast<size_t>(max_texels) / stride;
+        if (per_batch == 0) {
+            debug::error("Skeleton has too many bones to fit one instance in a texture buffer");
+            return;
+        }
+
+        const size_t num_batches = (num_instances + per_batch - 1) / per_batch;
+        while (batches.size() < num_batches) {
+            InstanceBatch batch;
+            glGenBuffers(1, &batch.buffer);
+            glGenTextures(1, &batch.texture);
+            glBindBuffer(GL_TEXTURE_BUFFER, batch.buffer);
+            glBindTexture(GL_TEXTURE_BUFFER, batch.texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, batch.buffer);
+            batches.push_back(batch);
+        }
+
+        for (size_t b = 0; b < batches.size(); b++) {
+            auto& batch = batches[b];
+            batch.first_instance = b * per_batch;
+            batch.num_instances = b < num_batches ? std::min(per_batch, num_instances - batch.first_instance) : 0;
+            if (batch.num_instances == 0) continue;
+
+            const GLsizeiptr bytes = batch.num_instances * stride * sizeof(glm::vec4);
+            glBindBuffer(GL_TEXTURE_BUFFER, batch.buffer);
+            glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, staging.data() + batch.first_instance * stride);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    const SkinnedMesh& SkinnedCrowd::getAsset() const {
+        return *asset_;
+    }
+
+    const AnimationTexture* SkinnedCrowd::getAnimationTexture() const {
+        return animation_texture_.get();
+    }
+
+    const std::vector<InstanceBatch>& SkinnedCrowd::getBatches() const {
+        return batches_;
+    }
+
+    const std::vector<InstanceBatch>& SkinnedCrowd::getBakedBatches() const {
+        return baked_batches_;
+    }
+
+    size_t SkinnedCrowd::getNearCount() const {
+        return num_near_;
+    }
+
+    // Texels per instance: the model matrix followed by one matrix per skinning bone
+    int SkinnedCrowd::getInstanceStride() const {
+        return TEXELS_PER_MATRIX * static_cast<int>(asset_->skeleton.palette_size_ + 1);
+    }
+}
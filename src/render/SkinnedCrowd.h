@@ -0,0 +1,109 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "AnimationTexture.h"
+#include "SkeletalMesh.h"
+
+namespace gl {
+
+    // A lightweight character sharing its mesh, skeleton and clips with the rest of the crowd
+    struct SkinnedInstance {
+        Transform transform;
+        AnimationState animation;
+    };
+
+    // One animation level of detail, picked by the fraction of the screen height an instance covers
+    struct AnimationLod {
+        float min_screen_size = 0.0f;       // Used at or above this size
+        unsigned int update_interval = 1;   // Frames between pose updates; the palette is held in between
+        unsigned int min_bone_height = 0;   // Bones with shorter subtrees (fingers, face) follow their parent
+    };
+
+    // Per-thread buffers for sampling one instance at a time
+    struct PoseScratch {
+        LocalPose pose;
+        std::vector<glm::mat4> global_transforms;
+        std::vector<glm::mat4> palette;
+    };
+
+    // One texture buffer holding a contiguous range of instances
+    struct InstanceBatch {
+        GLuint buffer = 0;
+        GLuint texture = 0;
+        size_t first_instance = 0;
+        size_t num_instances = 0;
+    };
+
+    /**
+     * Many instances of one skinned mesh, drawn with a single instanced call per submesh.
+     * Every instance's model matrix and bone palette are packed into texture buffers, three RGBA32F
+     * texels (the rows of the affine part) per matrix, which skinned_instanced_vert.glsl reads by
+     * gl_InstanceID. The asset is shared and never modified.
+     * With an animation texture set, instances farther than the baked distance skip CPU sampling and
+     * only upload their model matrix and playback time; skinned_baked_vert.glsl reads their pose.
+     */
+    class SkinnedCrowd {
+    public:
+        explicit SkinnedCrowd(std::shared_ptr<const SkinnedMesh> asset);
+        SkinnedCrowd(const SkinnedCrowd&) = delete;
+        SkinnedCrowd& operator=(const SkinnedCrowd&) = delete;
+
+        size_t addInstance(const Transform& transform, int clip, double playback_speed = 1.0, double start_time = 0.0);
+        SkinnedInstance& getInstance(size_t index);
+        size_t size() const;
+
+        void setAnimationTexture(std::shared_ptr<const AnimationTexture> animation_texture, float baked_distance);
+        void setLods(const std::vector<AnimationLod>& lods);
+
+        void update(double time_since_previous, const glm::vec3& camera_position, float projection_scale);
+        void prepare(double time_since_previous, const glm::vec3& camera_position, float projection_scale);
+        unsigned int writePalettes(size_t begin, size_t end, PoseScratch& scratch);
+        void upload();
+
+        const SkinnedMesh& getAsset() const;
+        const AnimationTexture* getAnimationTexture() const;
+        const std::vector<InstanceBatch>& getBatches() const;
+        const std::vector<InstanceBatch>& getBakedBatches() const;
+        int getInstanceStride() const;
+        size_t getNearCount() const;
+
+    private:
+        static constexpr unsigned int HOLD_PALETTE = ~0u;
+
+        unsigned int selectLod(size_t index, const glm::mat4& model_matrix, float distance, float projection_scale) const;
+        static void uploadBatches(std::vector<InstanceBatch>& batches, const std::vector<glm::vec4>& staging,
+            size_t num_instances, size_t stride);
+
+        std::shared_ptr<const SkinnedMesh> asset_;
+        std::vector<SkinnedInstance> instances_;
+
+        LocalPose bind_pose_;
+        PoseScratch scratch_;   // Used by update() on the calling thread
+
+        std::shared_ptr<const AnimationTexture> animation_texture_;
+        float baked_distance_ = 0.0f;
+
+        std::vector<glm::vec4> staging_;        // instance_stride texels per near instance
+        std::vector<glm::vec4> baked_staging_;  // BAKED_INSTANCE_STRIDE texels per far instance
+        // Sorted by decreasing min_screen_size
+        std::vector<AnimationLod> lods_ = {
+            {0.25f, 1, 0},
+            {0.08f, 2, 1},
+            {0.0f, 4, 2}
+        };
+        float mesh_radius_ = 0.0f;      // Bounding sphere radius of the mesh in model space
+        uint64_t frame_ = 0;
+
+        // Each instance's last computed palette, instance_stride - 3 texels, so LODs can hold it between updates
+        std::vector<glm::vec4> held_palettes_;
+        std::vector<uint64_t> palette_frames_; // Frame each held palette was computed, 0 for never
+
+        std::vector<size_t> near_instances_;   // Instance index of each near slot, filled by prepare()
+        std::vector<unsigned int> near_lods_;  // LOD of each near slot, or HOLD_PALETTE
+        size_t num_near_ = 0;
+        size_t num_far_ = 0;
+        std::vector<InstanceBatch> batches_;
+        std::vector<InstanceBatch> baked_batches_;
+    };
+}
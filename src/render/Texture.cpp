@@ -1,5 +1,6 @@
 #include "Texture.h"
 
+#include "ShaderVariants.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "../Debug.h"
@@ -11,6 +12,7 @@
 namespace gl {
 
     std::unordered_map<std::string, GLuint> Texture::loaded_textures_;
+    std::unordered_map<GLuint, AlphaMode> Texture::texture_alpha_modes_;
 
     DrawMaterial Texture::loadMaterial(const aiScene* scene, const aiMaterial* material, const std::string& directory) {
         aiColor3D ambient(0.f, 0.f, 0.f);
@@ -33,6 +35,15 @@ namespace gl {
         draw_material.opacity = opacity;
         draw_material.textures = loadMaterialTextures(scene, material, directory);
 
+        // Constant opacity blends the whole surface; otherwise the diffuse texture's alpha decides
+        const auto diffuse_alpha = texture_alpha_modes_.find(draw_material.textures.diffuse);
+        if (opacity < 1.0f) {
+            draw_material.alpha_mode = ALPHA_BLEND;
+        } else if (diffuse_alpha != texture_alpha_modes_.end()) {
+            draw_material.alpha_mode = diffuse_alpha->second;
+        }
+        draw_material.variant = ShaderVariants::getMaterialKey(draw_material);
+
         return draw_material;
     }
 
@@ -81,6 +92,9 @@ namespace gl {
         glPixelStorei(GL_UNPACK_ALIGNMENT, 4); // Restore default alignment
 
         glBindTexture(GL_TEXTURE_2D, 0);
+        if (channels == 4) {
+            texture_alpha_modes_[textureID] = classifyAlpha((const unsigned char*)image, width * height, channels);
+        }
         stbi_image_free(image);
 
         loaded_textures_[tex_name] = textureID;
@@ -132,6 +146,9 @@ namespace gl {
         glPixelStorei(GL_UNPACK_ALIGNMENT, 4); // Restore default alignment
 
         glBindTexture(GL_TEXTURE_2D, 0); // Unbind texture
+        if (comp == 4) {
+            texture_alpha_modes_[texture_id] = classifyAlpha(image, w * h, comp);
+        }
         stbi_image_free(image); // Free image memory
 
         loaded_textures_[tex_path] = texture_id;
@@ -165,4 +182,23 @@ namespace gl {
             texture.flags |= TEXTURE_FLAG_SPECULAR;
         }
     }
+
+    /**
+     * Classifies a texture by its alpha channel. Cut-outs (foliage, fences) are almost entirely fully opaque or
+     * fully transparent, with partial alpha only along their filtered edges, and can be alpha tested.
+     * @param channels - Bytes per pixel, alpha is the last one
+     */
+    AlphaMode Texture::classifyAlpha(const unsigned char* image, const int pixels, const int channels) {
+        constexpr unsigned char LOW = 8;        // Alpha at or below counts as fully transparent
+        constexpr unsigned char HIGH = 247;     // Alpha at or above counts as fully opaque
+        int transparent = 0;
+        int partial = 0;
+        for (int i = 0; i < pixels; i++) {
+            const unsigned char alpha = image[i * channels + channels - 1];
+            if (alpha <= LOW) transparent++;
+            else if (alpha < HIGH) partial++;
+        }
+        if (transparent == 0 && partial == 0) return ALPHA_OPAQUE;
+        return partial <= pixels / 10 ? ALPHA_MASK : ALPHA_BLEND;
+    }
 }
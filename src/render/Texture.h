@@ -1,5 +1,8 @@
 #pragma once
+#include <cstdint>
+
 #include "GL/glew.h"
+#include "MaterialConstants.h"
 
 struct aiScene;
 struct aiString;
@@ -8,14 +11,29 @@ struct aiTexture;
 
 namespace gl {
 
-    constexpr int TEXTURE_UNIT_AMBIENT  = 0;
-    constexpr int TEXTURE_UNIT_DIFFUSE  = 1;
-    constexpr int TEXTURE_UNIT_SPECULAR = 2;
+    constexpr int TEXTURE_UNIT_AMBIENT  = material::TEXTURE_UNIT_AMBIENT;
+    constexpr int TEXTURE_UNIT_DIFFUSE  = material::TEXTURE_UNIT_DIFFUSE;
+    constexpr int TEXTURE_UNIT_SPECULAR = material::TEXTURE_UNIT_SPECULAR;
+    constexpr int TEXTURE_UNIT_INSTANCE_DATA = 3;
+    constexpr int TEXTURE_UNIT_ANIMATION = 4;
+    constexpr int TEXTURE_UNIT_LIGHTS = 5;
+    constexpr int TEXTURE_UNIT_LIGHT_CLUSTERS = 6;
+    constexpr int TEXTURE_UNIT_LIGHT_INDICES = 7;
+    constexpr int TEXTURE_UNIT_SHADOW = 8;
+
+    constexpr  int TEXTURE_FLAG_AMBIENT  = material::TEXTURE_FLAG_AMBIENT;
+    constexpr  int TEXTURE_FLAG_DIFFUSE  = material::TEXTURE_FLAG_DIFFUSE;
+    constexpr  int TEXTURE_FLAG_SPECULAR = material::TEXTURE_FLAG_SPECULAR;
 
-    constexpr  int TEXTURE_FLAG_AMBIENT  = 0x1;  // Bit 0
-    constexpr  int TEXTURE_FLAG_DIFFUSE  = 0x2;  // Bit 1
-    constexpr  int TEXTURE_FLAG_SPECULAR = 0x4;  // Bit 2
 
+    // Decides the pass a material is drawn in
+    enum AlphaMode {
+        ALPHA_OPAQUE,   // Drawn first, no blending
+        ALPHA_MASK,     // Drawn with the opaque geometry, fragments below ALPHA_CUTOFF discarded
+        ALPHA_BLEND     // Drawn last with blending, back to front
+    };
+
+    constexpr float ALPHA_CUTOFF = 0.5f;
 
     struct Textures {
 
@@ -34,6 +52,8 @@ namespace gl {
         float shininess;
         float opacity;
         Textures textures;
+        AlphaMode alpha_mode = ALPHA_OPAQUE;
+        uint64_t variant = 0;   // Material bits of its shader variant, see ShaderVariants::getMaterialKey
     };
 
     static const DrawMaterial defaultMaterial = {
@@ -42,7 +62,8 @@ namespace gl {
         .specular = glm::vec3(1.0f, 0.5f, 1.0f),
         .shininess = 100.0f,
         .opacity = 1.0f,
-        .textures = {}
+        .textures = {},
+        .alpha_mode = ALPHA_OPAQUE
     };
 
     class Texture {
@@ -56,7 +77,9 @@ namespace gl {
         static GLuint loadFromFile(const aiString* ai_string, const std::string& directory);
         static Textures loadMaterialTextures(const aiScene* scene, const aiMaterial* material, const std::string& directory);
         static void setTextureFlags(Textures& texture);
+        static AlphaMode classifyAlpha(const unsigned char* image, int pixels, int channels);
         static std::unordered_map<std::string, GLuint> loaded_textures_;
+        static std::unordered_map<GLuint, AlphaMode> texture_alpha_modes_;   // Only textures with an alpha channel
 
     };
 }
@@ -5,20 +5,24 @@
 #include "Transform.h"
 
 namespace gl {
-    Transform::Transform() : position_(0.0f, 0.0f, 0.0f), scale_(1.0f, 1.0f, 1.0f), rotation_(1.0f) {
+    Transform::Transform() : position_(0.0f, 0.0f, 0.0f), scale_(1.0f, 1.0f, 1.0f), rotation_(1.0f),
+        model_matrix_(1.0f), normal_matrix_(1.0f) {
 
     }
 
     void Transform::setPosition(const glm::vec3& pos) {
         position_ = pos;
+        updateMatrices();
     }
 
     void Transform::setScale(const glm::vec3& scale) {
         scale_ = scale;
+        updateMatrices();
     }
 
     void Transform::setRotation(const glm::mat4& rotation_matrix) {
         rotation_ = rotation_matrix;
+        updateMatrices();
     }
 
     /**
@@ -28,6 +32,7 @@ namespace gl {
      */
     void Transform::rotate(const float angle, const glm::vec3 axis) {
         rotation_ = glm::rotate(rotation_, angle, axis);
+        updateMatrices();
     }
 
     /**
@@ -39,12 +44,14 @@ namespace gl {
         rotate(glm::radians(angle_degrees), axis);
     }
 
-    glm::mat4 Transform::getModelMatrix() const {
+    void Transform::updateMatrices() {
         auto model = glm::mat4(1.0f);
         model = glm::translate(model, position_);
         model = model * rotation_;
         model = glm::scale(model, scale_);
-        return model;
+        model_matrix_ = model;
+        normal_matrix_ = glm::transpose(glm::inverse(glm::mat3(model)));
+        version_++;
     }
 
 }
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+
 #include "glm/glm.hpp"
 
 namespace gl {
@@ -13,13 +15,22 @@ namespace gl {
         void rotate(float angle, glm::vec3 axis);
         void rotateDegrees(float angle_degrees, glm::vec3 axis);
 
-        glm::mat4 getModelMatrix() const;
+        const glm::mat4& getModelMatrix() const { return model_matrix_; }
+        const glm::mat3& getNormalMatrix() const { return normal_matrix_; }
+        uint64_t getVersion() const { return version_; }
 
 
     private:
+        void updateMatrices();
+
         glm::vec3 position_;
         glm::vec3 scale_;
         glm::mat4 rotation_;
 
+        // Rebuilt by every setter rather than lazily, so const reads stay safe from worker threads
+        glm::mat4 model_matrix_;
+        glm::mat3 normal_matrix_;
+        uint64_t version_ = 0;  // Incremented on every change, for caches keyed on this transform
+
     };
 }
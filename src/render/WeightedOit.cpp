@@ -0,0 +1,69 @@
+#include "WeightedOit.h"
+
+namespace gl {
+
+    // Declares the targets as written by the accumulation pass
+    WeightedOit::Targets WeightedOit::create(FrameGraph::Builder& builder, const int width, const int height) {
+        Targets targets;
+        targets.accumulation = builder.create("OIT accumulation", {width, height, GL_RGBA16F});
+        targets.revealage = builder.create("OIT revealage", {width, height, GL_R8});
+        targets.depth = builder.create("OIT depth", {width, height, GL_DEPTH24_STENCIL8});
+        return targets;
+    }
+
+    /**
+     * Prepares the bound OIT targets: copies the scene's depth and clears. Call after all opaque geometry with the
+     * phong shader active and setWeightedOit(true), since usePhongShader resets the blend state set here.
+     * @param scene_framebuffer, width, height - Framebuffer to take the depth from, and its size
+     */
+    void WeightedOit::begin(const GLuint scene_framebuffer, const int width, const int height) const {
+        GLint framebuffer;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+        // Blitting depth needs matching formats, the scene's depth buffer must be 24 bit depth, 8 bit stencil
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, scene_framebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        constexpr GLfloat no_accumulation[] = {0.0f, 0.0f, 0.0f, 0.0f};
+        constexpr GLfloat fully_revealed[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glClearBufferfv(GL_COLOR, 0, no_accumulation);
+        glClearBufferfv(GL_COLOR, 1, fully_revealed);
+
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        glBlendFunci(0, GL_ONE, GL_ONE);
+        glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    }
+
+    /**
+     * Blends the resolved transparency over the bound framebuffer and restores the default blend and depth state.
+     * Leaves the composite program bound, so use a Graphics shader before drawing again.
+     */
+    void WeightedOit::composite(const FrameGraph& graph, const Targets& targets) {
+        if (empty_vao_ == 0) {
+            composite_ = Shaders::createShaderProgram("Resources/Shaders/fullscreen_vert.glsl",
+                "Resources/Shaders/oit_composite_frag.glsl");
+            glGenVertexArrays(1, &empty_vao_);
+        }
+        composite_.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(targets.accumulation));
+        composite_.setInt("accumulation", 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(targets.revealage));
+        composite_.setInt("revealage", 1);
+
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBindVertexArray(empty_vao_);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "FrameGraph.h"
+#include "Shaders.h"
+
+namespace gl {
+
+    /**
+     * Weighted blended order-independent transparency (McGuire and Bavoil 2013).
+     * Blended surfaces are drawn unsorted into an accumulation target (premultiplied color times a depth weight,
+     * summed) and a revealage target (product of 1 - alpha), tested against a copy of the scene's depth. The
+     * composite pass resolves their weighted average over the scene. Exact only up to the weighting, but
+     * needs no sort and handles intersecting surfaces. The targets are frame graph transients.
+     */
+    class WeightedOit {
+    public:
+        struct Targets {
+            FrameResource accumulation = NULL_RESOURCE;    // RGBA16F
+            FrameResource revealage = NULL_RESOURCE;       // R8
+            FrameResource depth = NULL_RESOURCE;           // Copied from the scene each frame
+        };
+
+        WeightedOit() = default;
+        WeightedOit(const WeightedOit&) = delete;
+        WeightedOit& operator=(const WeightedOit&) = delete;
+
+        static Targets create(FrameGraph::Builder& builder, int width, int height);
+        void begin(GLuint scene_framebuffer, int width, int height) const;
+        void composite(const FrameGraph& graph, const Targets& targets);
+
+    private:
+        GLuint empty_vao_ = 0;      // Core profile needs a VAO bound even for attribute-less draws
+        ShaderProgram composite_;
+    };
+}